@@ -0,0 +1,31 @@
+#include "arena.h"
+#include <stdlib.h>
+
+void init_arena(arena *arena, size_t capacity)
+{
+    arena->data = capacity > 0 ? malloc(capacity) : NULL;
+    arena->size = 0;
+    arena->capacity = capacity;
+}
+
+void grow_arena(arena *arena, size_t capacity)
+{
+    if (capacity < arena->capacity * 2)
+        capacity = arena->capacity * 2;
+
+    arena->data = realloc(arena->data, capacity);
+    arena->capacity = capacity;
+}
+
+void reset_arena(arena *arena)
+{
+    arena->size = 0;
+}
+
+void clear_arena(arena *arena)
+{
+    free(arena->data);
+    arena->data = NULL;
+    arena->size = 0;
+    arena->capacity = 0;
+}
@@ -0,0 +1,37 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Bump allocator over one contiguous block. The block moves when it grows,
+// so allocations are referred to by offset, and reset frees everything at
+// once by rewinding the offset.
+typedef struct
+{
+    char *data;
+    size_t size;
+    size_t capacity;
+} arena;
+
+void init_arena(arena *arena, size_t capacity);
+void grow_arena(arena *arena, size_t capacity);
+void reset_arena(arena *arena);
+void clear_arena(arena *arena);
+
+// Returns the offset of size bytes at the given power of two alignment
+static inline size_t arena_alloc(arena *arena, size_t size, size_t alignment)
+{
+    size_t offset = (arena->size + alignment - 1) & ~(alignment - 1);
+    if (offset + size > arena->capacity)
+        grow_arena(arena, offset + size);
+
+    arena->size = offset + size;
+    return offset;
+}
+
+static inline void *arena_at(const arena *arena, size_t offset)
+{
+    return arena->data + offset;
+}
+
+#endif
@@ -0,0 +1,206 @@
+#include "batch.h"
+#include "earley.h"
+#include <pthread.h>
+#include <string.h>
+
+// Lines are handed out to workers in chunks of this many lines
+#define BATCH_CHUNK_LINES 256
+
+typedef struct
+{
+    size_t offset;
+    size_t length;
+} line_span;
+
+// Range of chunks owned by one worker. The owner takes chunks from the
+// front and idle workers steal from the back.
+typedef struct
+{
+    pthread_mutex_t lock;
+    size_t begin;
+    size_t end;
+} chunk_queue;
+
+typedef struct batch batch;
+
+typedef struct
+{
+    batch *batch;
+    size_t index;
+    pthread_t thread;
+} batch_worker;
+
+struct batch
+{
+    const parser *parser;
+    const char *input;
+    const line_span *lines;
+    size_t n_lines;
+    bool *results;
+    chunk_queue *queues;
+    batch_worker *workers;
+    size_t n_workers;
+};
+
+static void split_lines(const char *input, size_t length, list *lines);
+static void *run_worker(void *arg);
+static bool take_chunk(chunk_queue *queue, size_t *chunk);
+static bool steal_chunk(chunk_queue *queue, size_t *chunk);
+
+void validate_batch(const parser *parser, const char *input, size_t length, size_t n_threads, FILE *output)
+{
+    list lines;
+    init_list(&lines, 1024, sizeof(line_span));
+    split_lines(input, length, &lines);
+
+    size_t n_chunks = (lines.count + BATCH_CHUNK_LINES - 1) / BATCH_CHUNK_LINES;
+    if (n_threads == 0)
+        n_threads = 1;
+
+    if (n_threads > n_chunks && n_chunks > 0)
+        n_threads = n_chunks;
+
+    batch batch;
+    batch.parser = parser;
+    batch.input = input;
+    batch.lines = lines.head;
+    batch.n_lines = lines.count;
+    batch.results = malloc((lines.count + 1) * sizeof(bool));
+    batch.queues = malloc(n_threads * sizeof(chunk_queue));
+    batch.workers = malloc(n_threads * sizeof(batch_worker));
+    batch.n_workers = n_threads;
+
+    // Every worker starts with an equal contiguous range of chunks
+    for (size_t i = 0; i < n_threads; i++)
+    {
+        pthread_mutex_init(&batch.queues[i].lock, NULL);
+        batch.queues[i].begin = n_chunks * i / n_threads;
+        batch.queues[i].end = n_chunks * (i + 1) / n_threads;
+    }
+
+    size_t n_started = 0;
+    for (size_t i = 0; i < n_threads; i++)
+    {
+        batch.workers[i].batch = &batch;
+        batch.workers[i].index = i;
+        if (pthread_create(&batch.workers[i].thread, NULL, run_worker, &batch.workers[i]) != 0)
+            break;
+
+        n_started++;
+    }
+
+    // Chunks of workers that could not be started are stolen by the others
+    for (size_t i = 0; i < n_started; i++)
+    {
+        pthread_join(batch.workers[i].thread, NULL);
+    }
+
+    if (n_started == 0)
+    {
+        run_worker(&batch.workers[0]);
+    }
+
+    for (size_t i = 0; i < lines.count; i++)
+    {
+        fputs(batch.results[i] ? "valid\n" : "invalid\n", output);
+    }
+
+    for (size_t i = 0; i < n_threads; i++)
+    {
+        pthread_mutex_destroy(&batch.queues[i].lock);
+    }
+
+    free(batch.workers);
+    free(batch.queues);
+    free(batch.results);
+    clear_list(&lines);
+}
+
+void split_lines(const char *input, size_t length, list *lines)
+{
+    size_t start = 0;
+    while (start < length)
+    {
+        const char *newline = memchr(input + start, '\n', length - start);
+        size_t end = newline ? (size_t)(newline - input) : length;
+
+        line_span *line = new_list_element(lines);
+        line->offset = start;
+        line->length = end - start;
+
+        start = end + 1;
+    }
+}
+
+void *run_worker(void *arg)
+{
+    batch_worker *worker = arg;
+    batch *batch = worker->batch;
+
+    parse_context context;
+    init_parse_context(&context);
+    bool earley = !is_valid_grammar(batch->parser);
+    earley_recognizer recognizer;
+    if (earley)
+        init_earley_recognizer(&recognizer, batch->parser);
+
+    size_t chunk;
+    size_t victim = worker->index;
+    while (true)
+    {
+        if (!take_chunk(&batch->queues[worker->index], &chunk))
+        {
+            // Look for work in the other queues, starting after the last
+            // queue that had some
+            bool stolen = false;
+            for (size_t i = 0; i < batch->n_workers && !stolen; i++)
+            {
+                victim = (victim + 1) % batch->n_workers;
+                stolen = victim != worker->index && steal_chunk(&batch->queues[victim], &chunk);
+            }
+
+            if (!stolen)
+                break;
+        }
+
+        size_t first_line = chunk * BATCH_CHUNK_LINES;
+        size_t last_line = first_line + BATCH_CHUNK_LINES;
+        if (last_line > batch->n_lines)
+            last_line = batch->n_lines;
+
+        for (size_t i = first_line; i < last_line; i++)
+        {
+            const line_span *line = batch->lines + i;
+            const char *text = batch->input + line->offset;
+            batch->results[i] = earley ? earley_recognize_span(&recognizer, &context, text, line->length)
+                                       : validate_span(batch->parser, &context, text, line->length);
+        }
+    }
+
+    if (earley)
+        clear_earley_recognizer(&recognizer);
+    clear_parse_context(&context);
+    return NULL;
+}
+
+bool take_chunk(chunk_queue *queue, size_t *chunk)
+{
+    pthread_mutex_lock(&queue->lock);
+    bool has_chunk = queue->begin < queue->end;
+    if (has_chunk)
+        *chunk = queue->begin++;
+
+    pthread_mutex_unlock(&queue->lock);
+    return has_chunk;
+}
+
+bool steal_chunk(chunk_queue *queue, size_t *chunk)
+{
+    pthread_mutex_lock(&queue->lock);
+    bool has_chunk = queue->begin < queue->end;
+    if (has_chunk)
+        *chunk = --queue->end;
+
+    pthread_mutex_unlock(&queue->lock);
+    return has_chunk;
+}
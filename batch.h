@@ -0,0 +1,13 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include "parser.h"
+
+// Validates every line of input as a separate string using n_threads
+// workers, then writes one result per line to output in input order.
+// Grammars that are not LL(1) are run with one Earley recognizer per
+// worker, which needs a parser built from a grammar.
+void validate_batch(const parser *parser, const char *input, size_t length, size_t n_threads, FILE *output);
+
+#endif
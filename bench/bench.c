@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "synthetic.h"
+#include "../tree.h"
+
+#define MAX_SIZES 32
+#define INVALID_PERCENT 25
+
+typedef struct
+{
+    size_t sizes[MAX_SIZES];
+    size_t n_sizes;
+    size_t n_sentences;
+    size_t length;
+    int rounds;
+    grammar_params params;
+} bench_options;
+
+static bool parse_bench_options(bench_options *options, int argc, char *argv[]);
+static int run_size(const bench_options *options, size_t size);
+static double elapsed_seconds(const struct timespec *start);
+
+bool parse_bench_options(bench_options *options, int argc, char *argv[])
+{
+    size_t default_sizes[] = {100, 300, 1000, 3000};
+    memcpy(options->sizes, default_sizes, sizeof(default_sizes));
+    options->n_sizes = sizeof(default_sizes) / sizeof(default_sizes[0]);
+    options->n_sentences = 2000;
+    options->length = 100;
+    options->rounds = 5;
+    init_grammar_params(&options->params);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+            return false;
+
+        if (strcmp(argv[i], "--sizes") == 0)
+        {
+            options->n_sizes = 0;
+            for (char *size = strtok(argv[i + 1], ","); size && options->n_sizes < MAX_SIZES; size = strtok(NULL, ","))
+                options->sizes[options->n_sizes++] = atol(size);
+        }
+        else if (strcmp(argv[i], "--sentences") == 0)
+            options->n_sentences = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--length") == 0)
+            options->length = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--rounds") == 0)
+            options->rounds = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--alternatives") == 0)
+            options->params.n_alternatives = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--nullable") == 0)
+            options->params.nullable_percent = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--recursion") == 0)
+            options->params.recursion_depth = atol(argv[i + 1]);
+        else
+            return false;
+
+        i++;
+    }
+
+    return options->n_sizes > 0 && options->rounds > 0;
+}
+
+double elapsed_seconds(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Runs every step for one grammar size, called in its own process so the
+// peak RSS belongs to that size alone
+int run_size(const bench_options *options, size_t size)
+{
+    grammar_params params = options->params;
+    params.n_nonterminals = size;
+    params.n_terminals = size / 2 + 16;
+
+    char *grammar_text;
+    size_t grammar_size;
+    FILE *grammar_file = open_memstream(&grammar_text, &grammar_size);
+    write_synthetic_grammar(&params, grammar_file);
+    fclose(grammar_file);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    grammar grammar;
+    init_grammar(&grammar, 16);
+    bool loaded = create_grammar_from_buffer(&grammar, grammar_text, grammar_size);
+    double load_seconds = elapsed_seconds(&start);
+    free(grammar_text);
+    if (!loaded)
+    {
+        fputs("Error reading input\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    parser parser;
+    init_parser(&parser, &grammar);
+    build_parse_table(&parser);
+    double build_seconds = elapsed_seconds(&start);
+    if (!is_valid_grammar(&parser))
+    {
+        fputs("Generated grammar is not LL(1)\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    // Sentences are stored back to back, each terminated for is_valid_string
+    sentence_generator generator;
+    init_sentence_generator(&generator, &parser, params.seed);
+    list tokens;
+    list text;
+    init_list(&tokens, options->length * 2, sizeof(int));
+    init_list(&text, options->n_sentences * options->length * 4, sizeof(char));
+    size_t n_tokens = 0;
+    for (size_t i = 0; i < options->n_sentences; i++)
+    {
+        tokens.count = 0;
+        if (!generate_sentence(&generator, options->length, &tokens))
+            continue;
+
+        if ((int)(next_random(&generator.seed) % 100) < INVALID_PERCENT)
+            make_near_miss(&generator, tokens.head, tokens.count);
+
+        write_sentence(&parser, tokens.head, tokens.count, &text);
+        *(char *)push_back(&text) = '\0';
+        n_tokens += tokens.count;
+    }
+
+    size_t n_valid = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int round = 0; round < options->rounds; round++)
+    {
+        n_valid = 0;
+        for (const char *sentence = text.head; sentence < (char *)text.head + text.count;
+             sentence += strlen(sentence) + 1)
+            n_valid += is_valid_string(&parser, sentence);
+    }
+    double parse_seconds = elapsed_seconds(&start);
+
+    // Same sentences with reused buffers, without and with a parse tree
+    parse_context context;
+    init_parse_context(&context);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int round = 0; round < options->rounds; round++)
+    {
+        for (const char *sentence = text.head; sentence < (char *)text.head + text.count;
+             sentence += strlen(sentence) + 1)
+            validate_span(&parser, &context, sentence, strlen(sentence));
+    }
+    double span_seconds = elapsed_seconds(&start);
+
+    arena arena;
+    init_arena(&arena, 4096);
+    parse_tree tree;
+    init_parse_tree(&tree, &arena);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int round = 0; round < options->rounds; round++)
+    {
+        for (const char *sentence = text.head; sentence < (char *)text.head + text.count;
+             sentence += strlen(sentence) + 1)
+        {
+            reset_arena(&arena);
+            context.tokens.count = 0;
+            if (tokenize_span(&parser, sentence, strlen(sentence), &context.tokens))
+                build_parse_tree(&parser, &context.stack, context.tokens.head, context.tokens.count, &tree);
+        }
+    }
+    double tree_seconds = elapsed_seconds(&start);
+    clear_arena(&arena);
+    clear_parse_context(&context);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    double total_tokens = (double)n_tokens * options->rounds;
+    printf("%8zu %8zu %8zu %10.2f %10.2f %8zu %6zu %10.2f %10.2f %10.2f %10ld\n", size, grammar.rules.count,
+           grammar.symbols.count, load_seconds * 1e3, build_seconds * 1e3, n_tokens, n_valid,
+           total_tokens / parse_seconds / 1e6, total_tokens / span_seconds / 1e6, total_tokens / tree_seconds / 1e6,
+           usage.ru_maxrss);
+    fflush(stdout);
+
+    clear_list(&tokens);
+    clear_list(&text);
+    clear_sentence_generator(&generator);
+    clear_parser(&parser);
+    clear_grammar(&grammar);
+
+    return EXIT_SUCCESS;
+}
+
+// Builds synthetic grammars of growing size and reports how long the table
+// takes to build, how fast is_valid_string runs on them and peak memory
+int main(int argc, char *argv[])
+{
+    bench_options options;
+    if (!parse_bench_options(&options, argc, argv))
+    {
+        fputs("Usage: bench [--sizes N,N,...] [--sentences N] [--length N] [--rounds N] [--alternatives N] "
+              "[--nullable PERCENT] [--recursion N]\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    // Throughput is in millions of tokens per second, for is_valid_string,
+    // validate_span with reused buffers and build_parse_tree
+    printf("%8s %8s %8s %10s %10s %8s %6s %10s %10s %10s %10s\n", "size", "rules", "symbols", "load ms", "build ms",
+           "tokens", "valid", "string", "span", "tree", "peak KB");
+    fflush(stdout);
+
+    int status = EXIT_SUCCESS;
+    for (size_t i = 0; i < options.n_sizes; i++)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+            exit(run_size(&options, options.sizes[i]));
+
+        int child_status;
+        if (pid < 0 || waitpid(pid, &child_status, 0) < 0 || !WIFEXITED(child_status) ||
+            WEXITSTATUS(child_status) != EXIT_SUCCESS)
+            status = EXIT_FAILURE;
+    }
+
+    return status;
+}
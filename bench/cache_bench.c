@@ -0,0 +1,262 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../ll1.h"
+#include "synthetic.h"
+
+#define MAX_THREADS 64
+
+typedef struct
+{
+    size_t n_tenants;
+    size_t n_requests;
+    size_t n_threads;
+    size_t n_nonterminals;
+} bench_options;
+
+// Every tenant grammar is sent in two layouts that normalize the same
+typedef struct
+{
+    char *text;
+    size_t length;
+    char *spaced_text;
+    size_t spaced_length;
+} tenant_grammar;
+
+typedef struct
+{
+    ll1_cache *cache;
+    const tenant_grammar *tenants;
+    size_t n_tenants;
+    size_t n_requests;
+    uint64_t seed;
+    pthread_barrier_t *start;
+    bool failed;
+} worker;
+
+static bool parse_bench_options(bench_options *options, int argc, char *argv[]);
+static double elapsed_seconds(const struct timespec *start);
+static void write_tenant_grammar(size_t tenant, size_t n_nonterminals, tenant_grammar *grammar);
+static size_t pick_tenant(uint64_t *seed, size_t n_tenants);
+static void *run_worker(void *arg);
+static double run_workers(ll1_cache *cache, const tenant_grammar *tenants, size_t n_tenants, size_t n_requests,
+                          size_t n_threads, bool *failed);
+
+bool parse_bench_options(bench_options *options, int argc, char *argv[])
+{
+    options->n_tenants = 300;
+    options->n_requests = 50000;
+    options->n_threads = 8;
+    options->n_nonterminals = 60;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+            return false;
+
+        if (strcmp(argv[i], "--tenants") == 0)
+            options->n_tenants = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--requests") == 0)
+            options->n_requests = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--threads") == 0)
+            options->n_threads = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--nonterminals") == 0)
+            options->n_nonterminals = atol(argv[i + 1]);
+        else
+            return false;
+
+        i++;
+    }
+
+    return options->n_tenants > 0 && options->n_requests > 0 && options->n_threads > 0 &&
+           options->n_threads <= MAX_THREADS && options->n_nonterminals > 0;
+}
+
+double elapsed_seconds(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+void write_tenant_grammar(size_t tenant, size_t n_nonterminals, tenant_grammar *grammar)
+{
+    grammar_params params;
+    init_grammar_params(&params);
+    params.n_nonterminals = n_nonterminals;
+    params.seed = tenant + 1;
+
+    FILE *file = open_memstream(&grammar->text, &grammar->length);
+    write_synthetic_grammar(&params, file);
+    fclose(file);
+
+    // Blank lines between rules and two spaces between names
+    file = open_memstream(&grammar->spaced_text, &grammar->spaced_length);
+    for (size_t i = 0; i < grammar->length; i++)
+    {
+        if (grammar->text[i] == ' ')
+            putc(' ', file);
+        else if (grammar->text[i] == '\n')
+            putc('\n', file);
+
+        putc(grammar->text[i], file);
+    }
+
+    fclose(file);
+}
+
+// A few tenants get most of the requests, like in a real deployment
+size_t pick_tenant(uint64_t *seed, size_t n_tenants)
+{
+    double u = (next_random(seed) >> 11) * (1.0 / 9007199254740992.0);
+    return (size_t)(u * u * u * n_tenants);
+}
+
+void *run_worker(void *arg)
+{
+    worker *worker = arg;
+    pthread_barrier_wait(worker->start);
+    for (size_t i = 0; i < worker->n_requests; i++)
+    {
+        const tenant_grammar *tenant = &worker->tenants[pick_tenant(&worker->seed, worker->n_tenants)];
+        bool spaced = next_random(&worker->seed) % 2;
+        const ll1_parser *parser;
+        ll1_status status = ll1_cache_acquire(worker->cache, spaced ? tenant->spaced_text : tenant->text,
+                                              spaced ? tenant->spaced_length : tenant->length, &parser);
+        if (status != LL1_OK)
+        {
+            worker->failed = true;
+            continue;
+        }
+
+        ll1_cache_release(worker->cache, parser);
+    }
+
+    return NULL;
+}
+
+double run_workers(ll1_cache *cache, const tenant_grammar *tenants, size_t n_tenants, size_t n_requests,
+                   size_t n_threads, bool *failed)
+{
+    pthread_t threads[MAX_THREADS];
+    worker workers[MAX_THREADS];
+    pthread_barrier_t start_barrier;
+    pthread_barrier_init(&start_barrier, NULL, n_threads + 1);
+    for (size_t i = 0; i < n_threads; i++)
+    {
+        workers[i] = (worker){cache, tenants, n_tenants, n_requests / n_threads, i + 1, &start_barrier, false};
+        pthread_create(&threads[i], NULL, run_worker, &workers[i]);
+    }
+
+    struct timespec start;
+    pthread_barrier_wait(&start_barrier);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < n_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+        *failed = *failed || workers[i].failed;
+    }
+
+    double seconds = elapsed_seconds(&start);
+    pthread_barrier_destroy(&start_barrier);
+    return seconds;
+}
+
+// Serves requests for many tenant grammars through the parser cache, with
+// and without room for every table, next to building the parser for every
+// request. Also checks that threads asking for one cold grammar at the same
+// time build it once.
+int main(int argc, char *argv[])
+{
+    bench_options options;
+    if (!parse_bench_options(&options, argc, argv))
+    {
+        fputs("Usage: cache_bench [--tenants N] [--requests N] [--threads N] [--nonterminals N]\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    tenant_grammar *tenants = malloc(options.n_tenants * sizeof(tenant_grammar));
+    for (size_t i = 0; i < options.n_tenants; i++)
+        write_tenant_grammar(i, options.n_nonterminals, &tenants[i]);
+
+    // What every request paid before the cache
+    size_t n_builds = options.n_tenants < 100 ? options.n_tenants : 100;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < n_builds; i++)
+    {
+        ll1_grammar *grammar;
+        ll1_parser *parser;
+        if (ll1_grammar_parse(tenants[i].text, tenants[i].length, &grammar) != LL1_OK ||
+            ll1_parser_build(grammar, 1, &parser) != LL1_OK)
+        {
+            fputs("ERROR: tenant grammar is not LL(1)\n", stderr);
+            return EXIT_FAILURE;
+        }
+
+        ll1_parser_free(parser);
+        ll1_grammar_free(grammar);
+    }
+
+    double build_us = elapsed_seconds(&start) * 1e6 / n_builds;
+
+    // Single flight on one cold grammar, large enough that its build
+    // overlaps the other requests even on one core
+    tenant_grammar cold;
+    write_tenant_grammar(options.n_tenants, options.n_nonterminals * 32, &cold);
+    ll1_cache *cache;
+    ll1_cache_create(SIZE_MAX, 1, &cache);
+    bool failed = false;
+    double seconds = run_workers(cache, &cold, 1, options.n_threads, options.n_threads, &failed);
+    ll1_cache_stats stats;
+    ll1_cache_get_stats(cache, &stats);
+    printf("%zu threads on one cold grammar: %llu build, %llu waited, %.3f ms\n\n", options.n_threads,
+           (unsigned long long)stats.misses, (unsigned long long)stats.waits, seconds * 1e3);
+    ll1_cache_free(cache);
+    free(cold.text);
+    free(cold.spaced_text);
+    if (stats.misses != 1)
+        failed = true;
+
+    printf("%zu tenants, %zu requests, %zu threads\n", options.n_tenants, options.n_requests, options.n_threads);
+    printf("%-14s %12s %10s %10s %10s %12s\n", "cache", "us/request", "hit rate", "builds", "evictions",
+           "table bytes");
+    printf("%-14s %12.2f %10s %10s %10s %12s\n", "none", build_us, "-", "-", "-", "-");
+
+    // The first run measures what every table takes, the next ones only
+    // have room for part of it
+    size_t all_bytes = 0;
+    size_t fractions[] = {1, 4, 16};
+    for (size_t i = 0; i < sizeof(fractions) / sizeof(fractions[0]) && !failed; i++)
+    {
+        ll1_cache_create(i == 0 ? SIZE_MAX : all_bytes / fractions[i], 1, &cache);
+        seconds = run_workers(cache, tenants, options.n_tenants, options.n_requests, options.n_threads, &failed);
+        ll1_cache_get_stats(cache, &stats);
+        if (i == 0)
+            all_bytes = stats.table_bytes;
+
+        size_t n_done = options.n_requests / options.n_threads * options.n_threads;
+        char label[32];
+        snprintf(label, sizeof(label), i == 0 ? "unbounded" : "1/%zu of tables", fractions[i]);
+        printf("%-14s %12.2f %9.1f%% %10llu %10llu %12zu\n", label, seconds * 1e6 / n_done,
+               100.0 * stats.hits / n_done, (unsigned long long)stats.misses, (unsigned long long)stats.evictions,
+               stats.table_bytes);
+        ll1_cache_free(cache);
+    }
+
+    for (size_t i = 0; i < options.n_tenants; i++)
+    {
+        free(tenants[i].text);
+        free(tenants[i].spaced_text);
+    }
+
+    free(tenants);
+    if (failed)
+    {
+        fputs("ERROR: cache did not serve every request as expected\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "synthetic.h"
+
+// Provided by the source that ll1.bin --generate --prefix bench writes
+bool bench_recognize_tokens(const int *tokens, size_t n_tokens);
+bool bench_recognize(const char *str, size_t length);
+
+#define N_SENTENCES 20000
+#define MAX_SENTENCE_TOKENS 200
+#define N_ROUNDS 20
+
+typedef struct
+{
+    list tokens;
+    list offsets;
+    list text;
+    list text_offsets;
+} corpus;
+
+static void build_corpus(const parser *parser, corpus *corpus);
+static double elapsed_seconds(const struct timespec *start);
+static void report(const char *name, double seconds, size_t n_tokens);
+
+void build_corpus(const parser *parser, corpus *corpus)
+{
+    sentence_generator generator;
+    init_sentence_generator(&generator, parser, 1);
+
+    init_list(&corpus->tokens, 1024, sizeof(int));
+    init_list(&corpus->offsets, N_SENTENCES + 1, sizeof(size_t));
+    init_list(&corpus->text, 4096, sizeof(char));
+    init_list(&corpus->text_offsets, N_SENTENCES + 1, sizeof(size_t));
+
+    *(size_t *)push_back(&corpus->offsets) = 0;
+    *(size_t *)push_back(&corpus->text_offsets) = 0;
+    for (int i = 0; i < N_SENTENCES; i++)
+    {
+        size_t first_token = corpus->tokens.count;
+        if (!generate_sentence(&generator, MAX_SENTENCE_TOKENS, &corpus->tokens))
+            continue;
+
+        // Every fourth sentence is a near miss
+        int *tokens = (int *)corpus->tokens.head + first_token;
+        size_t n_tokens = corpus->tokens.count - first_token;
+        if (i % 4 == 3)
+            make_near_miss(&generator, tokens, n_tokens);
+
+        write_sentence(parser, tokens, n_tokens, &corpus->text);
+        *(size_t *)push_back(&corpus->offsets) = corpus->tokens.count;
+        *(size_t *)push_back(&corpus->text_offsets) = corpus->text.count;
+    }
+
+    clear_sentence_generator(&generator);
+}
+
+double elapsed_seconds(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+void report(const char *name, double seconds, size_t n_tokens)
+{
+    printf("%-22s %8.3f s %10.2f Mtokens/s\n", name, seconds, n_tokens / seconds / 1e6);
+}
+
+// Compares the generated recognizer against the interpreted driver on
+// sentences derived from the grammar it was generated from
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fputs("Usage: codegen_bench <grammar>\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    FILE *grammar_file = fopen(argv[1], "r");
+    if (!grammar_file)
+    {
+        fputs("ERROR: could not open file\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    grammar grammar;
+    init_grammar(&grammar, 16);
+    bool loaded = create_grammar_from_file(&grammar, grammar_file);
+    fclose(grammar_file);
+    if (!loaded)
+    {
+        clear_grammar(&grammar);
+        fputs("Error reading input\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    parser parser;
+    init_parser(&parser, &grammar);
+    build_parse_table(&parser);
+    if (!is_valid_grammar(&parser))
+    {
+        printf("Grammar is not LL(1)\n");
+        clear_parser(&parser);
+        clear_grammar(&grammar);
+        return EXIT_FAILURE;
+    }
+
+    corpus corpus;
+    build_corpus(&parser, &corpus);
+
+    const int *tokens = corpus.tokens.head;
+    const size_t *offsets = corpus.offsets.head;
+    const char *text = corpus.text.head;
+    const size_t *text_offsets = corpus.text_offsets.head;
+
+    // Both recognizers have to agree before their speed means anything
+    parse_context context;
+    init_parse_context(&context);
+    size_t n_valid = 0;
+    for (int i = 0; i < N_SENTENCES; i++)
+    {
+        size_t n_tokens = offsets[i + 1] - offsets[i];
+        size_t length = text_offsets[i + 1] - text_offsets[i];
+        bool expected = validate_tokens(&parser, &context.stack, tokens + offsets[i], n_tokens);
+        if (bench_recognize_tokens(tokens + offsets[i], n_tokens) != expected ||
+            validate_span(&parser, &context, text + text_offsets[i], length) != expected ||
+            bench_recognize(text + text_offsets[i], length) != expected)
+        {
+            fprintf(stderr, "ERROR: recognizers disagree on sentence %d\n", i);
+            return EXIT_FAILURE;
+        }
+
+        n_valid += expected;
+    }
+
+    size_t total_tokens = corpus.tokens.count * N_ROUNDS;
+    printf("%d sentences, %zu tokens, %zu valid\n", N_SENTENCES, corpus.tokens.count, n_valid);
+
+    struct timespec start;
+    volatile size_t sink = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int round = 0; round < N_ROUNDS; round++)
+        for (int i = 0; i < N_SENTENCES; i++)
+            sink += validate_tokens(&parser, &context.stack, tokens + offsets[i], offsets[i + 1] - offsets[i]);
+    report("interpreted tokens", elapsed_seconds(&start), total_tokens);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int round = 0; round < N_ROUNDS; round++)
+        for (int i = 0; i < N_SENTENCES; i++)
+            sink += bench_recognize_tokens(tokens + offsets[i], offsets[i + 1] - offsets[i]);
+    report("generated tokens", elapsed_seconds(&start), total_tokens);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int round = 0; round < N_ROUNDS; round++)
+        for (int i = 0; i < N_SENTENCES; i++)
+            sink += validate_span(&parser, &context, text + text_offsets[i], text_offsets[i + 1] - text_offsets[i]);
+    report("interpreted strings", elapsed_seconds(&start), total_tokens);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int round = 0; round < N_ROUNDS; round++)
+        for (int i = 0; i < N_SENTENCES; i++)
+            sink += bench_recognize(text + text_offsets[i], text_offsets[i + 1] - text_offsets[i]);
+    report("generated strings", elapsed_seconds(&start), total_tokens);
+
+    clear_parse_context(&context);
+    clear_list(&corpus.tokens);
+    clear_list(&corpus.offsets);
+    clear_list(&corpus.text);
+    clear_list(&corpus.text_offsets);
+    clear_parser(&parser);
+    clear_grammar(&grammar);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "synthetic.h"
+#include "../earley.h"
+
+#define N_CHECKED_SENTENCES 200
+
+typedef struct
+{
+    size_t size;
+    size_t max_length;
+    grammar_params params;
+} bench_options;
+
+static bool parse_bench_options(bench_options *options, int argc, char *argv[]);
+static double elapsed_seconds(const struct timespec *start);
+
+bool parse_bench_options(bench_options *options, int argc, char *argv[])
+{
+    options->size = 300;
+    options->max_length = 1000000;
+    init_grammar_params(&options->params);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+            return false;
+
+        if (strcmp(argv[i], "--size") == 0)
+            options->size = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--length") == 0)
+            options->max_length = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--nullable") == 0)
+            options->params.nullable_percent = atoi(argv[i + 1]);
+        else
+            return false;
+
+        i++;
+    }
+
+    return options->size > 0 && options->max_length > 0;
+}
+
+double elapsed_seconds(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Runs the Earley recognizer on LL(1) input of growing length, next to the
+// table driver, to show that it stays linear where the grammar is LL(1)
+int main(int argc, char *argv[])
+{
+    bench_options options;
+    if (!parse_bench_options(&options, argc, argv))
+    {
+        fputs("Usage: earley_bench [--size N] [--length N] [--nullable PERCENT]\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    grammar_params params = options.params;
+    params.n_nonterminals = options.size;
+    params.n_terminals = options.size / 2 + 16;
+
+    char *grammar_text;
+    size_t grammar_size;
+    FILE *grammar_file = open_memstream(&grammar_text, &grammar_size);
+    write_synthetic_grammar(&params, grammar_file);
+    fclose(grammar_file);
+
+    grammar grammar;
+    init_grammar(&grammar, 16);
+    bool loaded = create_grammar_from_buffer(&grammar, grammar_text, grammar_size);
+    free(grammar_text);
+    if (!loaded)
+    {
+        fputs("Error reading input\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    parser parser;
+    init_parser(&parser, &grammar);
+    build_parse_table(&parser);
+
+    earley_recognizer recognizer;
+    init_earley_recognizer(&recognizer, &parser);
+    sentence_generator generator;
+    init_sentence_generator(&generator, &parser, params.seed);
+    list tokens;
+    init_list(&tokens, 1024, sizeof(int));
+    list stack;
+    init_list(&stack, 16, sizeof(int));
+
+    // Short sentences and near misses are checked against the table first
+    for (size_t i = 0; i < N_CHECKED_SENTENCES; i++)
+    {
+        tokens.count = 0;
+        if (!generate_sentence(&generator, 1 + i % 64, &tokens))
+            continue;
+
+        if (i % 2)
+            make_near_miss(&generator, tokens.head, tokens.count);
+
+        if (earley_recognize(&recognizer, tokens.head, tokens.count) !=
+            validate_tokens(&parser, &stack, tokens.head, tokens.count))
+        {
+            fprintf(stderr, "ERROR: Earley recognizer disagrees with the table on sentence %zu\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("%10s %12s %12s %14s %14s\n", "tokens", "table ms", "earley ms", "items/token", "leo/token");
+    for (size_t length = 1000; length <= options.max_length; length *= 10)
+    {
+        tokens.count = 0;
+        if (!generate_sentence(&generator, length, &tokens))
+        {
+            fputs("ERROR: could not generate a sentence\n", stderr);
+            return EXIT_FAILURE;
+        }
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        bool valid = validate_tokens(&parser, &stack, tokens.head, tokens.count);
+        double table_seconds = elapsed_seconds(&start);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        bool recognized = earley_recognize(&recognizer, tokens.head, tokens.count);
+        double earley_seconds = elapsed_seconds(&start);
+        if (valid != recognized)
+        {
+            fputs("ERROR: Earley recognizer disagrees with the table\n", stderr);
+            return EXIT_FAILURE;
+        }
+
+        printf("%10zu %12.3f %12.3f %14.2f %14.2f\n", tokens.count, table_seconds * 1e3, earley_seconds * 1e3,
+               (double)recognizer.items.count / tokens.count, (double)recognizer.n_leo_completions / tokens.count);
+    }
+
+    clear_list(&stack);
+    clear_list(&tokens);
+    clear_sentence_generator(&generator);
+    clear_earley_recognizer(&recognizer);
+    clear_parser(&parser);
+    clear_grammar(&grammar);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <string.h>
+#include "synthetic.h"
+
+// Writes one sentence per line for a grammar, valid sentences and near
+// misses mixed, in the format ll1.bin --batch reads
+int main(int argc, char *argv[])
+{
+    const char *grammar_path = NULL;
+    size_t n_sentences = 1000;
+    size_t length = 50;
+    int invalid_percent = 25;
+    uint64_t seed = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--sentences") == 0 && i + 1 < argc)
+            n_sentences = atol(argv[++i]);
+        else if (strcmp(argv[i], "--length") == 0 && i + 1 < argc)
+            length = atol(argv[++i]);
+        else if (strcmp(argv[i], "--invalid") == 0 && i + 1 < argc)
+            invalid_percent = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = strtoull(argv[++i], NULL, 10);
+        else if (!grammar_path)
+            grammar_path = argv[i];
+        else
+            grammar_path = NULL;
+    }
+
+    if (!grammar_path)
+    {
+        fputs("Usage: gen_corpus <grammar> [--sentences N] [--length N] [--invalid PERCENT] [--seed N]\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    FILE *grammar_file = fopen(grammar_path, "r");
+    if (!grammar_file)
+    {
+        fputs("ERROR: could not open file\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    grammar grammar;
+    init_grammar(&grammar, 16);
+    bool loaded = create_grammar_from_file(&grammar, grammar_file);
+    fclose(grammar_file);
+    if (!loaded)
+    {
+        clear_grammar(&grammar);
+        fputs("Error reading input\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    parser parser;
+    init_parser(&parser, &grammar);
+    build_parse_table(&parser);
+    if (!is_valid_grammar(&parser))
+    {
+        printf("Grammar is not LL(1)\n");
+        clear_parser(&parser);
+        clear_grammar(&grammar);
+        return EXIT_FAILURE;
+    }
+
+    sentence_generator generator;
+    init_sentence_generator(&generator, &parser, seed);
+
+    list tokens;
+    list text;
+    init_list(&tokens, length * 2, sizeof(int));
+    init_list(&text, length * 8, sizeof(char));
+    for (size_t i = 0; i < n_sentences; i++)
+    {
+        tokens.count = 0;
+        text.count = 0;
+        if (!generate_sentence(&generator, length, &tokens))
+            continue;
+
+        if ((int)(next_random(&generator.seed) % 100) < invalid_percent)
+            make_near_miss(&generator, tokens.head, tokens.count);
+
+        write_sentence(&parser, tokens.head, tokens.count, &text);
+        fwrite(text.head, 1, text.count, stdout);
+        putchar('\n');
+    }
+
+    clear_list(&tokens);
+    clear_list(&text);
+    clear_sentence_generator(&generator);
+    clear_parser(&parser);
+    clear_grammar(&grammar);
+
+    return EXIT_SUCCESS;
+}
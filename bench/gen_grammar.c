@@ -0,0 +1,47 @@
+#include <stdio.h>
+#include <string.h>
+#include "synthetic.h"
+
+// Writes a synthetic LL(1) grammar to stdout
+int main(int argc, char *argv[])
+{
+    grammar_params params;
+    init_grammar_params(&params);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+        {
+            fputs("Usage: gen_grammar [--nonterminals N] [--terminals N] [--alternatives N] [--length N] "
+                  "[--nullable PERCENT] [--recursion N] [--seed N]\n",
+                  stderr);
+            return EXIT_FAILURE;
+        }
+
+        const char *value = argv[i + 1];
+        if (strcmp(argv[i], "--nonterminals") == 0)
+            params.n_nonterminals = atol(value);
+        else if (strcmp(argv[i], "--terminals") == 0)
+            params.n_terminals = atol(value);
+        else if (strcmp(argv[i], "--alternatives") == 0)
+            params.n_alternatives = atol(value);
+        else if (strcmp(argv[i], "--length") == 0)
+            params.max_rhs_length = atol(value);
+        else if (strcmp(argv[i], "--nullable") == 0)
+            params.nullable_percent = atoi(value);
+        else if (strcmp(argv[i], "--recursion") == 0)
+            params.recursion_depth = atol(value);
+        else if (strcmp(argv[i], "--seed") == 0)
+            params.seed = strtoull(value, NULL, 10);
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+
+        i++;
+    }
+
+    write_synthetic_grammar(&params, stdout);
+    return EXIT_SUCCESS;
+}
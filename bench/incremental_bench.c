@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "synthetic.h"
+#include "../incremental.h"
+
+#define N_CHECKED_EDITS 200
+
+typedef struct
+{
+    size_t size;
+    size_t length;
+    size_t n_edits;
+    grammar_params params;
+} bench_options;
+
+static bool parse_bench_options(bench_options *options, int argc, char *argv[]);
+static bool apply_edit(parse_session *session, sentence_generator *generator, bool check);
+static double elapsed_seconds(const struct timespec *start);
+
+bool parse_bench_options(bench_options *options, int argc, char *argv[])
+{
+    options->size = 300;
+    options->length = 200000;
+    options->n_edits = 20000;
+    init_grammar_params(&options->params);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+            return false;
+
+        if (strcmp(argv[i], "--size") == 0)
+            options->size = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--length") == 0)
+            options->length = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--edits") == 0)
+            options->n_edits = atol(argv[i + 1]);
+        else
+            return false;
+
+        i++;
+    }
+
+    return options->size > 0 && options->length > 0;
+}
+
+double elapsed_seconds(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Replaces, inserts or removes a token at random and undoes it again, so
+// the document stays the same size and mostly valid across edits
+bool apply_edit(parse_session *session, sentence_generator *generator, bool check)
+{
+    size_t n_tokens = session->tokens.count;
+    size_t position = next_random(&generator->seed) % n_tokens;
+    int original = *(int *)get_list_element(&session->tokens, position);
+    int replacement = generator->terminals[next_random(&generator->seed) % generator->n_terminals];
+
+    size_t n_removed = 0;
+    size_t n_inserted = 0;
+    switch (next_random(&generator->seed) % 3)
+    {
+    case 0:
+        n_removed = n_inserted = 1;
+        break;
+    case 1:
+        n_inserted = 1;
+        break;
+    default:
+        n_removed = 1;
+        break;
+    }
+
+    for (int step = 0; step < 2; step++)
+    {
+        edit_session_tokens(session, position, n_removed, &replacement, n_inserted);
+        if (check && session->valid != is_valid_tokens(session->parser, session->tokens.head, session->tokens.count))
+            return false;
+
+        // The undo removes what was inserted and puts the original back
+        size_t n_undo = n_inserted;
+        n_inserted = n_removed;
+        n_removed = n_undo;
+        replacement = original;
+    }
+
+    return true;
+}
+
+// Edits a long document one token at a time and compares revalidating it
+// through a parse session with parsing it from scratch
+int main(int argc, char *argv[])
+{
+    bench_options options;
+    if (!parse_bench_options(&options, argc, argv))
+    {
+        fputs("Usage: incremental_bench [--size N] [--length N] [--edits N]\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    grammar_params params = options.params;
+    params.n_nonterminals = options.size;
+    params.n_terminals = options.size / 2 + 16;
+
+    char *grammar_text;
+    size_t grammar_size;
+    FILE *grammar_file = open_memstream(&grammar_text, &grammar_size);
+    write_synthetic_grammar(&params, grammar_file);
+    fclose(grammar_file);
+
+    grammar grammar;
+    init_grammar(&grammar, 16);
+    bool loaded = create_grammar_from_buffer(&grammar, grammar_text, grammar_size);
+    free(grammar_text);
+    if (!loaded)
+    {
+        fputs("Error reading input\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    parser parser;
+    init_parser(&parser, &grammar);
+    build_parse_table(&parser);
+    if (!is_valid_grammar(&parser))
+    {
+        fputs("Generated grammar is not LL(1)\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    sentence_generator generator;
+    init_sentence_generator(&generator, &parser, params.seed);
+    list tokens;
+    init_list(&tokens, options.length, sizeof(int));
+    bool generated = generate_sentence(&generator, options.length, &tokens);
+    if (!generated || tokens.count == 0 || generator.n_terminals == 0)
+    {
+        fputs("Generated document is empty\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bool valid = is_valid_tokens(&parser, tokens.head, tokens.count);
+    double full_seconds = elapsed_seconds(&start);
+
+    parse_session session;
+    init_parse_session(&session, &parser);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    set_session_tokens(&session, tokens.head, tokens.count);
+    double session_seconds = elapsed_seconds(&start);
+    if (session.valid != valid)
+    {
+        fputs("ERROR: session disagrees with is_valid_tokens\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    // The first edits are checked against a full parse before any are timed
+    for (size_t i = 0; i < N_CHECKED_EDITS && i < options.n_edits; i++)
+    {
+        if (!apply_edit(&session, &generator, true))
+        {
+            fprintf(stderr, "ERROR: session disagrees with is_valid_tokens on edit %zu\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+
+    size_t n_reparsed = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < options.n_edits; i++)
+    {
+        apply_edit(&session, &generator, false);
+        n_reparsed += session.n_reparsed;
+    }
+    double edit_seconds = elapsed_seconds(&start);
+
+    // Every edit is applied and undone, so each counts twice
+    double n_timed = options.n_edits * 2.0;
+    printf("%zu tokens, %s, %zu stack nodes\n", tokens.count, valid ? "valid" : "invalid", session.nodes.count);
+    printf("full parse        %10.3f ms\n", full_seconds * 1e3);
+    printf("session parse     %10.3f ms, %.1fx the full parse\n", session_seconds * 1e3,
+           session_seconds / full_seconds);
+    printf("incremental edit  %10.3f us\n", edit_seconds / n_timed * 1e6);
+    printf("tokens per edit   %10.1f\n", options.n_edits > 0 ? n_reparsed / n_timed : 0.0);
+    // Included in the edit time, each costs about a session parse
+    printf("pool rebuilds     %10zu\n", session.n_rebuilds);
+
+    clear_parse_session(&session);
+    clear_list(&tokens);
+    clear_sentence_generator(&generator);
+    clear_parser(&parser);
+    clear_grammar(&grammar);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,166 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../ll1.h"
+
+#define MAX_THREADS 64
+
+typedef struct
+{
+    const char *grammar_path;
+    const char *sentence;
+    size_t n_requests;
+    size_t n_processes;
+} bench_options;
+
+typedef struct
+{
+    const ll1_parser *parser;
+    const char *sentence;
+    size_t n_requests;
+    bool failed;
+} worker;
+
+static bool parse_bench_options(bench_options *options, int argc, char *argv[]);
+static double elapsed_seconds(const struct timespec *start);
+static void *run_worker(void *arg);
+
+bool parse_bench_options(bench_options *options, int argc, char *argv[])
+{
+    options->grammar_path = NULL;
+    options->sentence = "( id + id ) * id + id * id";
+    options->n_requests = 1000000;
+    options->n_processes = 50;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--sentence") == 0 && i + 1 < argc)
+            options->sentence = argv[++i];
+        else if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc)
+            options->n_requests = atol(argv[++i]);
+        else if (strcmp(argv[i], "--processes") == 0 && i + 1 < argc)
+            options->n_processes = atol(argv[++i]);
+        else if (!options->grammar_path)
+            options->grammar_path = argv[i];
+        else
+            return false;
+    }
+
+    return options->grammar_path && options->n_requests > 0;
+}
+
+double elapsed_seconds(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+void *run_worker(void *arg)
+{
+    worker *worker = arg;
+    ll1_context *context;
+    if (ll1_context_create(&context) != LL1_OK)
+    {
+        worker->failed = true;
+        return NULL;
+    }
+
+    size_t length = strlen(worker->sentence);
+    for (size_t i = 0; i < worker->n_requests; i++)
+    {
+        if (ll1_validate_string(worker->parser, context, worker->sentence, length) != LL1_OK)
+            worker->failed = true;
+    }
+
+    ll1_context_free(context);
+    return NULL;
+}
+
+// Times requests against one parser built in process, from more and more
+// threads, next to starting ll1.bin for every request
+int main(int argc, char *argv[])
+{
+    bench_options options;
+    if (!parse_bench_options(&options, argc, argv))
+    {
+        fputs("Usage: library_bench GRAMMAR [--sentence S] [--requests N] [--processes N]\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ll1_grammar *grammar;
+    ll1_parser *parser;
+    ll1_status status = ll1_grammar_load(options.grammar_path, &grammar);
+    if (status == LL1_OK)
+    {
+        status = ll1_parser_build(grammar, 1, &parser);
+        if (status != LL1_OK)
+            ll1_grammar_free(grammar);
+    }
+
+    if (status != LL1_OK)
+    {
+        fprintf(stderr, "ERROR: %s\n", ll1_status_string(status));
+        return EXIT_FAILURE;
+    }
+
+    printf("build: %.3f ms\n\n", elapsed_seconds(&start) * 1e3);
+    printf("%8s %14s %14s\n", "threads", "us/request", "requests/s");
+    for (size_t n_threads = 1; n_threads <= MAX_THREADS; n_threads *= 2)
+    {
+        pthread_t threads[MAX_THREADS];
+        worker workers[MAX_THREADS];
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t i = 0; i < n_threads; i++)
+        {
+            workers[i] = (worker){parser, options.sentence, options.n_requests / n_threads, false};
+            pthread_create(&threads[i], NULL, run_worker, &workers[i]);
+        }
+
+        bool failed = false;
+        for (size_t i = 0; i < n_threads; i++)
+        {
+            pthread_join(threads[i], NULL);
+            failed = failed || workers[i].failed;
+        }
+
+        double seconds = elapsed_seconds(&start);
+        if (failed)
+        {
+            fputs("ERROR: sentence was not accepted\n", stderr);
+            return EXIT_FAILURE;
+        }
+
+        size_t n_done = options.n_requests / n_threads * n_threads;
+        printf("%8zu %14.3f %14.0f\n", n_threads, seconds * 1e6 / n_done * n_threads, n_done / seconds);
+    }
+
+    // What a service pays when it runs the binary for each request
+    char command[4096];
+    snprintf(command, sizeof(command), "./ll1.bin %s > /dev/null", options.grammar_path);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < options.n_processes; i++)
+    {
+        FILE *process = popen(command, "w");
+        if (!process)
+        {
+            fputs("ERROR: could not start ll1.bin\n", stderr);
+            return EXIT_FAILURE;
+        }
+
+        fprintf(process, "%s\n", options.sentence);
+        pclose(process);
+    }
+
+    if (options.n_processes > 0)
+        printf("\nprocess per request: %.3f us/request\n", elapsed_seconds(&start) * 1e6 / options.n_processes);
+
+    ll1_parser_free(parser);
+    ll1_grammar_free(grammar);
+    return EXIT_SUCCESS;
+}
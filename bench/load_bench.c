@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "synthetic.h"
+
+#define MAX_SIZES 32
+
+static double elapsed_seconds(const struct timespec *start);
+
+double elapsed_seconds(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Loads synthetic grammars from memory at growing sizes, load time per rule
+// should stay flat if loading is linear in the input size
+int main(int argc, char *argv[])
+{
+    size_t sizes[MAX_SIZES] = {300, 3000, 30000, 300000};
+    size_t n_sizes = 4;
+    if (argc == 3 && strcmp(argv[1], "--sizes") == 0)
+    {
+        n_sizes = 0;
+        for (char *size = strtok(argv[2], ","); size && n_sizes < MAX_SIZES; size = strtok(NULL, ","))
+            sizes[n_sizes++] = atol(size);
+    }
+    else if (argc != 1)
+    {
+        fputs("Usage: load_bench [--sizes N,N,...]\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    printf("%12s %10s %10s %10s %10s %10s %10s\n", "nonterminals", "rules", "symbols", "MB", "load ms", "ns/rule",
+           "clear ms");
+    for (size_t i = 0; i < n_sizes; i++)
+    {
+        grammar_params params;
+        init_grammar_params(&params);
+        params.n_nonterminals = sizes[i];
+        params.n_terminals = 2000;
+
+        char *text;
+        size_t text_size;
+        FILE *text_file = open_memstream(&text, &text_size);
+        write_synthetic_grammar(&params, text_file);
+        fclose(text_file);
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        grammar grammar;
+        init_grammar(&grammar, 16);
+        bool loaded = create_grammar_from_buffer(&grammar, text, text_size);
+        double load_seconds = elapsed_seconds(&start);
+
+        size_t n_rules = grammar.rules.count;
+        size_t n_symbols = grammar.symbols.count;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        clear_grammar(&grammar);
+        double clear_seconds = elapsed_seconds(&start);
+        free(text);
+
+        if (!loaded)
+        {
+            fputs("Error reading input\n", stderr);
+            return EXIT_FAILURE;
+        }
+
+        printf("%12zu %10zu %10zu %10.1f %10.2f %10.1f %10.2f\n", sizes[i], n_rules, n_symbols, text_size / 1e6,
+               load_seconds * 1e3, load_seconds * 1e9 / n_rules, clear_seconds * 1e3);
+    }
+
+    return EXIT_SUCCESS;
+}
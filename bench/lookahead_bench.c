@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../lookahead.h"
+#include "../stream.h"
+
+typedef struct
+{
+    size_t n_forms;
+    size_t length;
+    size_t max_lookahead;
+} bench_options;
+
+typedef struct
+{
+    double validate_seconds;
+    double stream_seconds;
+    bool valid;
+} bench_result;
+
+static bool parse_bench_options(bench_options *options, int argc, char *argv[]);
+static double elapsed_seconds(const struct timespec *start);
+static char *write_grammar(size_t n_forms, size_t lookahead, bool factored);
+static char *write_input(size_t n_forms, size_t lookahead, size_t length);
+static bool build_bench_parser(parser *parser, grammar *grammar, const char *text, size_t max_lookahead);
+static bench_result time_parser(const parser *parser, const char *input);
+
+bool parse_bench_options(bench_options *options, int argc, char *argv[])
+{
+    options->n_forms = 64;
+    options->length = 1000000;
+    options->max_lookahead = 5;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+            return false;
+
+        if (strcmp(argv[i], "--forms") == 0)
+            options->n_forms = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--length") == 0)
+            options->length = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--lookahead") == 0)
+            options->max_lookahead = atol(argv[i + 1]);
+        else
+            return false;
+
+        i++;
+    }
+
+    return options->n_forms > 0 && options->length > 0 && options->max_lookahead >= 2 &&
+           options->max_lookahead <= MAX_LOOKAHEAD;
+}
+
+double elapsed_seconds(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Statements that share lookahead - 1 leading tokens and differ in the last
+// one. The factored grammar has the same language with a nonterminal for
+// the last token, so it is LL(1).
+char *write_grammar(size_t n_forms, size_t lookahead, bool factored)
+{
+    char *text;
+    size_t size;
+    FILE *file = open_memstream(&text, &size);
+    fputs("L ::= T L\nL ::= \"\n", file);
+    if (factored)
+    {
+        fputs("T ::=", file);
+        for (size_t i = 1; i < lookahead; i++)
+            fputs(" p", file);
+        fputs(" Y\n", file);
+    }
+
+    for (size_t form = 0; form < n_forms; form++)
+    {
+        fputs(factored ? "Y ::=" : "T ::=", file);
+        for (size_t i = 1; i < lookahead && !factored; i++)
+            fputs(" p", file);
+        fprintf(file, " x%zu\n", form);
+    }
+
+    fclose(file);
+    return text;
+}
+
+char *write_input(size_t n_forms, size_t lookahead, size_t length)
+{
+    char *text;
+    size_t size;
+    FILE *file = open_memstream(&text, &size);
+    srand(1);
+    for (size_t n_tokens = 0; n_tokens < length; n_tokens += lookahead)
+    {
+        for (size_t i = 1; i < lookahead; i++)
+            fputs("p ", file);
+        fprintf(file, "x%d ", (int)(rand() % n_forms));
+    }
+
+    fclose(file);
+    return text;
+}
+
+bool build_bench_parser(parser *parser, grammar *grammar, const char *text, size_t max_lookahead)
+{
+    init_grammar(grammar, 16);
+    if (!create_grammar_from_buffer(grammar, text, strlen(text)))
+        return false;
+
+    init_parser(parser, grammar);
+    parser->max_lookahead = max_lookahead;
+    build_parse_table(parser);
+    return is_valid_grammar(parser);
+}
+
+bench_result time_parser(const parser *parser, const char *input)
+{
+    bench_result result;
+    list tokens;
+    init_list(&tokens, 1024, sizeof(int));
+    list stack;
+    init_list(&stack, 16, sizeof(int));
+    tokenize_string(parser, input, &tokens);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    result.valid = validate_tokens(parser, &stack, tokens.head, tokens.count);
+    result.validate_seconds = elapsed_seconds(&start);
+
+    // The stream tokenizes as it goes, so its time includes the lookups
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    parse_stream stream;
+    begin_stream(&stream, parser);
+    feed_stream(&stream, input, strlen(input));
+    result.valid = end_stream(&stream) && result.valid;
+    result.stream_seconds = elapsed_seconds(&start);
+
+    clear_list(&stack);
+    clear_list(&tokens);
+    return result;
+}
+
+// Builds grammars that need more and more lookahead in one cell, and
+// compares the size of their tries with a dense LL(k) table and their
+// parse speed with the left factored LL(1) grammar of the same language
+int main(int argc, char *argv[])
+{
+    bench_options options;
+    if (!parse_bench_options(&options, argc, argv))
+    {
+        fputs("Usage: lookahead_bench [--forms N] [--length N] [--lookahead K]\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    printf("%3s %8s %12s %14s %14s %14s %14s\n", "k", "nodes", "trie bytes", "dense bytes", "LL(k) ns/tok",
+           "LL(1) ns/tok", "stream ns/tok");
+    for (size_t lookahead = 2; lookahead <= options.max_lookahead; lookahead++)
+    {
+        char *text = write_grammar(options.n_forms, lookahead, false);
+        char *factored_text = write_grammar(options.n_forms, lookahead, true);
+        char *input = write_input(options.n_forms, lookahead, options.length);
+
+        grammar lookahead_grammar;
+        parser lookahead_parser;
+        bool built = build_bench_parser(&lookahead_parser, &lookahead_grammar, text, lookahead);
+        grammar factored_grammar;
+        parser factored_parser;
+        bool factored_built = build_bench_parser(&factored_parser, &factored_grammar, factored_text, 1);
+        if (!built || !factored_built || lookahead_parser.lookahead_depth != lookahead)
+        {
+            fputs("ERROR: bench grammar was not resolved with the expected lookahead\n", stderr);
+            return EXIT_FAILURE;
+        }
+
+        bench_result result = time_parser(&lookahead_parser, input);
+        bench_result factored_result = time_parser(&factored_parser, input);
+        if (!result.valid || !factored_result.valid)
+        {
+            fputs("ERROR: bench input was rejected\n", stderr);
+            return EXIT_FAILURE;
+        }
+
+        // A table keyed on every k tokens has a cell per nonterminal and
+        // terminal string
+        double dense_bytes = lookahead_parser.n_nonterminals * sizeof(int);
+        for (size_t i = 0; i < lookahead; i++)
+            dense_bytes *= lookahead_parser.n_terminals;
+
+        size_t trie_bytes = lookahead_parser.lookahead_nodes.count * sizeof(lookahead_node) +
+                            lookahead_parser.lookahead_edges.count * sizeof(lookahead_edge);
+        double n_tokens = options.length;
+        printf("%3zu %8zu %12zu %14.3g %14.2f %14.2f %14.2f\n", lookahead, lookahead_parser.lookahead_nodes.count,
+               trie_bytes, dense_bytes, result.validate_seconds * 1e9 / n_tokens,
+               factored_result.validate_seconds * 1e9 / n_tokens, result.stream_seconds * 1e9 / n_tokens);
+
+        clear_parser(&lookahead_parser);
+        clear_grammar(&lookahead_grammar);
+        clear_parser(&factored_parser);
+        clear_grammar(&factored_grammar);
+        free(input);
+        free(factored_text);
+        free(text);
+    }
+
+    return EXIT_SUCCESS;
+}
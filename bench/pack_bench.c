@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../packed.h"
+#include "synthetic.h"
+
+#define N_LOOKUPS (1 << 20)
+#define INVALID_PERCENT 20
+
+typedef struct
+{
+    size_t n_sizes;
+    size_t n_sentences;
+    size_t length;
+    int rounds;
+} bench_options;
+
+typedef struct
+{
+    double lookup_ns;
+    double token_ns;
+    size_t n_valid;
+    int sink;
+} bench_result;
+
+static bool parse_bench_options(bench_options *options, int argc, char *argv[]);
+static double elapsed_seconds(const struct timespec *start);
+static bool build_bench_parser(parser *parser, grammar *grammar, size_t size);
+static bool matches_dense_table(parser *parser);
+static bench_result time_parser(const parser *parser, const int *lookups, const list *tokens, const list *offsets,
+                                int rounds);
+
+bool parse_bench_options(bench_options *options, int argc, char *argv[])
+{
+    options->n_sizes = 4;
+    options->n_sentences = 2000;
+    options->length = 200;
+    options->rounds = 5;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+            return false;
+
+        if (strcmp(argv[i], "--sizes") == 0)
+            options->n_sizes = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--sentences") == 0)
+            options->n_sentences = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--length") == 0)
+            options->length = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--rounds") == 0)
+            options->rounds = atoi(argv[i + 1]);
+        else
+            return false;
+
+        i++;
+    }
+
+    return options->n_sizes > 0 && options->n_sentences > 0 && options->length > 0 && options->rounds > 0;
+}
+
+double elapsed_seconds(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+bool build_bench_parser(parser *parser, grammar *grammar, size_t size)
+{
+    grammar_params params;
+    init_grammar_params(&params);
+    params.n_nonterminals = size;
+    params.n_terminals = size / 2 + 16;
+
+    char *text;
+    size_t length;
+    FILE *file = open_memstream(&text, &length);
+    write_synthetic_grammar(&params, file);
+    fclose(file);
+
+    init_grammar(grammar, 16);
+    bool loaded = create_grammar_from_buffer(grammar, text, length);
+    free(text);
+    if (!loaded)
+        return false;
+
+    init_parser(parser, grammar);
+    build_parse_table(parser);
+    return is_valid_grammar(parser);
+}
+
+// Every cell read through the packed table is the dense one
+bool matches_dense_table(parser *parser)
+{
+    const grammar *grammar = parser->grammar;
+    for (size_t i = 0; i < grammar->symbols.count; i++)
+    {
+        if (parser->terminal_symbols[i])
+            continue;
+
+        for (size_t k = 0; k < grammar->symbols.count; k++)
+        {
+            if (!parser->terminal_symbols[k])
+                continue;
+
+            int dense = parser->table[parser->symbol_ordinals[i] * parser->n_terminals + parser->symbol_ordinals[k]];
+            if (get_matching_rule(parser, i, k) != dense)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+bench_result time_parser(const parser *parser, const int *lookups, const list *tokens, const list *offsets,
+                         int rounds)
+{
+    bench_result result = {0};
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int round = 0; round < rounds; round++)
+    {
+        for (size_t i = 0; i < N_LOOKUPS; i++)
+            result.sink += get_matching_rule(parser, lookups[2 * i], lookups[2 * i + 1]);
+    }
+    result.lookup_ns = elapsed_seconds(&start) * 1e9 / ((double)N_LOOKUPS * rounds);
+
+    list stack;
+    init_list(&stack, 64, sizeof(int));
+    const size_t *sentence_offsets = offsets->head;
+    size_t n_sentences = offsets->count - 1;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int round = 0; round < rounds; round++)
+    {
+        result.n_valid = 0;
+        for (size_t i = 0; i < n_sentences; i++)
+            result.n_valid += validate_tokens(parser, &stack, (int *)tokens->head + sentence_offsets[i],
+                                              sentence_offsets[i + 1] - sentence_offsets[i]);
+    }
+    result.token_ns = elapsed_seconds(&start) * 1e9 / ((double)tokens->count * rounds);
+
+    clear_list(&stack);
+    return result;
+}
+
+// Packs the tables of larger and larger generated grammars, and compares
+// their size and the speed of random cell lookups and of validating
+// sentences with the dense table
+int main(int argc, char *argv[])
+{
+    bench_options options;
+    if (!parse_bench_options(&options, argc, argv))
+    {
+        fputs("Usage: pack_bench [--sizes N] [--sentences N] [--length N] [--rounds N]\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    printf("%8s %12s %12s %7s %7s %9s %12s %12s %12s %12s\n", "rows", "dense bytes", "packed bytes", "ratio",
+           "fill", "pack ms", "dense ns/op", "packed ns/op", "dense ns/tok", "packed ns/tok");
+
+    size_t size = 100;
+    for (size_t n = 0; n < options.n_sizes; n++, size *= 4)
+    {
+        grammar grammar;
+        parser parser;
+        if (!build_bench_parser(&parser, &grammar, size))
+        {
+            fputs("ERROR: generated grammar is not LL(1)\n", stderr);
+            return EXIT_FAILURE;
+        }
+
+        // Random cells of the whole table, most of them empty
+        int *nonterminals = malloc(parser.n_nonterminals * sizeof(int));
+        int *terminals = malloc(parser.n_terminals * sizeof(int));
+        for (size_t i = 0; i < grammar.symbols.count; i++)
+        {
+            if (parser.terminal_symbols[i])
+                terminals[parser.symbol_ordinals[i]] = i;
+            else
+                nonterminals[parser.symbol_ordinals[i]] = i;
+        }
+
+        uint64_t seed = size;
+        int *lookups = malloc(2 * N_LOOKUPS * sizeof(int));
+        for (size_t i = 0; i < N_LOOKUPS; i++)
+        {
+            lookups[2 * i] = nonterminals[next_random(&seed) % parser.n_nonterminals];
+            lookups[2 * i + 1] = terminals[next_random(&seed) % parser.n_terminals];
+        }
+
+        sentence_generator generator;
+        init_sentence_generator(&generator, &parser, seed);
+        list tokens;
+        list offsets;
+        init_list(&tokens, options.n_sentences * options.length, sizeof(int));
+        init_list(&offsets, options.n_sentences + 1, sizeof(size_t));
+        *(size_t *)push_back(&offsets) = 0;
+        for (size_t i = 0; i < options.n_sentences; i++)
+        {
+            size_t first = tokens.count;
+            if (!generate_sentence(&generator, options.length, &tokens))
+                continue;
+
+            if ((int)(next_random(&generator.seed) % 100) < INVALID_PERCENT)
+                make_near_miss(&generator, (int *)tokens.head + first, tokens.count - first);
+
+            *(size_t *)push_back(&offsets) = tokens.count;
+        }
+
+        bench_result dense = time_parser(&parser, lookups, &tokens, &offsets, options.rounds);
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        bool packed = pack_parse_table(&parser);
+        double pack_seconds = elapsed_seconds(&start);
+        if (!packed || !matches_dense_table(&parser))
+        {
+            fputs("ERROR: packed table does not match the dense table\n", stderr);
+            return EXIT_FAILURE;
+        }
+
+        bench_result result = time_parser(&parser, lookups, &tokens, &offsets, options.rounds);
+        if (result.n_valid != dense.n_valid || result.sink != dense.sink)
+        {
+            fputs("ERROR: packed table gave other results than the dense table\n", stderr);
+            return EXIT_FAILURE;
+        }
+
+        size_t n_entries = 0;
+        for (size_t i = 0; i < parser.n_packed_cells; i++)
+            n_entries += parser.packed_cells[i].row >= 0;
+
+        size_t dense_bytes = parser.n_nonterminals * parser.n_terminals * sizeof(int);
+        size_t packed_bytes = parser.n_nonterminals * sizeof(int) + parser.n_packed_cells * sizeof(packed_cell);
+        printf("%8zu %12zu %12zu %6.1fx %6.1f%% %9.2f %12.2f %12.2f %12.2f %12.2f\n", parser.n_nonterminals,
+               dense_bytes, packed_bytes, (double)dense_bytes / packed_bytes,
+               100.0 * n_entries / parser.n_packed_cells, pack_seconds * 1e3, dense.lookup_ns, result.lookup_ns,
+               dense.token_ns, result.token_ns);
+
+        clear_list(&offsets);
+        clear_list(&tokens);
+        clear_sentence_generator(&generator);
+        free(lookups);
+        free(terminals);
+        free(nonterminals);
+        clear_parser(&parser);
+        clear_grammar(&grammar);
+    }
+
+    return EXIT_SUCCESS;
+}
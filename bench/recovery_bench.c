@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "synthetic.h"
+#include "../recovery.h"
+
+typedef struct
+{
+    size_t size;
+    size_t length;
+    grammar_params params;
+} bench_options;
+
+static bool parse_bench_options(bench_options *options, int argc, char *argv[]);
+static double elapsed_seconds(const struct timespec *start);
+
+bool parse_bench_options(bench_options *options, int argc, char *argv[])
+{
+    options->size = 300;
+    options->length = 200000;
+    init_grammar_params(&options->params);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+            return false;
+
+        if (strcmp(argv[i], "--size") == 0)
+            options->size = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--length") == 0)
+            options->length = atol(argv[i + 1]);
+        else
+            return false;
+
+        i++;
+    }
+
+    return options->size > 0 && options->length > 0;
+}
+
+double elapsed_seconds(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Damages a long document in more and more places and times one recovering
+// pass over it against a plain validation, which stops at the first error
+int main(int argc, char *argv[])
+{
+    bench_options options;
+    if (!parse_bench_options(&options, argc, argv))
+    {
+        fputs("Usage: recovery_bench [--size N] [--length N]\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    grammar_params params = options.params;
+    params.n_nonterminals = options.size;
+    params.n_terminals = options.size / 2 + 16;
+
+    char *grammar_text;
+    size_t grammar_size;
+    FILE *grammar_file = open_memstream(&grammar_text, &grammar_size);
+    write_synthetic_grammar(&params, grammar_file);
+    fclose(grammar_file);
+
+    grammar grammar;
+    init_grammar(&grammar, 16);
+    bool loaded = create_grammar_from_buffer(&grammar, grammar_text, grammar_size);
+    free(grammar_text);
+    if (!loaded)
+    {
+        fputs("Error reading input\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    parser parser;
+    init_parser(&parser, &grammar);
+    build_parse_table(&parser);
+    if (!is_valid_grammar(&parser))
+    {
+        fputs("Generated grammar is not LL(1)\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    sentence_generator generator;
+    init_sentence_generator(&generator, &parser, params.seed);
+    list tokens;
+    init_list(&tokens, options.length, sizeof(int));
+    bool generated = generate_sentence(&generator, options.length, &tokens);
+    if (!generated || tokens.count == 0 || generator.n_terminals == 0)
+    {
+        fputs("Generated document is empty\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    list stack;
+    init_list(&stack, 16, sizeof(int));
+    error_report report;
+    init_error_report(&report);
+    int *document = tokens.head;
+
+    printf("%zu tokens\n", tokens.count);
+    printf("%10s %10s %10s %12s %12s %12s\n", "damaged", "errors", "panic", "validate ms", "recover ms",
+           "no repair ms");
+
+    size_t n_damaged = 0;
+    for (size_t target = 0; target <= tokens.count / 10; target = target ? target * 10 : 1)
+    {
+        for (; n_damaged < target; n_damaged++)
+        {
+            size_t position = next_random(&generator.seed) % tokens.count;
+            document[position] = generator.terminals[next_random(&generator.seed) % generator.n_terminals];
+        }
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        bool valid = validate_tokens(&parser, &stack, document, tokens.count);
+        double validate_seconds = elapsed_seconds(&start);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        recover_tokens(&parser, &stack, document, tokens.count, false, &report);
+        double panic_seconds = elapsed_seconds(&start);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        bool recovered = recover_tokens(&parser, &stack, document, tokens.count, true, &report);
+        double recover_seconds = elapsed_seconds(&start);
+        if (valid != recovered)
+        {
+            fputs("ERROR: recovery disagrees with validate_tokens\n", stderr);
+            return EXIT_FAILURE;
+        }
+
+        size_t n_panic = 0;
+        for (size_t i = 0; i < report.errors.count; i++)
+            n_panic += ((parse_error *)get_list_element(&report.errors, i))->repair == REPAIR_NONE;
+
+        printf("%10zu %10zu %10zu %12.3f %12.3f %12.3f\n", n_damaged, report.errors.count, n_panic,
+               validate_seconds * 1e3, recover_seconds * 1e3, panic_seconds * 1e3);
+    }
+
+    clear_error_report(&report);
+    clear_list(&stack);
+    clear_list(&tokens);
+    clear_sentence_generator(&generator);
+    clear_parser(&parser);
+    clear_grammar(&grammar);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,406 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "../server.h"
+#include "synthetic.h"
+
+#define MAX_CONNECTIONS 256
+// How long to wait for a server that is still building its tables
+#define CONNECT_SECONDS 10
+#define MAX_GENERATE_ATTEMPTS 100
+
+typedef struct
+{
+    const char *socket_path;
+    const char *grammar_path;
+    uint32_t grammar_index;
+    size_t n_connections;
+    size_t depth;
+    size_t batch;
+    size_t n_requests;
+    size_t n_sentences;
+    size_t length;
+} bench_options;
+
+// Request frames built up front, with the results a local parser gave
+typedef struct
+{
+    list frames;
+    list frame_offsets;
+    list expected;
+    size_t n_frames;
+} request_set;
+
+typedef struct
+{
+    const bench_options *options;
+    const request_set *requests;
+    size_t n_requests;
+    // Seconds from sending each request to reading its response
+    double *latencies;
+    size_t n_sentences;
+    size_t n_valid;
+    bool failed;
+} client;
+
+static bool parse_bench_options(bench_options *options, int argc, char *argv[]);
+static double now_seconds(void);
+static bool build_requests(const bench_options *options, request_set *requests);
+static int connect_server(const char *socket_path);
+static bool write_all(int fd, const char *data, size_t size);
+static bool read_all(int fd, char *data, size_t size);
+static void *run_client(void *arg);
+static int compare_doubles(const void *a, const void *b);
+
+bool parse_bench_options(bench_options *options, int argc, char *argv[])
+{
+    options->socket_path = NULL;
+    options->grammar_path = NULL;
+    options->grammar_index = 0;
+    options->n_connections = 4;
+    options->depth = 8;
+    options->batch = 64;
+    options->n_requests = 20000;
+    options->n_sentences = 4096;
+    options->length = 30;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--grammar") == 0 && i + 1 < argc)
+            options->grammar_index = atol(argv[++i]);
+        else if (strcmp(argv[i], "--connections") == 0 && i + 1 < argc)
+            options->n_connections = atol(argv[++i]);
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+            options->depth = atol(argv[++i]);
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+            options->batch = atol(argv[++i]);
+        else if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc)
+            options->n_requests = atol(argv[++i]);
+        else if (strcmp(argv[i], "--sentences") == 0 && i + 1 < argc)
+            options->n_sentences = atol(argv[++i]);
+        else if (strcmp(argv[i], "--length") == 0 && i + 1 < argc)
+            options->length = atol(argv[++i]);
+        else if (!options->socket_path)
+            options->socket_path = argv[i];
+        else if (!options->grammar_path)
+            options->grammar_path = argv[i];
+        else
+            return false;
+    }
+
+    return options->grammar_path && options->n_connections > 0 && options->n_connections <= MAX_CONNECTIONS &&
+           options->depth > 0 && options->batch > 0 && options->n_requests >= options->n_connections &&
+           options->n_sentences > 0;
+}
+
+double now_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Generates sentences for the grammar the server was given, valid ones and
+// near misses mixed, and packs them batch by batch into request frames
+bool build_requests(const bench_options *options, request_set *requests)
+{
+    FILE *grammar_file = fopen(options->grammar_path, "r");
+    if (!grammar_file)
+        return false;
+
+    grammar grammar;
+    init_grammar(&grammar, 16);
+    bool loaded = create_grammar_from_file(&grammar, grammar_file);
+    fclose(grammar_file);
+    parser parser;
+    init_parser(&parser, &grammar);
+    if (loaded)
+        build_parse_table(&parser);
+
+    if (!loaded || !is_valid_grammar(&parser))
+    {
+        clear_parser(&parser);
+        clear_grammar(&grammar);
+        return false;
+    }
+
+    sentence_generator generator;
+    init_sentence_generator(&generator, &parser, 1);
+    list tokens;
+    list text;
+    init_list(&tokens, options->length * 2, sizeof(int));
+    init_list(&text, options->length * 8, sizeof(char));
+
+    requests->n_frames = (options->n_sentences + options->batch - 1) / options->batch;
+    init_list(&requests->frames, 1 << 16, sizeof(char));
+    init_list(&requests->frame_offsets, requests->n_frames + 1, sizeof(size_t));
+    init_list(&requests->expected, options->n_sentences, sizeof(bool));
+    bool generated = true;
+    for (size_t frame = 0; frame < requests->n_frames && generated; frame++)
+    {
+        size_t first = frame * options->batch;
+        uint32_t n_sentences = first + options->batch < options->n_sentences ? options->batch
+                                                                                : options->n_sentences - first;
+        size_t start = requests->frames.count;
+        *(size_t *)push_back(&requests->frame_offsets) = start;
+
+        // Size and id are filled in when the frame is sent
+        uint32_t header[4] = {0, 0, options->grammar_index, n_sentences};
+        push_back_many(&requests->frames, header, sizeof(header));
+        for (uint32_t i = 0; i < n_sentences; i++)
+        {
+            tokens.count = 0;
+            text.count = 0;
+
+            // Frames are sized up front, so a sentence that runs into a
+            // nonterminal with no finite derivation is generated again
+            int attempt = 0;
+            while (attempt < MAX_GENERATE_ATTEMPTS && !generate_sentence(&generator, options->length, &tokens))
+                attempt++;
+            if (attempt == MAX_GENERATE_ATTEMPTS)
+            {
+                generated = false;
+                break;
+            }
+            if (next_random(&generator.seed) % 100 < 25)
+                make_near_miss(&generator, tokens.head, tokens.count);
+
+            write_sentence(&parser, tokens.head, tokens.count, &text);
+            *(bool *)push_back(&requests->expected) = is_valid_tokens(&parser, tokens.head, tokens.count);
+            uint32_t length = text.count;
+            push_back_many(&requests->frames, &length, sizeof(length));
+            if (length > 0)
+                push_back_many(&requests->frames, text.head, length);
+        }
+
+        uint32_t size = requests->frames.count - start - sizeof(uint32_t);
+        memcpy((char *)requests->frames.head + start, &size, sizeof(size));
+    }
+
+    *(size_t *)push_back(&requests->frame_offsets) = requests->frames.count;
+
+    clear_list(&tokens);
+    clear_list(&text);
+    clear_sentence_generator(&generator);
+    clear_parser(&parser);
+    clear_grammar(&grammar);
+    return generated;
+}
+
+int connect_server(const char *socket_path)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(socket_path) >= sizeof(address.sun_path))
+        return -1;
+
+    strcpy(address.sun_path, socket_path);
+    double deadline = now_seconds() + CONNECT_SECONDS;
+    while (true)
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+
+        if (connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0)
+            return fd;
+
+        close(fd);
+        if (now_seconds() > deadline)
+            return -1;
+
+        usleep(10000);
+    }
+}
+
+bool write_all(int fd, const char *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t length = write(fd, data, size);
+        if (length < 0 && errno == EINTR)
+            continue;
+        if (length <= 0)
+            return false;
+
+        data += length;
+        size -= length;
+    }
+
+    return true;
+}
+
+bool read_all(int fd, char *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t length = read(fd, data, size);
+        if (length < 0 && errno == EINTR)
+            continue;
+        if (length <= 0)
+            return false;
+
+        data += length;
+        size -= length;
+    }
+
+    return true;
+}
+
+// Keeps depth requests in flight on one connection and checks every result
+// against the local parser
+void *run_client(void *arg)
+{
+    client *client = arg;
+    const bench_options *options = client->options;
+    const request_set *requests = client->requests;
+    const size_t *offsets = requests->frame_offsets.head;
+    const bool *expected = requests->expected.head;
+
+    int fd = connect_server(options->socket_path);
+    if (fd < 0)
+    {
+        client->failed = true;
+        return NULL;
+    }
+
+    double *sent_at = malloc(client->n_requests * sizeof(double));
+    list frame;
+    list response;
+    init_list(&frame, 1 << 16, sizeof(char));
+    init_list(&response, 1024, sizeof(char));
+    size_t n_sent = 0;
+    size_t n_done = 0;
+    while (n_done < client->n_requests && !client->failed)
+    {
+        while (n_sent < client->n_requests && n_sent - n_done < options->depth)
+        {
+            // Ids double as indices of the send times
+            size_t index = n_sent % requests->n_frames;
+            size_t size = offsets[index + 1] - offsets[index];
+            frame.count = 0;
+            push_back_many(&frame, (char *)requests->frames.head + offsets[index], size);
+            uint32_t id = n_sent;
+            memcpy((char *)frame.head + sizeof(uint32_t), &id, sizeof(id));
+            sent_at[n_sent++] = now_seconds();
+            if (!write_all(fd, frame.head, size))
+            {
+                client->failed = true;
+                break;
+            }
+        }
+
+        uint32_t header[4];
+        if (client->failed || !read_all(fd, (char *)header, sizeof(header)) || header[0] < SERVER_HEADER_SIZE - 4)
+        {
+            client->failed = true;
+            break;
+        }
+
+        size_t n_bytes = header[0] - (SERVER_HEADER_SIZE - sizeof(uint32_t));
+        reserve_list(&response, n_bytes);
+        uint32_t id = header[1];
+        if (!read_all(fd, response.head, n_bytes) || id >= n_sent || header[2] != SERVER_OK)
+        {
+            client->failed = true;
+            break;
+        }
+
+        client->latencies[n_done++] = now_seconds() - sent_at[id];
+        size_t index = id % requests->n_frames;
+        const unsigned char *results = response.head;
+        client->n_sentences += header[3];
+        for (uint32_t i = 0; i < header[3]; i++)
+        {
+            bool valid = results[i / 8] & (1 << (i % 8));
+            client->n_valid += valid;
+            if (valid != expected[index * options->batch + i])
+                client->failed = true;
+        }
+    }
+
+    close(fd);
+    clear_list(&response);
+    clear_list(&frame);
+    free(sent_at);
+    return NULL;
+}
+
+int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Load generator for ll1.bin --serve. Every connection keeps a number of
+// batch requests in flight and the latency of each request is recorded from
+// its first byte sent to its response read.
+int main(int argc, char *argv[])
+{
+    bench_options options;
+    if (!parse_bench_options(&options, argc, argv))
+    {
+        fputs("Usage: server_bench SOCKET GRAMMAR [--grammar INDEX] [--connections N] [--depth N] [--batch N]\n"
+              "                    [--requests N] [--sentences N] [--length N]\n",
+              stderr);
+        return EXIT_FAILURE;
+    }
+
+    request_set requests;
+    if (!build_requests(&options, &requests))
+    {
+        fputs("ERROR: could not build an LL(1) parser and sentences for the grammar\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    pthread_t threads[MAX_CONNECTIONS];
+    client clients[MAX_CONNECTIONS];
+    double *latencies = malloc(options.n_requests * sizeof(double));
+    size_t n_assigned = 0;
+    double start = now_seconds();
+    for (size_t i = 0; i < options.n_connections; i++)
+    {
+        size_t n_requests = options.n_requests * (i + 1) / options.n_connections - n_assigned;
+        clients[i] = (client){&options, &requests, n_requests, latencies + n_assigned, 0, 0, false};
+        n_assigned += n_requests;
+        pthread_create(&threads[i], NULL, run_client, &clients[i]);
+    }
+
+    bool failed = false;
+    size_t n_sentences = 0;
+    size_t n_valid = 0;
+    for (size_t i = 0; i < options.n_connections; i++)
+    {
+        pthread_join(threads[i], NULL);
+        failed = failed || clients[i].failed;
+        n_sentences += clients[i].n_sentences;
+        n_valid += clients[i].n_valid;
+    }
+
+    double seconds = now_seconds() - start;
+    if (failed)
+    {
+        fputs("ERROR: server did not answer every request as expected\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    qsort(latencies, options.n_requests, sizeof(double), compare_doubles);
+    printf("connections %zu, depth %zu, batch %zu, %zu requests, %zu sentences (%.1f%% valid)\n",
+           options.n_connections, options.depth, options.batch, options.n_requests, n_sentences,
+           100.0 * n_valid / n_sentences);
+    printf("%14s %14s %12s %12s %12s\n", "requests/s", "sentences/s", "p50 us", "p99 us", "max us");
+    printf("%14.0f %14.0f %12.1f %12.1f %12.1f\n", options.n_requests / seconds, n_sentences / seconds,
+           latencies[options.n_requests / 2] * 1e6, latencies[options.n_requests * 99 / 100] * 1e6,
+           latencies[options.n_requests - 1] * 1e6);
+
+    free(latencies);
+    clear_list(&requests.frames);
+    clear_list(&requests.frame_offsets);
+    clear_list(&requests.expected);
+    return EXIT_SUCCESS;
+}
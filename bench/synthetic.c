@@ -0,0 +1,282 @@
+#include "synthetic.h"
+#include <string.h>
+
+#define NEAR_MISS_ATTEMPTS 16
+
+static void init_row_rules(sentence_generator *generator);
+static void init_rule_heights(sentence_generator *generator);
+static int choose_rule(sentence_generator *generator, int nonterminal, bool shrink);
+
+void init_grammar_params(grammar_params *params)
+{
+    params->n_nonterminals = 100;
+    params->n_terminals = 32;
+    params->n_alternatives = 3;
+    params->max_rhs_length = 4;
+    params->nullable_percent = 20;
+    params->recursion_depth = 4;
+    params->seed = 1;
+}
+
+void write_synthetic_grammar(const grammar_params *params, FILE *out)
+{
+    uint64_t seed = params->seed;
+    size_t n_alternatives = params->n_alternatives > 0 ? params->n_alternatives : 1;
+
+    // Leading terminals only ever start an alternative, plain terminals fill
+    // the rest, so no follow set can clash with a first set
+    size_t n_leading = params->n_terminals / 2 > n_alternatives ? params->n_terminals / 2 : n_alternatives;
+    size_t n_plain = params->n_terminals > n_leading ? params->n_terminals - n_leading : 1;
+
+    for (size_t i = 0; i < params->n_nonterminals; i++)
+    {
+        size_t first_leading = next_random(&seed) % n_leading;
+        size_t lowest = params->recursion_depth == 0 ? i + 1
+                        : i > params->recursion_depth ? i - params->recursion_depth
+                                                      : 0;
+
+        for (size_t k = 0; k < n_alternatives; k++)
+        {
+            fprintf(out, "N%zu ::= l%zu", i, (first_leading + k) % n_leading);
+
+            size_t length = next_random(&seed) % (params->max_rhs_length + 1);
+            for (size_t item = 0; item < length; item++)
+            {
+                // The first alternative only has terminals, so every
+                // nonterminal derives a finite sentence
+                if (k > 0 && lowest < params->n_nonterminals && next_random(&seed) % 2 == 0)
+                    fprintf(out, " N%zu", lowest + next_random(&seed) % (params->n_nonterminals - lowest));
+
+                fprintf(out, " p%zu", (size_t)(next_random(&seed) % n_plain));
+            }
+
+            putc('\n', out);
+        }
+
+        if ((int)(next_random(&seed) % 100) < params->nullable_percent)
+            fprintf(out, "N%zu ::= \"\n", i);
+    }
+}
+
+void init_sentence_generator(sentence_generator *generator, const parser *parser, uint64_t seed)
+{
+    generator->parser = parser;
+    generator->seed = seed;
+    init_list(&generator->stack, 64, sizeof(int));
+
+    size_t n_symbols = parser->grammar->symbols.count;
+    generator->terminals = malloc(n_symbols * sizeof(int));
+    generator->n_terminals = 0;
+    for (size_t i = 0; i < n_symbols; i++)
+    {
+        if (parser->terminal_symbols[i] && (int)i != parser->end_symbol && (int)i != parser->empty_symbol)
+            generator->terminals[generator->n_terminals++] = i;
+    }
+
+    init_row_rules(generator);
+    init_rule_heights(generator);
+}
+
+void init_row_rules(sentence_generator *generator)
+{
+    const parser *parser = generator->parser;
+    size_t n_symbols = parser->grammar->symbols.count;
+    size_t n_rules = parser->grammar->rules.count;
+
+    // Rules are collected from the table rather than the grammar, so the
+    // walk only takes expansions the driver can select
+    int *seen = malloc(n_rules * sizeof(int));
+    for (size_t i = 0; i < n_rules; i++)
+        seen[i] = -1;
+
+    list rules;
+    init_list(&rules, n_rules, sizeof(int));
+    generator->rule_offsets = malloc((n_symbols + 1) * sizeof(int));
+    for (size_t symbol = 0; symbol < n_symbols; symbol++)
+    {
+        generator->rule_offsets[symbol] = rules.count;
+        if (parser->terminal_symbols[symbol])
+            continue;
+
+        const int *row = parser->table + parser->symbol_ordinals[symbol] * parser->n_terminals;
+        for (size_t terminal = 0; terminal < parser->n_terminals; terminal++)
+        {
+            if (row[terminal] < 0 || seen[row[terminal]] == (int)symbol)
+                continue;
+
+            seen[row[terminal]] = symbol;
+            *(int *)push_back(&rules) = row[terminal];
+        }
+    }
+
+    generator->rule_offsets[n_symbols] = rules.count;
+    generator->row_rules = rules.head;
+    free(seen);
+}
+
+void init_rule_heights(sentence_generator *generator)
+{
+    const parser *parser = generator->parser;
+    const grammar *grammar = parser->grammar;
+    int *symbol_heights = malloc(grammar->symbols.count * sizeof(int));
+    int *rule_heights = malloc(grammar->rules.count * sizeof(int));
+
+    for (size_t i = 0; i < grammar->symbols.count; i++)
+        symbol_heights[i] = parser->terminal_symbols[i] ? 0 : -1;
+    for (size_t i = 0; i < grammar->rules.count; i++)
+        rule_heights[i] = -1;
+
+    // Lowest derivation height of every rule, iterated until stable
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t i = 0; i < grammar->rules.count; i++)
+        {
+            const rule *rule = get_list_element(&grammar->rules, i);
+            int height = 0;
+            for (int k = parser->rhs_offsets[rule->id]; k < parser->rhs_offsets[rule->id + 1] && height >= 0; k++)
+            {
+                int symbol_height = symbol_heights[parser->rhs_symbols[k]];
+                if (symbol_height < 0)
+                    height = -1;
+                else if (symbol_height + 1 > height)
+                    height = symbol_height + 1;
+            }
+
+            if (height < 0 || (rule_heights[rule->id] >= 0 && rule_heights[rule->id] <= height))
+                continue;
+
+            rule_heights[rule->id] = height;
+            int *lhs_height = symbol_heights + rule->lhs->id;
+            if (*lhs_height < 0 || *lhs_height > height)
+                *lhs_height = height;
+            changed = true;
+        }
+    }
+
+    free(symbol_heights);
+    generator->rule_heights = rule_heights;
+}
+
+int choose_rule(sentence_generator *generator, int nonterminal, bool shrink)
+{
+    int lowest = -1;
+    int highest = -1;
+    for (int i = generator->rule_offsets[nonterminal]; i < generator->rule_offsets[nonterminal + 1]; i++)
+    {
+        int height = generator->rule_heights[generator->row_rules[i]];
+        if (height >= 0 && (lowest < 0 || height < lowest))
+            lowest = height;
+        if (height > highest)
+            highest = height;
+    }
+
+    // Growing skips the rules that end the derivation soonest, unless they
+    // are all there is
+    int chosen = -1;
+    int n_candidates = 0;
+    for (int i = generator->rule_offsets[nonterminal]; i < generator->rule_offsets[nonterminal + 1]; i++)
+    {
+        int rule = generator->row_rules[i];
+        int height = generator->rule_heights[rule];
+        if (height < 0)
+            continue;
+
+        if (shrink)
+        {
+            if (height == lowest)
+                return rule;
+        }
+        else if ((height > lowest || highest == lowest) && next_random(&generator->seed) % ++n_candidates == 0)
+            chosen = rule;
+    }
+
+    return chosen;
+}
+
+bool generate_sentence(sentence_generator *generator, size_t length, list *tokens)
+{
+    const parser *parser = generator->parser;
+    list *stack = &generator->stack;
+    size_t first_token = tokens->count;
+
+    stack->count = 0;
+    *(int *)push_back(stack) = parser->start_symbol;
+    while (stack->count > 0)
+    {
+        int top = *(int *)peek_back(stack);
+        pop_back(stack);
+
+        if (parser->terminal_symbols[top])
+        {
+            if (top != parser->end_symbol)
+                *(int *)push_back(tokens) = top;
+            continue;
+        }
+
+        // Expand at random until the sentence is long enough, then take the
+        // expansions that finish soonest
+        bool shrink = tokens->count - first_token + stack->count >= length;
+        int rule = choose_rule(generator, top, shrink);
+        if (rule < 0)
+        {
+            tokens->count = first_token;
+            return false;
+        }
+
+        int rhs_begin = parser->rhs_offsets[rule];
+        push_back_many(stack, parser->rhs_symbols + rhs_begin, parser->rhs_offsets[rule + 1] - rhs_begin);
+    }
+
+    return true;
+}
+
+bool make_near_miss(sentence_generator *generator, int *tokens, size_t n_tokens)
+{
+    if (n_tokens == 0 || generator->n_terminals == 0)
+        return false;
+
+    // Replace a single token so that the sentence stops being valid
+    for (int attempt = 0; attempt < NEAR_MISS_ATTEMPTS; attempt++)
+    {
+        size_t position = next_random(&generator->seed) % n_tokens;
+        int original = tokens[position];
+        tokens[position] = generator->terminals[next_random(&generator->seed) % generator->n_terminals];
+        if (tokens[position] != original && !is_valid_tokens(generator->parser, tokens, n_tokens))
+            return true;
+
+        tokens[position] = original;
+    }
+
+    return false;
+}
+
+void write_sentence(const parser *parser, const int *tokens, size_t n_tokens, list *text)
+{
+    for (size_t i = 0; i < n_tokens; i++)
+    {
+        const symbol *symbol = get_list_element(&parser->grammar->symbols, tokens[i]);
+        if (i > 0)
+            *(char *)push_back(text) = ' ';
+        push_back_many(text, symbol_name(parser->grammar, symbol), symbol->name_length);
+    }
+}
+
+void clear_sentence_generator(sentence_generator *generator)
+{
+    clear_list(&generator->stack);
+    free(generator->terminals);
+    free(generator->rule_offsets);
+    free(generator->row_rules);
+    free(generator->rule_heights);
+}
+
+uint64_t next_random(uint64_t *seed)
+{
+    // splitmix64
+    uint64_t z = (*seed += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
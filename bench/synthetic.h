@@ -0,0 +1,53 @@
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "../parser.h"
+
+// Shape of a generated grammar. Every alternative starts with its own
+// leading terminal and every nonterminal on a right hand side is followed
+// by a plain terminal, so the grammar is LL(1) for any parameters.
+typedef struct
+{
+    size_t n_nonterminals;
+    size_t n_terminals;
+    size_t n_alternatives;
+    size_t max_rhs_length;
+    // Percentage of nonterminals that also derive the empty string
+    int nullable_percent;
+    // How far back a rule may refer to earlier nonterminals, 0 makes the
+    // grammar free of recursion
+    size_t recursion_depth;
+    uint64_t seed;
+} grammar_params;
+
+typedef struct
+{
+    const parser *parser;
+    uint64_t seed;
+
+    // Rules reachable from each nonterminal's table row, indexed by symbol id
+    int *rule_offsets;
+    int *row_rules;
+    // Lowest derivation height of each rule
+    int *rule_heights;
+    int *terminals;
+    size_t n_terminals;
+    list stack;
+} sentence_generator;
+
+void init_grammar_params(grammar_params *params);
+void write_synthetic_grammar(const grammar_params *params, FILE *out);
+
+void init_sentence_generator(sentence_generator *generator, const parser *parser, uint64_t seed);
+// Appends a sentence of about length tokens. Returns false and leaves the
+// tokens as they were if it reaches a nonterminal with no finite derivation.
+bool generate_sentence(sentence_generator *generator, size_t length, list *tokens);
+bool make_near_miss(sentence_generator *generator, int *tokens, size_t n_tokens);
+void write_sentence(const parser *parser, const int *tokens, size_t n_tokens, list *text);
+void clear_sentence_generator(sentence_generator *generator);
+
+uint64_t next_random(uint64_t *seed);
+
+#endif
@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "synthetic.h"
+#include "../earley.h"
+#include "../transform.h"
+
+#define MAX_SENTENCE_LENGTH 6
+#define N_NAMES 4
+
+// Grammars that broke the transform once, one rule per line
+static const char *regression_grammars[] = {
+    // An empty alternative was grouped with the reduce item of rule 0
+    "P ::= B\nB ::= P P\nB ::= P A\nP ::= b A a\nB ::= B b b\n",
+};
+
+typedef struct
+{
+    size_t n_grammars;
+    uint64_t seed;
+} bench_options;
+
+typedef struct
+{
+    size_t n_checked;
+    size_t n_ll1_before;
+    size_t n_ll1_after;
+    size_t n_sentences;
+    size_t n_trees;
+} bench_result;
+
+static bool parse_bench_options(bench_options *options, int argc, char *argv[]);
+static double elapsed_seconds(const struct timespec *start);
+static void write_random_grammar(uint64_t *seed, FILE *out);
+static bool check_grammar(const char *text, size_t length, bench_result *result);
+static bool check_sentences(const parser *original, const parser *transformed, const grammar_transform *transform,
+                            bench_result *result);
+static size_t check_derivation(const grammar *grammar, const parse_node *nodes, size_t n_nodes, size_t index,
+                               const int *tokens, size_t n_tokens, size_t *next_token);
+
+bool parse_bench_options(bench_options *options, int argc, char *argv[])
+{
+    options->n_grammars = 2000;
+    options->seed = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+            return false;
+
+        if (strcmp(argv[i], "--grammars") == 0)
+            options->n_grammars = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--seed") == 0)
+            options->seed = atol(argv[i + 1]);
+        else
+            return false;
+
+        i++;
+    }
+
+    return true;
+}
+
+double elapsed_seconds(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// A few nonterminals with short, often left recursive or common prefixed
+// alternatives, some of them empty. Nonterminals that get no rule are read
+// as terminals.
+void write_random_grammar(uint64_t *seed, FILE *out)
+{
+    static const char *nonterminals[N_NAMES] = {"A", "B", "C", "D"};
+    static const char *terminals[N_NAMES] = {"a", "b", "c", "d"};
+
+    size_t n_nonterminals = 1 + next_random(seed) % N_NAMES;
+    for (size_t i = 0; i < n_nonterminals; i++)
+    {
+        size_t n_alternatives = 1 + next_random(seed) % 3;
+        for (size_t j = 0; j < n_alternatives; j++)
+        {
+            fprintf(out, "%s ::=", nonterminals[i]);
+            size_t length = next_random(seed) % 4;
+            if (length == 0)
+                fputs(" \"", out);
+
+            for (size_t k = 0; k < length; k++)
+            {
+                if (next_random(seed) % 2)
+                    fprintf(out, " %s", nonterminals[next_random(seed) % n_nonterminals]);
+                else
+                    fprintf(out, " %s", terminals[next_random(seed) % 2]);
+            }
+            fputc('\n', out);
+        }
+    }
+}
+
+// The transformed grammar must accept the same sentences, and where it is
+// LL(1) its trees must map to derivations of the original grammar
+bool check_grammar(const char *text, size_t length, bench_result *result)
+{
+    grammar grammar;
+    init_grammar(&grammar, 16);
+    if (!create_grammar_from_buffer(&grammar, text, length))
+    {
+        clear_grammar(&grammar);
+        return true;
+    }
+
+    grammar_transform transform;
+    init_grammar_transform(&transform, &grammar);
+
+    parser original;
+    parser transformed;
+    init_parser(&original, &grammar);
+    init_parser(&transformed, &transform.grammar);
+    build_parse_table(&original);
+    build_parse_table(&transformed);
+
+    result->n_checked++;
+    result->n_ll1_before += is_valid_grammar(&original);
+    result->n_ll1_after += is_valid_grammar(&transformed);
+    bool matches = check_sentences(&original, &transformed, &transform, result);
+
+    clear_parser(&transformed);
+    clear_parser(&original);
+    clear_grammar_transform(&transform);
+    clear_grammar(&grammar);
+    return matches;
+}
+
+// Tries every sentence over the original terminals up to a short length
+bool check_sentences(const parser *original, const parser *transformed, const grammar_transform *transform,
+                     bench_result *result)
+{
+    const grammar *grammar = original->grammar;
+    list terminals;
+    init_list(&terminals, 8, sizeof(int));
+    for (size_t i = 0; i < grammar->symbols.count; i++)
+    {
+        const symbol *terminal = get_list_element(&grammar->symbols, i);
+        if (original->terminal_symbols[i] && !is_empty_symbol(grammar, terminal) && !is_end_symbol(grammar, terminal))
+            *(int *)push_back(&terminals) = i;
+    }
+
+    earley_recognizer original_recognizer;
+    earley_recognizer transformed_recognizer;
+    init_earley_recognizer(&original_recognizer, original);
+    init_earley_recognizer(&transformed_recognizer, transformed);
+
+    bool ll1 = is_valid_grammar(transformed);
+    list stack;
+    init_list(&stack, 16, sizeof(int));
+    arena arena;
+    init_arena(&arena, 4096);
+    parse_tree tree;
+    parse_tree original_tree;
+    init_parse_tree(&tree, &arena);
+    init_parse_tree(&original_tree, &arena);
+
+    bool matches = true;
+    int tokens[MAX_SENTENCE_LENGTH];
+    size_t digits[MAX_SENTENCE_LENGTH];
+    for (size_t length = 0; matches && length <= MAX_SENTENCE_LENGTH; length++)
+    {
+        if (length > 0 && terminals.count == 0)
+            break;
+
+        memset(digits, 0, sizeof(digits));
+        while (matches)
+        {
+            for (size_t i = 0; i < length; i++)
+                tokens[i] = *(int *)get_list_element(&terminals, digits[i]);
+
+            result->n_sentences++;
+            bool accepted = earley_recognize(&original_recognizer, tokens, length);
+            matches = earley_recognize(&transformed_recognizer, tokens, length) == accepted;
+            if (matches && ll1)
+            {
+                reset_arena(&arena);
+                matches = build_parse_tree(transformed, &stack, tokens, length, &tree) == accepted;
+                if (matches && accepted)
+                {
+                    map_parse_tree(transform, &tree, &original_tree);
+                    size_t next_token = 0;
+                    size_t n_nodes = original_tree.n_nodes;
+                    matches = check_derivation(grammar, get_tree_nodes(&original_tree), n_nodes, 0, tokens, length,
+                                               &next_token) == n_nodes && next_token == length;
+                    result->n_trees++;
+                }
+            }
+
+            size_t i = 0;
+            while (i < length && ++digits[i] == terminals.count)
+                digits[i++] = 0;
+            if (i == length)
+                break;
+        }
+    }
+
+    clear_arena(&arena);
+    clear_list(&stack);
+    clear_earley_recognizer(&transformed_recognizer);
+    clear_earley_recognizer(&original_recognizer);
+    clear_list(&terminals);
+    return matches;
+}
+
+// Checks the subtree at index against the rules of the grammar and returns
+// the index past it, or SIZE_MAX if it is no derivation of the tokens
+size_t check_derivation(const grammar *grammar, const parse_node *nodes, size_t n_nodes, size_t index,
+                        const int *tokens, size_t n_tokens, size_t *next_token)
+{
+    if (index >= n_nodes)
+        return SIZE_MAX;
+
+    const parse_node *node = nodes + index;
+    if (node->rule == NO_RULE)
+    {
+        if (is_end_symbol(grammar, get_list_element(&grammar->symbols, node->symbol)))
+            return *next_token == n_tokens && node->n_children == 0 ? index + 1 : SIZE_MAX;
+
+        if (*next_token >= n_tokens || tokens[*next_token] != node->symbol || node->first_token != *next_token)
+            return SIZE_MAX;
+
+        (*next_token)++;
+        return index + 1;
+    }
+
+    if (node->rule < 0 || (size_t)node->rule >= grammar->rules.count)
+        return SIZE_MAX;
+
+    const rule *node_rule = get_list_element(&grammar->rules, node->rule);
+    if (node_rule->lhs->id != node->symbol)
+        return SIZE_MAX;
+
+    size_t child = index + 1;
+    uint32_t n_children = 0;
+    for (size_t i = 0; i < node_rule->rhs.count; i++)
+    {
+        const symbol *rhs_symbol = *(symbol **)get_list_element(&node_rule->rhs, i);
+        if (is_empty_symbol(grammar, rhs_symbol))
+            continue;
+
+        if (child >= n_nodes || nodes[child].symbol != rhs_symbol->id)
+            return SIZE_MAX;
+
+        child = check_derivation(grammar, nodes, n_nodes, child, tokens, n_tokens, next_token);
+        if (child == SIZE_MAX)
+            return SIZE_MAX;
+        n_children++;
+    }
+
+    return n_children == node->n_children ? child : SIZE_MAX;
+}
+
+// Transforms the regression grammars and many small random ones, and checks
+// that every sentence up to a short length is accepted by the transformed
+// grammar exactly when the original accepts it
+int main(int argc, char *argv[])
+{
+    bench_options options;
+    if (!parse_bench_options(&options, argc, argv))
+    {
+        fputs("Usage: transform_bench [--grammars N] [--seed N]\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    bench_result result = {0};
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < sizeof(regression_grammars) / sizeof(regression_grammars[0]); i++)
+    {
+        if (!check_grammar(regression_grammars[i], strlen(regression_grammars[i]), &result))
+        {
+            fprintf(stderr, "ERROR: transform of regression grammar %zu does not match:\n%s", i,
+                    regression_grammars[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    uint64_t seed = options.seed;
+    for (size_t i = 0; i < options.n_grammars; i++)
+    {
+        char *text;
+        size_t length;
+        FILE *file = open_memstream(&text, &length);
+        write_random_grammar(&seed, file);
+        fclose(file);
+
+        bool matches = check_grammar(text, length, &result);
+        if (!matches)
+            fprintf(stderr, "ERROR: transformed grammar does not match the original:\n%s", text);
+        free(text);
+        if (!matches)
+            return EXIT_FAILURE;
+    }
+
+    printf("Grammars checked: %zu\n", result.n_checked);
+    printf("LL(1) before transform: %zu\n", result.n_ll1_before);
+    printf("LL(1) after transform: %zu\n", result.n_ll1_after);
+    printf("Sentences compared: %zu\n", result.n_sentences);
+    printf("Trees mapped: %zu\n", result.n_trees);
+    printf("Time: %.2f s\n", elapsed_seconds(&start));
+    return EXIT_SUCCESS;
+}
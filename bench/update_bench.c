@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "synthetic.h"
+#include "../lookahead.h"
+#include "../update.h"
+
+#define N_CHECKED_UPDATES 200
+#define MAX_NEW_RHS 4
+#define MAX_RHS 16
+
+typedef struct
+{
+    size_t size;
+    size_t n_updates;
+    int rebuild_rounds;
+    grammar_params params;
+} bench_options;
+
+static bool parse_bench_options(bench_options *options, int argc, char *argv[]);
+static size_t random_new_rule(const grammar *grammar, uint64_t *seed, const char **lhs, const char **rhs);
+static bool same_as_full_build(const parser *updated, grammar *grammar);
+static bool same_lists(const list *a, const list *b);
+static bool same_conflicts(const list *a, const list *b);
+static int compare_conflicts(const void *a, const void *b);
+static bool check_lookahead_updates(void);
+static double elapsed_seconds(const struct timespec *start);
+
+bool parse_bench_options(bench_options *options, int argc, char *argv[])
+{
+    options->size = 300;
+    options->n_updates = 20000;
+    options->rebuild_rounds = 20;
+    init_grammar_params(&options->params);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+            return false;
+
+        if (strcmp(argv[i], "--size") == 0)
+            options->size = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--updates") == 0)
+            options->n_updates = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--nullable") == 0)
+            options->params.nullable_percent = atoi(argv[i + 1]);
+        else
+            return false;
+
+        i++;
+    }
+
+    return options->size > 0;
+}
+
+double elapsed_seconds(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Picks a rule over symbols the grammar already has, so the update never
+// needs a full rebuild
+size_t random_new_rule(const grammar *grammar, uint64_t *seed, const char **lhs, const char **rhs)
+{
+    size_t n_symbols = grammar->symbols.count;
+    const symbol *lhs_symbol;
+    do
+        lhs_symbol = get_list_element(&grammar->symbols, next_random(seed) % n_symbols);
+    while (lhs_symbol->type != NONTERMINAL);
+    *lhs = symbol_name(grammar, lhs_symbol);
+
+    size_t n_rhs = 1 + next_random(seed) % MAX_NEW_RHS;
+    for (size_t i = 0; i < n_rhs; i++)
+    {
+        const symbol *rhs_symbol;
+        do
+            rhs_symbol = get_list_element(&grammar->symbols, next_random(seed) % n_symbols);
+        while (is_reserved_symbol(symbol_name(grammar, rhs_symbol), rhs_symbol->name_length) &&
+               !is_empty_symbol(grammar, rhs_symbol));
+        rhs[i] = symbol_name(grammar, rhs_symbol);
+    }
+
+    return n_rhs;
+}
+
+bool same_as_full_build(const parser *updated, grammar *grammar)
+{
+    parser full;
+    init_parser(&full, grammar);
+    full.max_lookahead = updated->max_lookahead;
+    build_parse_table(&full);
+
+    size_t n_symbols = grammar->symbols.count;
+    size_t n_rules = grammar->rules.count;
+    size_t set_bytes = full.set_words * sizeof(uint64_t);
+    bool same = same_conflicts(&full.conflicts, &updated->conflicts) &&
+                memcmp(full.table, updated->table, full.n_nonterminals * full.n_terminals * sizeof(int)) == 0 &&
+                memcmp(full.nullable_symbols, updated->nullable_symbols, bitset_words(n_symbols) * sizeof(uint64_t)) == 0 &&
+                memcmp(full.symbol_first_sets, updated->symbol_first_sets, n_symbols * set_bytes) == 0 &&
+                memcmp(full.symbol_follow_sets, updated->symbol_follow_sets, n_symbols * set_bytes) == 0 &&
+                memcmp(full.rule_first_sets, updated->rule_first_sets, n_rules * set_bytes) == 0 &&
+                memcmp(full.rhs_offsets, updated->rhs_offsets, (n_rules + 1) * sizeof(int)) == 0 &&
+                memcmp(full.rhs_symbols, updated->rhs_symbols, full.rhs_offsets[n_rules] * sizeof(int)) == 0 &&
+                full.lookahead_depth == updated->lookahead_depth &&
+                same_lists(&full.lookahead_nodes, &updated->lookahead_nodes) &&
+                same_lists(&full.lookahead_edges, &updated->lookahead_edges);
+
+    for (size_t i = 0; i < n_rules && same; i++)
+        same = bitset_test(full.nullable_rules, i) == bitset_test(updated->nullable_rules, i);
+
+    clear_parser(&full);
+    return same;
+}
+
+bool same_lists(const list *a, const list *b)
+{
+    return a->count == b->count && (a->count == 0 || memcmp(a->head, b->head, a->count * a->elem_byte_size) == 0);
+}
+
+// Rows are rebuilt in update order, so the conflicts are compared sorted
+bool same_conflicts(const list *a, const list *b)
+{
+    if (a->count != b->count)
+        return false;
+
+    size_t bytes = a->count * sizeof(table_conflict);
+    table_conflict *sorted_a = malloc(bytes + 1);
+    table_conflict *sorted_b = malloc(bytes + 1);
+    if (bytes > 0)
+    {
+        memcpy(sorted_a, a->head, bytes);
+        memcpy(sorted_b, b->head, bytes);
+    }
+
+    qsort(sorted_a, a->count, sizeof(table_conflict), compare_conflicts);
+    qsort(sorted_b, b->count, sizeof(table_conflict), compare_conflicts);
+    bool same = memcmp(sorted_a, sorted_b, bytes) == 0;
+    free(sorted_a);
+    free(sorted_b);
+    return same;
+}
+
+int compare_conflicts(const void *a, const void *b)
+{
+    const table_conflict *x = a, *y = b;
+    if (x->nonterminal != y->nonterminal)
+        return x->nonterminal - y->nonterminal;
+    if (x->terminal != y->terminal)
+        return x->terminal - y->terminal;
+
+    return x->rule - y->rule;
+}
+
+// Statements that need three tokens of lookahead gain and lose forms, the
+// updated parser has to keep its lookahead tries like a full build
+bool check_lookahead_updates(void)
+{
+    const char *text = "L ::= T L\nL ::= \"\nT ::= p p x0\nT ::= p p x1\n";
+    grammar grammar;
+    init_grammar(&grammar, 16);
+    create_grammar_from_buffer(&grammar, text, strlen(text));
+    parser parser;
+    init_parser(&parser, &grammar);
+    parser.max_lookahead = 3;
+    build_parse_table(&parser);
+
+    grammar_editor editor;
+    init_grammar_editor(&editor, &grammar, &parser);
+    const char *form[] = {"p", "p", "x2"};
+    const char *short_form[] = {"p", "x0"};
+    int rule_id = add_grammar_rule(&editor, "T", form, 3);
+    bool same = rule_id >= 0 && same_as_full_build(&parser, &grammar) && is_valid_string(&parser, "p p x2 p p x0");
+    same = same && add_grammar_rule(&editor, "T", short_form, 2) >= 0 && same_as_full_build(&parser, &grammar) &&
+           is_valid_string(&parser, "p x0 p p x2");
+    same = same && remove_grammar_rule(&editor, rule_id) && same_as_full_build(&parser, &grammar) &&
+           parser.max_lookahead == 3 && !is_valid_string(&parser, "p p x2");
+
+    clear_grammar_editor(&editor);
+    clear_parser(&parser);
+    clear_grammar(&grammar);
+    return same;
+}
+
+// Adds random rules to a synthetic grammar and removes them again, and
+// compares the time each update takes with rebuilding the parser
+int main(int argc, char *argv[])
+{
+    bench_options options;
+    if (!parse_bench_options(&options, argc, argv))
+    {
+        fputs("Usage: update_bench [--size N] [--updates N] [--nullable PERCENT]\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    if (!check_lookahead_updates())
+    {
+        fputs("ERROR: update of an LL(k) parser differs from a full build\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    grammar_params params = options.params;
+    params.n_nonterminals = options.size;
+    params.n_terminals = options.size / 2 + 16;
+
+    char *grammar_text;
+    size_t grammar_size;
+    FILE *grammar_file = open_memstream(&grammar_text, &grammar_size);
+    write_synthetic_grammar(&params, grammar_file);
+    fclose(grammar_file);
+
+    grammar grammar;
+    init_grammar(&grammar, 16);
+    bool loaded = create_grammar_from_buffer(&grammar, grammar_text, grammar_size);
+    free(grammar_text);
+    if (!loaded)
+    {
+        fputs("Error reading input\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    struct timespec start;
+    parser parser;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int round = 0; round < options.rebuild_rounds; round++)
+    {
+        if (round > 0)
+            clear_parser(&parser);
+        init_parser(&parser, &grammar);
+        build_parse_table(&parser);
+    }
+    double rebuild_seconds = elapsed_seconds(&start) / options.rebuild_rounds;
+
+    grammar_editor editor;
+    init_grammar_editor(&editor, &grammar, &parser);
+    uint64_t seed = params.seed;
+    const char *lhs;
+    const char *rhs[MAX_RHS];
+
+    // The first updates are checked against a full build before any are
+    // timed. Removing a rule from the middle moves the last rule into its
+    // place, so a random rule is also removed and added back.
+    for (size_t i = 0; i < N_CHECKED_UPDATES && i < options.n_updates; i++)
+    {
+        size_t n_rhs = random_new_rule(&grammar, &seed, &lhs, rhs);
+        int rule_id = add_grammar_rule(&editor, lhs, rhs, n_rhs);
+        bool same = same_as_full_build(&parser, &grammar);
+        same = same && remove_grammar_rule(&editor, rule_id) && same_as_full_build(&parser, &grammar);
+
+        const rule *removed;
+        do
+            removed = get_list_element(&grammar.rules, next_random(&seed) % grammar.rules.count);
+        while (removed->lhs->id == parser.start_symbol || removed->rhs.count > MAX_RHS);
+
+        // Names stay in the grammar when their rules go away
+        lhs = symbol_name(&grammar, removed->lhs);
+        n_rhs = removed->rhs.count;
+        for (size_t k = 0; k < n_rhs; k++)
+            rhs[k] = symbol_name(&grammar, *(symbol **)get_list_element(&removed->rhs, k));
+        same = same && remove_grammar_rule(&editor, removed->id) && same_as_full_build(&parser, &grammar);
+        same = same && add_grammar_rule(&editor, lhs, rhs, n_rhs) >= 0 && same_as_full_build(&parser, &grammar);
+        if (!same)
+        {
+            fprintf(stderr, "ERROR: update %zu differs from a full build\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+
+    size_t n_rows_rebuilt = editor.n_rows_rebuilt;
+    size_t n_conflicting = 0;
+    double add_seconds = 0;
+    double remove_seconds = 0;
+    for (size_t i = 0; i < options.n_updates; i++)
+    {
+        size_t n_rhs = random_new_rule(&grammar, &seed, &lhs, rhs);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int rule_id = add_grammar_rule(&editor, lhs, rhs, n_rhs);
+        add_seconds += elapsed_seconds(&start);
+        n_conflicting += !is_valid_grammar(&parser);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        remove_grammar_rule(&editor, rule_id);
+        remove_seconds += elapsed_seconds(&start);
+    }
+
+    n_rows_rebuilt = editor.n_rows_rebuilt - n_rows_rebuilt;
+    printf("%zu rules, %zu symbols, %s\n", grammar.rules.count, grammar.symbols.count,
+           is_valid_grammar(&parser) ? "LL(1)" : "not LL(1)");
+    printf("full rebuild      %10.3f ms\n", rebuild_seconds * 1e3);
+    printf("add rule          %10.3f us\n", add_seconds / options.n_updates * 1e6);
+    printf("remove rule       %10.3f us\n", remove_seconds / options.n_updates * 1e6);
+    printf("rows per update   %10.1f\n", n_rows_rebuilt / (options.n_updates * 2.0));
+    printf("conflicting adds  %10zu\n", n_conflicting);
+
+    clear_grammar_editor(&editor);
+    clear_parser(&parser);
+    clear_grammar(&grammar);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,114 @@
+#include "bitset.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BITSET_X86
+#endif
+
+static bool union_scalar(uint64_t *dst, const uint64_t *src, size_t n_words);
+static bool union_resolve(uint64_t *dst, const uint64_t *src, size_t n_words);
+
+#ifdef BITSET_X86
+static bool union_sse2(uint64_t *dst, const uint64_t *src, size_t n_words);
+static bool union_avx2(uint64_t *dst, const uint64_t *src, size_t n_words);
+#endif
+
+// Picked on first call, every thread resolves to the same implementation
+static bool (*union_impl)(uint64_t *, const uint64_t *, size_t) = union_resolve;
+
+size_t bitset_words(size_t n_bits)
+{
+    return (n_bits + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+}
+
+uint64_t *create_bitset_arr(size_t n_sets, size_t n_words)
+{
+    uint64_t *arr = malloc(n_sets * n_words * sizeof(uint64_t));
+    memset((void *)arr, 0, n_sets * n_words * sizeof(uint64_t));
+    return arr;
+}
+
+bool bitset_union(uint64_t *dst, const uint64_t *src, size_t n_words)
+{
+    return union_impl(dst, src, n_words);
+}
+
+size_t bitset_next(const uint64_t *set, size_t n_words, size_t from)
+{
+    size_t word_index = from / BITSET_WORD_BITS;
+    if (word_index >= n_words)
+        return n_words * BITSET_WORD_BITS;
+
+    uint64_t word = set[word_index] & (~(uint64_t)0 << (from % BITSET_WORD_BITS));
+    while (!word)
+    {
+        if (++word_index == n_words)
+            return n_words * BITSET_WORD_BITS;
+
+        word = set[word_index];
+    }
+
+    return word_index * BITSET_WORD_BITS + __builtin_ctzll(word);
+}
+
+bool union_resolve(uint64_t *dst, const uint64_t *src, size_t n_words)
+{
+    union_impl = union_scalar;
+
+#ifdef BITSET_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        union_impl = union_avx2;
+    else if (__builtin_cpu_supports("sse2"))
+        union_impl = union_sse2;
+#endif
+
+    return union_impl(dst, src, n_words);
+}
+
+bool union_scalar(uint64_t *dst, const uint64_t *src, size_t n_words)
+{
+    uint64_t added = 0;
+    for (size_t i = 0; i < n_words; i++)
+    {
+        added |= src[i] & ~dst[i];
+        dst[i] |= src[i];
+    }
+
+    return added != 0;
+}
+
+#ifdef BITSET_X86
+__attribute__((target("sse2"))) bool union_sse2(uint64_t *dst, const uint64_t *src, size_t n_words)
+{
+    __m128i added = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 2 <= n_words; i += 2)
+    {
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        added = _mm_or_si128(added, _mm_andnot_si128(d, s));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(d, s));
+    }
+
+    bool changed = _mm_movemask_epi8(_mm_cmpeq_epi8(added, _mm_setzero_si128())) != 0xFFFF;
+    return union_scalar(dst + i, src + i, n_words - i) || changed;
+}
+
+__attribute__((target("avx2"))) bool union_avx2(uint64_t *dst, const uint64_t *src, size_t n_words)
+{
+    __m256i added = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= n_words; i += 4)
+    {
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+        added = _mm256_or_si256(added, _mm256_andnot_si256(d, s));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(d, s));
+    }
+
+    bool changed = !_mm256_testz_si256(added, added);
+    return union_scalar(dst + i, src + i, n_words - i) || changed;
+}
+#endif
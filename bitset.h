@@ -0,0 +1,36 @@
+#ifndef BITSET_H
+#define BITSET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Bitsets are plain arrays of 64 bit words. Arrays of sets are stored with
+// n_words words per set.
+#define BITSET_WORD_BITS 64
+
+size_t bitset_words(size_t n_bits);
+uint64_t *create_bitset_arr(size_t n_sets, size_t n_words);
+
+// Sets dst to dst | src, returns whether any bit was added to dst
+bool bitset_union(uint64_t *dst, const uint64_t *src, size_t n_words);
+
+// Returns the index of the first set bit at or after from, or n_words * 64
+size_t bitset_next(const uint64_t *set, size_t n_words, size_t from);
+
+static inline bool bitset_test(const uint64_t *set, size_t bit)
+{
+    return (set[bit / BITSET_WORD_BITS] >> (bit % BITSET_WORD_BITS)) & 1;
+}
+
+static inline void bitset_set(uint64_t *set, size_t bit)
+{
+    set[bit / BITSET_WORD_BITS] |= (uint64_t)1 << (bit % BITSET_WORD_BITS);
+}
+
+static inline void bitset_clear(uint64_t *set, size_t bit)
+{
+    set[bit / BITSET_WORD_BITS] &= ~((uint64_t)1 << (bit % BITSET_WORD_BITS));
+}
+
+#endif
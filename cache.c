@@ -0,0 +1,378 @@
+#include "cache.h"
+#include <stddef.h>
+#include <string.h>
+#include "lookahead.h"
+
+static void normalize_grammar_text(const char *text, size_t length, list *normalized);
+static uint64_t hash_grammar_text(const char *text, size_t length);
+static cache_entry *find_entry(const parser_cache *cache, uint64_t hash, const char *text, size_t length);
+static void insert_entry(parser_cache *cache, cache_entry *entry);
+static void remove_entry(parser_cache *cache, cache_entry *entry);
+static void unlink_used_entry(parser_cache *cache, cache_entry *entry);
+static void push_used_entry(parser_cache *cache, cache_entry *entry);
+static cache_entry *evict_entries(parser_cache *cache);
+static void free_entries(cache_entry *entry);
+static void free_entry(cache_entry *entry);
+
+void init_parser_cache(parser_cache *cache, size_t max_bytes)
+{
+    pthread_mutex_init(&cache->lock, NULL);
+    pthread_cond_init(&cache->built, NULL);
+    cache->n_buckets = 64;
+    cache->buckets = calloc(cache->n_buckets, sizeof(cache_entry *));
+    cache->n_entries = 0;
+    cache->newest = NULL;
+    cache->oldest = NULL;
+    cache->max_bytes = max_bytes;
+    cache->table_bytes = 0;
+    cache->strategy = ANALYSIS_WORKLIST;
+    cache->max_lookahead = 1;
+    memset(&cache->counters, 0, sizeof(cache->counters));
+}
+
+const parser *acquire_cached_parser(parser_cache *cache, const char *text, size_t length)
+{
+    list normalized;
+    init_list(&normalized, length + 1, sizeof(char));
+    normalize_grammar_text(text, length, &normalized);
+    uint64_t hash = hash_grammar_text(normalized.head, normalized.count);
+
+    pthread_mutex_lock(&cache->lock);
+    cache_entry *entry = find_entry(cache, hash, normalized.head, normalized.count);
+    if (entry)
+    {
+        clear_list(&normalized);
+        entry->n_refs++;
+        cache->counters.hits++;
+        if (entry->state == CACHE_BUILDING)
+            cache->counters.waits++;
+
+        while (entry->state == CACHE_BUILDING)
+            pthread_cond_wait(&cache->built, &cache->lock);
+
+        if (entry->state == CACHE_FAILED)
+        {
+            // The builder already took the entry out of the table
+            bool last = --entry->n_refs == 0;
+            pthread_mutex_unlock(&cache->lock);
+            if (last)
+                free_entry(entry);
+
+            return NULL;
+        }
+
+        unlink_used_entry(cache, entry);
+        push_used_entry(cache, entry);
+        pthread_mutex_unlock(&cache->lock);
+        return &entry->parser;
+    }
+
+    // Other threads asking for the grammar wait for this one to build it
+    cache->counters.misses++;
+    entry = malloc(sizeof(cache_entry));
+    entry->hash = hash;
+    entry->text = normalized.head;
+    entry->text_length = normalized.count;
+    entry->table_bytes = 0;
+    entry->n_refs = 1;
+    entry->state = CACHE_BUILDING;
+    entry->newer = NULL;
+    entry->older = NULL;
+    insert_entry(cache, entry);
+    analysis_strategy strategy = cache->strategy;
+    size_t max_lookahead = cache->max_lookahead;
+    pthread_mutex_unlock(&cache->lock);
+
+    init_grammar(&entry->grammar, 16);
+    bool success = create_grammar_from_buffer(&entry->grammar, entry->text, entry->text_length);
+    if (success)
+    {
+        init_parser(&entry->parser, &entry->grammar);
+        entry->parser.strategy = strategy;
+        entry->parser.max_lookahead = max_lookahead;
+        build_parse_table(&entry->parser);
+        entry->table_bytes = get_table_bytes(&entry->parser);
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    cache_entry *evicted = NULL;
+    if (success)
+    {
+        entry->state = CACHE_READY;
+        cache->table_bytes += entry->table_bytes;
+        push_used_entry(cache, entry);
+        evicted = evict_entries(cache);
+    }
+    else
+    {
+        entry->state = CACHE_FAILED;
+        entry->n_refs--;
+        remove_entry(cache, entry);
+    }
+
+    bool unused = entry->n_refs == 0;
+    pthread_cond_broadcast(&cache->built);
+    pthread_mutex_unlock(&cache->lock);
+
+    free_entries(evicted);
+    if (!success)
+    {
+        // Waiters still look at the state, the last of them frees it
+        if (unused)
+            free_entry(entry);
+
+        return NULL;
+    }
+
+    return &entry->parser;
+}
+
+void release_cached_parser(parser_cache *cache, const parser *parser)
+{
+    cache_entry *entry = (cache_entry *)((char *)parser - offsetof(cache_entry, parser));
+    pthread_mutex_lock(&cache->lock);
+    entry->n_refs--;
+    cache_entry *evicted = NULL;
+    if (entry->n_refs == 0 && cache->table_bytes > cache->max_bytes)
+        evicted = evict_entries(cache);
+
+    pthread_mutex_unlock(&cache->lock);
+    free_entries(evicted);
+}
+
+parser_cache_counters get_parser_cache_counters(parser_cache *cache)
+{
+    pthread_mutex_lock(&cache->lock);
+    parser_cache_counters counters = cache->counters;
+    counters.table_bytes = cache->table_bytes;
+    counters.n_entries = cache->n_entries;
+    pthread_mutex_unlock(&cache->lock);
+    return counters;
+}
+
+void clear_parser_cache(parser_cache *cache)
+{
+    for (size_t i = 0; i < cache->n_buckets; i++)
+    {
+        cache_entry *entry = cache->buckets[i];
+        while (entry)
+        {
+            cache_entry *next = entry->next;
+            free_entry(entry);
+            entry = next;
+        }
+    }
+
+    free(cache->buckets);
+    pthread_cond_destroy(&cache->built);
+    pthread_mutex_destroy(&cache->lock);
+}
+
+size_t get_table_bytes(const parser *parser)
+{
+    size_t n_rules = parser->grammar->rules.count;
+    size_t n_symbols = parser->grammar->symbols.count;
+    size_t bytes = (n_rules + 2 * n_symbols) * parser->set_words * sizeof(uint64_t);
+    bytes += (bitset_words(n_rules) + bitset_words(n_symbols)) * sizeof(uint64_t);
+    bytes += parser->n_nonterminals * parser->n_terminals * sizeof(int);
+    if (parser->packed_cells)
+        bytes += parser->n_nonterminals * sizeof(int) + parser->n_packed_cells * sizeof(packed_cell);
+    bytes += parser->conflicts.count * sizeof(table_conflict);
+    bytes += parser->lookahead_nodes.count * sizeof(lookahead_node);
+    bytes += parser->lookahead_edges.count * sizeof(lookahead_edge);
+    bytes += n_symbols * (sizeof(int) + sizeof(bool));
+    bytes += (parser->rhs_offsets[n_rules] + n_rules + 2) * sizeof(int);
+    return bytes;
+}
+
+// Names are split on runs of spaces like the grammar reader does, so only
+// differences it ignores are dropped. A line of spaces is an error for the
+// reader and is kept as one. The result is at most one byte longer than
+// the text.
+void normalize_grammar_text(const char *text, size_t length, list *normalized)
+{
+    reserve_list(normalized, length + 1);
+    char *out = normalized->head;
+    char *line = out;
+    bool space = false;
+    for (const char *c = text; c < text + length; c++)
+    {
+        if (*c == ' ')
+        {
+            space = true;
+            continue;
+        }
+
+        if (*c == '\n')
+        {
+            if (out == line && space)
+                *out++ = ' ';
+            if (out != line)
+                *out++ = '\n';
+
+            line = out;
+            space = false;
+            continue;
+        }
+
+        if (space && out != line)
+            *out++ = ' ';
+
+        *out++ = *c;
+        space = false;
+    }
+
+    if (out == line && space)
+        *out++ = ' ';
+    if (out != line)
+        *out++ = '\n';
+
+    normalized->count = out - (char *)normalized->head;
+}
+
+// FNV-1a over 8 byte words. Entries with the same hash are told apart by
+// their text, so the hash only has to spread them over the buckets.
+uint64_t hash_grammar_text(const char *text, size_t length)
+{
+    uint64_t hash = 14695981039346656037ull;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, text + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+
+    for (; i < length; i++)
+    {
+        hash ^= (unsigned char)text[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash ^ (hash >> 32);
+}
+
+cache_entry *find_entry(const parser_cache *cache, uint64_t hash, const char *text, size_t length)
+{
+    cache_entry *entry = cache->buckets[hash & (cache->n_buckets - 1)];
+    while (entry)
+    {
+        if (entry->hash == hash && entry->text_length == length && memcmp(entry->text, text, length) == 0)
+            return entry;
+
+        entry = entry->next;
+    }
+
+    return NULL;
+}
+
+void insert_entry(parser_cache *cache, cache_entry *entry)
+{
+    if (cache->n_entries >= cache->n_buckets)
+    {
+        size_t n_buckets = cache->n_buckets * 2;
+        cache_entry **buckets = calloc(n_buckets, sizeof(cache_entry *));
+        for (size_t i = 0; i < cache->n_buckets; i++)
+        {
+            cache_entry *moved = cache->buckets[i];
+            while (moved)
+            {
+                cache_entry *next = moved->next;
+                moved->next = buckets[moved->hash & (n_buckets - 1)];
+                buckets[moved->hash & (n_buckets - 1)] = moved;
+                moved = next;
+            }
+        }
+
+        free(cache->buckets);
+        cache->buckets = buckets;
+        cache->n_buckets = n_buckets;
+    }
+
+    cache_entry **bucket = &cache->buckets[entry->hash & (cache->n_buckets - 1)];
+    entry->next = *bucket;
+    *bucket = entry;
+    cache->n_entries++;
+}
+
+void remove_entry(parser_cache *cache, cache_entry *entry)
+{
+    cache_entry **link = &cache->buckets[entry->hash & (cache->n_buckets - 1)];
+    while (*link != entry)
+        link = &(*link)->next;
+
+    *link = entry->next;
+    cache->n_entries--;
+}
+
+void unlink_used_entry(parser_cache *cache, cache_entry *entry)
+{
+    if (entry->newer)
+        entry->newer->older = entry->older;
+    else
+        cache->newest = entry->older;
+
+    if (entry->older)
+        entry->older->newer = entry->newer;
+    else
+        cache->oldest = entry->newer;
+
+    entry->newer = NULL;
+    entry->older = NULL;
+}
+
+void push_used_entry(parser_cache *cache, cache_entry *entry)
+{
+    entry->older = cache->newest;
+    if (cache->newest)
+        cache->newest->newer = entry;
+    else
+        cache->oldest = entry;
+
+    cache->newest = entry;
+}
+
+// Takes least recently used entries nobody holds out of the cache until
+// the tables fit, and returns them chained for freeing outside the lock
+cache_entry *evict_entries(parser_cache *cache)
+{
+    cache_entry *evicted = NULL;
+    cache_entry *entry = cache->oldest;
+    while (entry && cache->table_bytes > cache->max_bytes)
+    {
+        cache_entry *newer = entry->newer;
+        if (entry->n_refs == 0)
+        {
+            unlink_used_entry(cache, entry);
+            remove_entry(cache, entry);
+            cache->table_bytes -= entry->table_bytes;
+            cache->counters.evictions++;
+            entry->next = evicted;
+            evicted = entry;
+        }
+
+        entry = newer;
+    }
+
+    return evicted;
+}
+
+void free_entries(cache_entry *entry)
+{
+    while (entry)
+    {
+        cache_entry *next = entry->next;
+        free_entry(entry);
+        entry = next;
+    }
+}
+
+void free_entry(cache_entry *entry)
+{
+    if (entry->state != CACHE_FAILED)
+        clear_parser(&entry->parser);
+
+    clear_grammar(&entry->grammar);
+    free(entry->text);
+    free(entry);
+}
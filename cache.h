@@ -0,0 +1,80 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <pthread.h>
+#include "parser.h"
+
+// Parsers built from grammar text and shared by every thread that asks for
+// the same grammar. Entries are keyed by a hash of the normalized text, so
+// texts that only differ in spacing or blank lines share one parser.
+//
+// A parser handed out stays valid until it is released and any number of
+// threads may read it at once. Released parsers stay cached until the
+// least recently used ones are evicted to keep the tables under max_bytes.
+
+typedef enum
+{
+    CACHE_BUILDING,
+    CACHE_READY,
+    CACHE_FAILED
+} cache_entry_state;
+
+typedef struct cache_entry
+{
+    parser parser;
+    grammar grammar;
+    uint64_t hash;
+    char *text;
+    size_t text_length;
+    size_t table_bytes;
+    // Threads holding the parser or waiting for it to be built
+    size_t n_refs;
+    cache_entry_state state;
+    struct cache_entry *next;
+    // Ready entries by last use
+    struct cache_entry *newer;
+    struct cache_entry *older;
+} cache_entry;
+
+typedef struct
+{
+    uint64_t hits;
+    uint64_t misses;
+    // Hits that found the parser still being built by another thread
+    uint64_t waits;
+    uint64_t evictions;
+    size_t table_bytes;
+    size_t n_entries;
+} parser_cache_counters;
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t built;
+    cache_entry **buckets;
+    size_t n_buckets;
+    size_t n_entries;
+    cache_entry *newest;
+    cache_entry *oldest;
+    size_t max_bytes;
+    size_t table_bytes;
+    // Applied to every parser the cache builds, set before the first use
+    analysis_strategy strategy;
+    size_t max_lookahead;
+    parser_cache_counters counters;
+} parser_cache;
+
+void init_parser_cache(parser_cache *cache, size_t max_bytes);
+// Parser for the grammar text, built by the first thread to ask for it.
+// Returns NULL if the text is not a grammar. The parser may still have
+// conflicts, which is_valid_grammar reports.
+const parser *acquire_cached_parser(parser_cache *cache, const char *text, size_t length);
+void release_cached_parser(parser_cache *cache, const parser *parser);
+parser_cache_counters get_parser_cache_counters(parser_cache *cache);
+// Every parser must have been released
+void clear_parser_cache(parser_cache *cache);
+
+// Bytes of the sets, table and driver arrays of a built parser
+size_t get_table_bytes(const parser *parser);
+
+#endif
@@ -0,0 +1,222 @@
+#include "codegen.h"
+#include <string.h>
+
+static void write_terminal_lookup(const parser *parser, const char *prefix, FILE *out);
+static void write_token_recognizer(const parser *parser, const char *prefix, FILE *out);
+static void write_string_recognizer(const char *prefix, FILE *out);
+static void write_expansions(const parser *parser, FILE *out);
+static void write_comment_name(FILE *out, const char *name);
+
+bool generate_recognizer(const parser *parser, const char *prefix, FILE *out)
+{
+    if (!parser->grammar || !is_valid_grammar(parser))
+    {
+        return false;
+    }
+
+    fprintf(out, "// Generated by ll1.bin --generate, do not edit\n\n");
+    fprintf(out, "#include <stdbool.h>\n#include <stddef.h>\n#include <stdint.h>\n#include <stdlib.h>\n"
+                 "#include <string.h>\n\n");
+
+    write_terminal_lookup(parser, prefix, out);
+    write_token_recognizer(parser, prefix, out);
+    write_string_recognizer(prefix, out);
+
+    return !ferror(out);
+}
+
+void write_terminal_lookup(const parser *parser, const char *prefix, FILE *out)
+{
+    const hash_table *terminals = &parser->terminals;
+
+    // The terminal hash table is copied as is, so lookups probe the same
+    // slots as find_terminal
+    fprintf(out, "static const char %s_terminal_keys[%zu] = {", prefix, terminals->keys.count);
+    for (size_t i = 0; i < terminals->keys.count; i++)
+    {
+        fprintf(out, "%s%d", i % 16 == 0 ? "\n    " : " ", *(char *)get_list_element(&terminals->keys, i));
+        if (i + 1 < terminals->keys.count)
+            putc(',', out);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "static const struct\n{\n    uint32_t hash;\n    uint32_t key_offset;\n    uint32_t key_length;\n"
+                 "    int value;\n} %s_terminal_entries[%zu] = {\n",
+            prefix, terminals->capacity);
+    for (size_t i = 0; i < terminals->capacity; i++)
+    {
+        const hash_entry *entry = terminals->entries + i;
+        if (entry->value == HASH_TABLE_MISSING)
+            fprintf(out, "    {0, 0, 0, -1},\n");
+        else
+            fprintf(out, "    {%uu, %u, %u, %d},\n", entry->hash, entry->key_offset, entry->key_length,
+                    entry->value);
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "int %s_find_terminal(const char *token, size_t length)\n{\n", prefix);
+    fprintf(out, "    uint32_t hash = 2166136261u;\n");
+    fprintf(out, "    for (size_t i = 0; i < length; i++)\n");
+    fprintf(out, "    {\n        hash ^= (unsigned char)token[i];\n        hash *= 16777619u;\n    }\n\n");
+    fprintf(out, "    for (size_t i = hash & %zu;; i = (i + 1) & %zu)\n    {\n", terminals->capacity - 1,
+            terminals->capacity - 1);
+    fprintf(out, "        if (%s_terminal_entries[i].value < 0)\n            return -1;\n\n", prefix);
+    fprintf(out,
+            "        if (%s_terminal_entries[i].hash == hash && %s_terminal_entries[i].key_length == length &&\n"
+            "            memcmp(%s_terminal_keys + %s_terminal_entries[i].key_offset, token, length) == 0)\n",
+            prefix, prefix, prefix, prefix);
+    fprintf(out, "            return %s_terminal_entries[i].value;\n    }\n}\n\n", prefix);
+}
+
+void write_token_recognizer(const parser *parser, const char *prefix, FILE *out)
+{
+    fprintf(out, "bool %s_recognize_tokens(const int *tokens, size_t n_tokens)\n{\n", prefix);
+    fprintf(out, "    int local_stack[256];\n");
+    fprintf(out, "    int *stack = local_stack;\n");
+    fprintf(out, "    size_t capacity = 256;\n");
+    fprintf(out, "    size_t count = 0;\n");
+    fprintf(out, "    bool success = false;\n\n");
+    fprintf(out, "#define ENSURE_STACK(n) \\\n"
+                 "    if (count + (n) > capacity) \\\n"
+                 "    { \\\n"
+                 "        capacity = (capacity + (n)) * 2; \\\n"
+                 "        int *grown = malloc(capacity * sizeof(int)); \\\n"
+                 "        memcpy(grown, stack, count * sizeof(int)); \\\n"
+                 "        if (stack != local_stack) \\\n"
+                 "            free(stack); \\\n"
+                 "        stack = grown; \\\n"
+                 "    }\n\n");
+    fprintf(out, "    stack[count++] = %d;\n", parser->start_symbol);
+    fprintf(out, "    for (size_t i = 0; i <= n_tokens; i++)\n    {\n");
+    fprintf(out, "        int token = i < n_tokens ? tokens[i] : %d;\n", parser->end_symbol);
+    fprintf(out, "        for (;;)\n        {\n");
+    fprintf(out, "            if (count == 0)\n                goto done;\n\n");
+    fprintf(out, "            int top = stack[--count];\n");
+    fprintf(out, "            switch (top)\n            {\n");
+
+    write_expansions(parser, out);
+
+    fprintf(out, "            default:\n");
+    fprintf(out, "                if (top != token)\n                    goto done;\n");
+    fprintf(out, "                break;\n");
+    fprintf(out, "            }\n\n");
+    fprintf(out, "            break;\n");
+    fprintf(out, "        }\n    }\n\n");
+    fprintf(out, "    success = count == 0;\n\n");
+    fprintf(out, "done:\n");
+    fprintf(out, "#undef ENSURE_STACK\n");
+    fprintf(out, "    if (stack != local_stack)\n        free(stack);\n\n");
+    fprintf(out, "    return success;\n}\n\n");
+}
+
+void write_string_recognizer(const char *prefix, FILE *out)
+{
+    fprintf(out, "bool %s_recognize(const char *str, size_t length)\n{\n", prefix);
+    fprintf(out, "    int local_tokens[256];\n");
+    fprintf(out, "    int *tokens = local_tokens;\n");
+    fprintf(out, "    size_t capacity = 256;\n");
+    fprintf(out, "    size_t n_tokens = 0;\n");
+    fprintf(out, "    bool success = true;\n\n");
+    fprintf(out, "    size_t i = 0;\n");
+    fprintf(out, "    while (i < length)\n    {\n");
+    fprintf(out, "        char c = str[i];\n");
+    fprintf(out, "        if (c == ' ' || c == '\\t' || c == '\\n' || c == '\\r')\n");
+    fprintf(out, "        {\n            i++;\n            continue;\n        }\n\n");
+    fprintf(out, "        size_t start = i;\n");
+    fprintf(out, "        while (i < length && str[i] != ' ' && str[i] != '\\t' && str[i] != '\\n' && "
+                 "str[i] != '\\r')\n            i++;\n\n");
+    fprintf(out, "        int token = %s_find_terminal(str + start, i - start);\n", prefix);
+    fprintf(out, "        if (token < 0)\n        {\n            success = false;\n            break;\n        }\n\n");
+    fprintf(out, "        if (n_tokens == capacity)\n        {\n");
+    fprintf(out, "            capacity *= 2;\n");
+    fprintf(out, "            int *grown = malloc(capacity * sizeof(int));\n");
+    fprintf(out, "            memcpy(grown, tokens, n_tokens * sizeof(int));\n");
+    fprintf(out, "            if (tokens != local_tokens)\n                free(tokens);\n\n");
+    fprintf(out, "            tokens = grown;\n");
+    fprintf(out, "        }\n\n");
+    fprintf(out, "        tokens[n_tokens++] = token;\n");
+    fprintf(out, "    }\n\n");
+    fprintf(out, "    success = success && %s_recognize_tokens(tokens, n_tokens);\n", prefix);
+    fprintf(out, "    if (tokens != local_tokens)\n        free(tokens);\n\n");
+    fprintf(out, "    return success;\n}\n");
+}
+
+void write_expansions(const parser *parser, FILE *out)
+{
+    const grammar *grammar = parser->grammar;
+
+    // One case per nonterminal, the rhs of every rule is pushed as constants
+    for (size_t i = 0; i < grammar->symbols.count; i++)
+    {
+        const symbol *nonterminal = get_list_element(&grammar->symbols, i);
+        if (parser->terminal_symbols[nonterminal->id])
+            continue;
+
+        fprintf(out, "            case %d: ", nonterminal->id);
+        write_comment_name(out, symbol_name(grammar, nonterminal));
+        fprintf(out, "\n                switch (token)\n                {\n");
+
+        int row = parser->symbol_ordinals[nonterminal->id];
+        for (size_t rule_index = 0; rule_index < grammar->rules.count; rule_index++)
+        {
+            const rule *rule = get_list_element(&grammar->rules, rule_index);
+            if (rule->lhs != nonterminal)
+                continue;
+
+            // Group all terminals that select the same rule
+            bool has_case = false;
+            for (size_t j = 0; j < grammar->symbols.count; j++)
+            {
+                const symbol *terminal = get_list_element(&grammar->symbols, j);
+                if (!parser->terminal_symbols[terminal->id])
+                    continue;
+
+                if (parser->table[row * parser->n_terminals + parser->symbol_ordinals[terminal->id]] != rule->id)
+                    continue;
+
+                fprintf(out, "                case %d: ", terminal->id);
+                write_comment_name(out, symbol_name(grammar, terminal));
+                putc('\n', out);
+                has_case = true;
+            }
+
+            if (!has_case)
+                continue;
+
+            int rhs_begin = parser->rhs_offsets[rule->id];
+            int rhs_end = parser->rhs_offsets[rule->id + 1];
+
+            // A rule that starts with a terminal is only selected by that
+            // terminal, so it is matched right away instead of being pushed
+            bool matches_token = rhs_end > rhs_begin && parser->terminal_symbols[parser->rhs_symbols[rhs_end - 1]];
+            if (matches_token)
+                rhs_end--;
+
+            if (rhs_end > rhs_begin)
+            {
+                fprintf(out, "                    ENSURE_STACK(%d);\n", rhs_end - rhs_begin);
+                for (int k = rhs_begin; k < rhs_end; k++)
+                    fprintf(out, "                    stack[count++] = %d;\n", parser->rhs_symbols[k]);
+            }
+
+            fprintf(out, matches_token ? "                    break;\n" : "                    continue;\n");
+        }
+
+        fprintf(out, "                default:\n                    goto done;\n                }\n");
+        fprintf(out, "                break;\n");
+    }
+}
+
+void write_comment_name(FILE *out, const char *name)
+{
+    // Names can contain anything but whitespace, so keep them from closing
+    // the comment early
+    fputs("/* ", out);
+    for (const char *c = name; *c; c++)
+    {
+        putc(*c, out);
+        if (c[0] == '*' && c[1] == '/')
+            putc(' ', out);
+    }
+    fputs(" */", out);
+}
@@ -0,0 +1,15 @@
+#ifndef CODEGEN_H
+#define CODEGEN_H
+
+#include <stdio.h>
+#include "parser.h"
+
+// Writes a standalone C recognizer for the grammar of a built LL(1) parser.
+// The generated file defines, with every name starting with prefix:
+//   int <prefix>_find_terminal(const char *token, size_t length);
+//   bool <prefix>_recognize_tokens(const int *tokens, size_t n_tokens);
+//   bool <prefix>_recognize(const char *str, size_t length);
+// Token ids are the symbol ids of the parser.
+bool generate_recognizer(const parser *parser, const char *prefix, FILE *out);
+
+#endif
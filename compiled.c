@@ -0,0 +1,369 @@
+#include "compiled.h"
+#include <string.h>
+
+_Static_assert(sizeof(int) == sizeof(int32_t), "parser ints are stored as int32_t");
+
+static void add_section(list *image, compiled_header *header, compiled_section section, const void *data,
+                        size_t size);
+static uint64_t compute_checksum(const char *data, size_t size);
+static bool has_valid_sections(const compiled_header *header);
+static bool has_valid_contents(const compiled_parser *compiled);
+static bool has_valid_rhs(const compiled_parser *compiled, compiled_section offsets_section,
+                          compiled_section rhs_section);
+
+bool write_compiled_parser(const parser *parser, FILE *file)
+{
+    const grammar *grammar = parser->grammar;
+    if (!grammar || !is_valid_grammar(parser))
+    {
+        return false;
+    }
+
+    size_t n_symbols = grammar->symbols.count;
+    size_t n_rules = grammar->rules.count;
+
+    compiled_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COMPILED_MAGIC, sizeof(header.magic));
+    header.version = COMPILED_VERSION;
+    header.byte_order = COMPILED_BYTE_ORDER;
+    header.n_symbols = n_symbols;
+    header.n_rules = n_rules;
+    header.n_terminals = parser->n_terminals;
+    header.n_nonterminals = parser->n_nonterminals;
+    header.set_words = parser->set_words;
+    header.start_symbol = parser->start_symbol;
+    header.end_symbol = parser->end_symbol;
+    header.empty_symbol = parser->empty_symbol;
+    header.max_terminal_length = parser->max_terminal_length;
+    header.terminal_capacity = parser->terminals.capacity;
+    header.terminal_count = parser->terminals.count;
+    header.terminal_keys_size = parser->terminals.keys.count;
+
+    list image;
+    init_list(&image, sizeof(header), sizeof(char));
+    push_back_many(&image, &header, sizeof(header));
+
+    // Symbols
+    list types;
+    list name_offsets;
+    list names;
+    init_list(&types, n_symbols, sizeof(uint8_t));
+    init_list(&name_offsets, n_symbols, sizeof(uint32_t));
+    init_list(&names, 0, sizeof(char));
+    for (size_t i = 0; i < n_symbols; i++)
+    {
+        symbol *symbol = get_list_element(&grammar->symbols, i);
+        uint8_t *type = new_list_element(&types);
+        *type = symbol->type;
+        uint32_t *name_offset = new_list_element(&name_offsets);
+        *name_offset = names.count;
+        push_back_many(&names, symbol_name(grammar, symbol), symbol->name_length + 1);
+    }
+
+    add_section(&image, &header, SECTION_SYMBOL_TYPES, types.head, types.count);
+    add_section(&image, &header, SECTION_SYMBOL_NAME_OFFSETS, name_offsets.head, n_symbols * sizeof(uint32_t));
+    add_section(&image, &header, SECTION_SYMBOL_NAMES, names.head, names.count);
+    clear_list(&types);
+    clear_list(&name_offsets);
+    clear_list(&names);
+
+    // Rules, with their rhs in grammar order
+    list lhs;
+    list rhs_offsets;
+    list rhs;
+    init_list(&lhs, n_rules, sizeof(int32_t));
+    init_list(&rhs_offsets, n_rules + 1, sizeof(int32_t));
+    init_list(&rhs, 0, sizeof(int32_t));
+    for (size_t i = 0; i < n_rules; i++)
+    {
+        rule *rule = get_list_element(&grammar->rules, i);
+        int32_t *lhs_id = new_list_element(&lhs);
+        *lhs_id = rule->lhs->id;
+        int32_t *rhs_offset = new_list_element(&rhs_offsets);
+        *rhs_offset = rhs.count;
+        for (size_t j = 0; j < rule->rhs.count; j++)
+        {
+            symbol *rhs_symbol = *(symbol **)get_list_element(&rule->rhs, j);
+            int32_t *rhs_id = new_list_element(&rhs);
+            *rhs_id = rhs_symbol->id;
+        }
+    }
+
+    int32_t *rhs_end = new_list_element(&rhs_offsets);
+    *rhs_end = rhs.count;
+
+    add_section(&image, &header, SECTION_RULE_LHS, lhs.head, n_rules * sizeof(int32_t));
+    add_section(&image, &header, SECTION_RULE_RHS_OFFSETS, rhs_offsets.head, (n_rules + 1) * sizeof(int32_t));
+    add_section(&image, &header, SECTION_RULE_RHS, rhs.head, rhs.count * sizeof(int32_t));
+    clear_list(&lhs);
+    clear_list(&rhs_offsets);
+    clear_list(&rhs);
+
+    // Analysis results
+    add_section(&image, &header, SECTION_NULLABLE_RULES, parser->nullable_rules,
+                bitset_words(n_rules) * sizeof(uint64_t));
+    add_section(&image, &header, SECTION_NULLABLE_SYMBOLS, parser->nullable_symbols,
+                bitset_words(n_symbols) * sizeof(uint64_t));
+    add_section(&image, &header, SECTION_RULE_FIRST_SETS, parser->rule_first_sets,
+                n_rules * parser->set_words * sizeof(uint64_t));
+    add_section(&image, &header, SECTION_SYMBOL_FIRST_SETS, parser->symbol_first_sets,
+                n_symbols * parser->set_words * sizeof(uint64_t));
+    add_section(&image, &header, SECTION_SYMBOL_FOLLOW_SETS, parser->symbol_follow_sets,
+                n_symbols * parser->set_words * sizeof(uint64_t));
+
+    // Everything the driver reads
+    add_section(&image, &header, SECTION_TERMINAL_SYMBOLS, parser->terminal_symbols, n_symbols * sizeof(bool));
+    add_section(&image, &header, SECTION_SYMBOL_ORDINALS, parser->symbol_ordinals, n_symbols * sizeof(int));
+    add_section(&image, &header, SECTION_DRIVER_RHS_OFFSETS, parser->rhs_offsets, (n_rules + 1) * sizeof(int));
+    add_section(&image, &header, SECTION_DRIVER_RHS, parser->rhs_symbols, parser->rhs_offsets[n_rules] * sizeof(int));
+    add_section(&image, &header, SECTION_TABLE, parser->table,
+                parser->n_nonterminals * parser->n_terminals * sizeof(int));
+    add_section(&image, &header, SECTION_TERMINAL_ENTRIES, parser->terminals.entries,
+                parser->terminals.capacity * sizeof(hash_entry));
+    add_section(&image, &header, SECTION_TERMINAL_KEYS, parser->terminals.keys.head, parser->terminals.keys.count);
+
+    header.size = image.count;
+    header.checksum = compute_checksum((char *)image.head + sizeof(header), image.count - sizeof(header));
+    memcpy(image.head, &header, sizeof(header));
+
+    bool success = fwrite(image.head, sizeof(char), image.count, file) == image.count;
+    clear_list(&image);
+
+    return success;
+}
+
+bool load_compiled_parser(compiled_parser *compiled, FILE *file, bool verify)
+{
+    if (!map_file(file, &compiled->file))
+    {
+        return false;
+    }
+
+    const compiled_header *header = (const compiled_header *)compiled->file.data;
+    compiled->header = header;
+
+    if (compiled->file.size < sizeof(compiled_header) || memcmp(header->magic, COMPILED_MAGIC, 8) != 0 ||
+        header->version != COMPILED_VERSION || header->byte_order != COMPILED_BYTE_ORDER ||
+        header->size != compiled->file.size || !has_valid_sections(header))
+    {
+        unmap_file(&compiled->file);
+        return false;
+    }
+
+    // Checking the whole image touches every page, so it is optional
+    if (verify && (compute_checksum(compiled->file.data + sizeof(compiled_header),
+                                    compiled->file.size - sizeof(compiled_header)) != header->checksum ||
+                   !has_valid_contents(compiled)))
+    {
+        unmap_file(&compiled->file);
+        return false;
+    }
+
+    parser *parser = &compiled->parser;
+    memset(parser, 0, sizeof(*parser));
+    parser->grammar = NULL;
+    parser->nullable_rules = (uint64_t *)get_compiled_section(compiled, SECTION_NULLABLE_RULES);
+    parser->nullable_symbols = (uint64_t *)get_compiled_section(compiled, SECTION_NULLABLE_SYMBOLS);
+    parser->set_words = header->set_words;
+    parser->rule_first_sets = (uint64_t *)get_compiled_section(compiled, SECTION_RULE_FIRST_SETS);
+    parser->symbol_first_sets = (uint64_t *)get_compiled_section(compiled, SECTION_SYMBOL_FIRST_SETS);
+    parser->symbol_follow_sets = (uint64_t *)get_compiled_section(compiled, SECTION_SYMBOL_FOLLOW_SETS);
+    parser->n_terminals = header->n_terminals;
+    parser->n_nonterminals = header->n_nonterminals;
+    parser->symbol_ordinals = (int *)get_compiled_section(compiled, SECTION_SYMBOL_ORDINALS);
+    parser->table = (int *)get_compiled_section(compiled, SECTION_TABLE);
+    init_list(&parser->conflicts, 0, sizeof(table_conflict));
+    // Lookahead tries are not compiled, only LL(1) tables are written
+    parser->max_lookahead = 1;
+    parser->lookahead_depth = 1;
+
+    parser->terminals.entries = (hash_entry *)get_compiled_section(compiled, SECTION_TERMINAL_ENTRIES);
+    parser->terminals.capacity = header->terminal_capacity;
+    parser->terminals.count = header->terminal_count;
+    parser->terminals.keys.head = (void *)get_compiled_section(compiled, SECTION_TERMINAL_KEYS);
+    parser->terminals.keys.elem_byte_size = sizeof(char);
+    parser->terminals.keys.count = header->terminal_keys_size;
+    parser->terminals.keys.size = header->terminal_keys_size;
+    parser->max_terminal_length = header->max_terminal_length;
+
+    parser->start_symbol = header->start_symbol;
+    parser->end_symbol = header->end_symbol;
+    parser->empty_symbol = header->empty_symbol;
+    parser->terminal_symbols = (bool *)get_compiled_section(compiled, SECTION_TERMINAL_SYMBOLS);
+    parser->rhs_symbols = (int *)get_compiled_section(compiled, SECTION_DRIVER_RHS);
+    parser->rhs_offsets = (int *)get_compiled_section(compiled, SECTION_DRIVER_RHS_OFFSETS);
+
+    return true;
+}
+
+void unload_compiled_parser(compiled_parser *compiled)
+{
+    // Nothing was allocated for the parser, its arrays live in the mapping
+    unmap_file(&compiled->file);
+    compiled->header = NULL;
+}
+
+const char *get_compiled_symbol_name(const compiled_parser *compiled, int symbol)
+{
+    const uint32_t *name_offsets = get_compiled_section(compiled, SECTION_SYMBOL_NAME_OFFSETS);
+    const char *names = get_compiled_section(compiled, SECTION_SYMBOL_NAMES);
+    return names + name_offsets[symbol];
+}
+
+const void *get_compiled_section(const compiled_parser *compiled, compiled_section section)
+{
+    return compiled->file.data + compiled->header->section_offsets[section];
+}
+
+void add_section(list *image, compiled_header *header, compiled_section section, const void *data, size_t size)
+{
+    // Sections are aligned for the widest element type they hold
+    static const char padding[8] = {0};
+    push_back_many(image, padding, (8 - image->count % 8) % 8);
+
+    header->section_offsets[section] = image->count;
+    header->section_sizes[section] = size;
+    if (size > 0)
+        push_back_many(image, data, size);
+}
+
+uint64_t compute_checksum(const char *data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+bool has_valid_sections(const compiled_header *header)
+{
+    uint64_t n_symbols = header->n_symbols;
+    uint64_t n_rules = header->n_rules;
+    uint64_t set_bytes = header->set_words * sizeof(uint64_t);
+
+    // Minimum size of every section given the counts in the header
+    uint64_t expected_sizes[N_SECTIONS] = {0};
+    expected_sizes[SECTION_SYMBOL_TYPES] = n_symbols;
+    expected_sizes[SECTION_SYMBOL_NAME_OFFSETS] = n_symbols * sizeof(uint32_t);
+    expected_sizes[SECTION_RULE_LHS] = n_rules * sizeof(int32_t);
+    expected_sizes[SECTION_RULE_RHS_OFFSETS] = (n_rules + 1) * sizeof(int32_t);
+    expected_sizes[SECTION_NULLABLE_RULES] = bitset_words(n_rules) * sizeof(uint64_t);
+    expected_sizes[SECTION_NULLABLE_SYMBOLS] = bitset_words(n_symbols) * sizeof(uint64_t);
+    expected_sizes[SECTION_RULE_FIRST_SETS] = n_rules * set_bytes;
+    expected_sizes[SECTION_SYMBOL_FIRST_SETS] = n_symbols * set_bytes;
+    expected_sizes[SECTION_SYMBOL_FOLLOW_SETS] = n_symbols * set_bytes;
+    expected_sizes[SECTION_TERMINAL_SYMBOLS] = n_symbols * sizeof(bool);
+    expected_sizes[SECTION_SYMBOL_ORDINALS] = n_symbols * sizeof(int32_t);
+    expected_sizes[SECTION_DRIVER_RHS_OFFSETS] = (n_rules + 1) * sizeof(int32_t);
+    expected_sizes[SECTION_TABLE] = (uint64_t)header->n_terminals * header->n_nonterminals * sizeof(int32_t);
+    expected_sizes[SECTION_TERMINAL_ENTRIES] = header->terminal_capacity * sizeof(hash_entry);
+    expected_sizes[SECTION_TERMINAL_KEYS] = header->terminal_keys_size;
+
+    for (int section = 0; section < N_SECTIONS; section++)
+    {
+        uint64_t offset = header->section_offsets[section];
+        uint64_t size = header->section_sizes[section];
+        if (offset % 8 != 0 || offset < sizeof(compiled_header) || offset > header->size ||
+            size > header->size - offset || size < expected_sizes[section])
+            return false;
+    }
+
+    // Hash table probing relies on a power of two capacity
+    return header->terminal_capacity > 0 && (header->terminal_capacity & (header->terminal_capacity - 1)) == 0;
+}
+
+// Every id the driver and the symbol names index with is in range, so an
+// image that was written by hand with a matching checksum is refused too
+bool has_valid_contents(const compiled_parser *compiled)
+{
+    const compiled_header *header = compiled->header;
+    int64_t n_symbols = header->n_symbols;
+    int64_t n_rules = header->n_rules;
+    if (header->start_symbol < 0 || header->start_symbol >= n_symbols || header->end_symbol < 0 ||
+        header->end_symbol >= n_symbols || header->empty_symbol < -1 || header->empty_symbol >= n_symbols)
+        return false;
+
+    const uint8_t *types = get_compiled_section(compiled, SECTION_SYMBOL_TYPES);
+    const bool *terminal_symbols = get_compiled_section(compiled, SECTION_TERMINAL_SYMBOLS);
+    const int32_t *ordinals = get_compiled_section(compiled, SECTION_SYMBOL_ORDINALS);
+    const uint32_t *name_offsets = get_compiled_section(compiled, SECTION_SYMBOL_NAME_OFFSETS);
+    const char *names = get_compiled_section(compiled, SECTION_SYMBOL_NAMES);
+    uint64_t names_size = header->section_sizes[SECTION_SYMBOL_NAMES];
+    for (int64_t i = 0; i < n_symbols; i++)
+    {
+        // The flag is read as a bool, only 0 and 1 are well defined
+        uint8_t terminal = ((const uint8_t *)terminal_symbols)[i];
+        int64_t n_ordinals = terminal ? header->n_terminals : header->n_nonterminals;
+        if (terminal > 1 || types[i] > NONTERMINAL || ordinals[i] < 0 || ordinals[i] >= n_ordinals ||
+            name_offsets[i] >= names_size || !memchr(names + name_offsets[i], '\0', names_size - name_offsets[i]))
+            return false;
+    }
+
+    const int32_t *table = get_compiled_section(compiled, SECTION_TABLE);
+    uint64_t n_cells = (uint64_t)header->n_terminals * header->n_nonterminals;
+    for (uint64_t i = 0; i < n_cells; i++)
+    {
+        if (table[i] != NO_RULE && table[i] != CONFLICT_RULE && (table[i] < 0 || table[i] >= n_rules))
+            return false;
+    }
+
+    // Probing stops at an empty slot, so the table can not be full
+    const hash_entry *entries = get_compiled_section(compiled, SECTION_TERMINAL_ENTRIES);
+    uint64_t keys_size = header->section_sizes[SECTION_TERMINAL_KEYS];
+    size_t n_used = 0;
+    for (uint32_t i = 0; i < header->terminal_capacity; i++)
+    {
+        if (entries[i].value == HASH_TABLE_MISSING)
+            continue;
+
+        if (entries[i].value < 0 || entries[i].value >= n_symbols || !terminal_symbols[entries[i].value] ||
+            (uint64_t)entries[i].key_offset + entries[i].key_length >= keys_size)
+            return false;
+
+        n_used++;
+    }
+
+    if (n_used >= header->terminal_capacity)
+        return false;
+
+    const int32_t *lhs = get_compiled_section(compiled, SECTION_RULE_LHS);
+    for (int64_t i = 0; i < n_rules; i++)
+    {
+        if (lhs[i] < 0 || lhs[i] >= n_symbols)
+            return false;
+    }
+
+    return has_valid_rhs(compiled, SECTION_RULE_RHS_OFFSETS, SECTION_RULE_RHS) &&
+           has_valid_rhs(compiled, SECTION_DRIVER_RHS_OFFSETS, SECTION_DRIVER_RHS);
+}
+
+// Offsets start at 0, never go back and end inside the rhs section, which
+// only holds symbol ids
+bool has_valid_rhs(const compiled_parser *compiled, compiled_section offsets_section, compiled_section rhs_section)
+{
+    const compiled_header *header = compiled->header;
+    const int32_t *offsets = get_compiled_section(compiled, offsets_section);
+    const int32_t *rhs = get_compiled_section(compiled, rhs_section);
+    uint64_t n_rhs = header->section_sizes[rhs_section] / sizeof(int32_t);
+    if (offsets[0] != 0)
+        return false;
+
+    for (uint32_t i = 0; i < header->n_rules; i++)
+    {
+        if (offsets[i + 1] < offsets[i] || (uint64_t)offsets[i + 1] > n_rhs)
+            return false;
+    }
+
+    for (int32_t i = 0; i < offsets[header->n_rules]; i++)
+    {
+        if (rhs[i] < 0 || (uint64_t)rhs[i] >= header->n_symbols)
+            return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,81 @@
+#ifndef COMPILED_H
+#define COMPILED_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "file_util.h"
+#include "parser.h"
+
+// Binary image of a built parser. All sections are addressed by offsets
+// from the start of the image, so a mapped image is used in place.
+#define COMPILED_MAGIC "LL1PARSE"
+#define COMPILED_VERSION 1
+#define COMPILED_BYTE_ORDER 0x01020304u
+
+typedef enum
+{
+    SECTION_SYMBOL_TYPES,
+    SECTION_SYMBOL_NAME_OFFSETS,
+    SECTION_SYMBOL_NAMES,
+    SECTION_RULE_LHS,
+    SECTION_RULE_RHS_OFFSETS,
+    SECTION_RULE_RHS,
+    SECTION_NULLABLE_RULES,
+    SECTION_NULLABLE_SYMBOLS,
+    SECTION_RULE_FIRST_SETS,
+    SECTION_SYMBOL_FIRST_SETS,
+    SECTION_SYMBOL_FOLLOW_SETS,
+    SECTION_TERMINAL_SYMBOLS,
+    SECTION_SYMBOL_ORDINALS,
+    SECTION_DRIVER_RHS_OFFSETS,
+    SECTION_DRIVER_RHS,
+    SECTION_TABLE,
+    SECTION_TERMINAL_ENTRIES,
+    SECTION_TERMINAL_KEYS,
+    N_SECTIONS
+} compiled_section;
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t size;
+
+    // FNV-1a of everything after the header
+    uint64_t checksum;
+
+    uint32_t n_symbols;
+    uint32_t n_rules;
+    uint32_t n_terminals;
+    uint32_t n_nonterminals;
+    uint32_t set_words;
+    int32_t start_symbol;
+    int32_t end_symbol;
+    int32_t empty_symbol;
+    uint32_t max_terminal_length;
+    uint32_t terminal_capacity;
+    uint32_t terminal_count;
+    uint32_t terminal_keys_size;
+
+    uint64_t section_offsets[N_SECTIONS];
+    uint64_t section_sizes[N_SECTIONS];
+} compiled_header;
+
+typedef struct
+{
+    mapped_file file;
+    const compiled_header *header;
+
+    // Points into the mapped image, parser.grammar is NULL
+    parser parser;
+} compiled_parser;
+
+bool write_compiled_parser(const parser *parser, FILE *file);
+bool load_compiled_parser(compiled_parser *compiled, FILE *file, bool verify);
+void unload_compiled_parser(compiled_parser *compiled);
+
+const char *get_compiled_symbol_name(const compiled_parser *compiled, int symbol);
+const void *get_compiled_section(const compiled_parser *compiled, compiled_section section);
+
+#endif
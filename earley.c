@@ -0,0 +1,343 @@
+#include "earley.h"
+#include <string.h>
+
+#define START_SLOT_CAPACITY 256
+
+static void begin_set(earley_recognizer *recognizer);
+static bool add_item(earley_recognizer *recognizer, size_t position, int rule, int dot, uint32_t origin);
+static earley_slot *find_slot(const earley_recognizer *recognizer, size_t position, int rule, int dot,
+                              uint32_t origin);
+static void grow_slots(earley_recognizer *recognizer, size_t position);
+static int rule_length(const parser *parser, int rule);
+static int next_symbol(const parser *parser, const earley_item *item);
+static void predict(earley_recognizer *recognizer, const earley_item *item, int symbol, size_t position, int token);
+static void complete(earley_recognizer *recognizer, const earley_item *item, size_t position);
+static const leo_item *find_leo_item(const earley_recognizer *recognizer, size_t position, int symbol);
+static void add_leo_items(earley_recognizer *recognizer, size_t position);
+
+void init_earley_recognizer(earley_recognizer *recognizer, const parser *parser)
+{
+    const grammar *grammar = parser->grammar;
+    size_t n_symbols = grammar->symbols.count;
+    size_t n_rules = grammar->rules.count;
+    recognizer->parser = parser;
+    recognizer->start_rule = -1;
+    recognizer->rule_lhs = malloc(n_rules * sizeof(int));
+    recognizer->lhs_offsets = calloc(n_symbols + 1, sizeof(int));
+    recognizer->lhs_rules = malloc(n_rules * sizeof(int));
+
+    // Rules are bucketed by lhs with a counting pass
+    for (size_t i = 0; i < n_rules; i++)
+    {
+        const rule *rule = get_list_element(&grammar->rules, i);
+        recognizer->rule_lhs[rule->id] = rule->lhs->id;
+        recognizer->lhs_offsets[rule->lhs->id + 1]++;
+        if (rule->lhs->id == parser->start_symbol)
+            recognizer->start_rule = rule->id;
+    }
+
+    for (size_t i = 0; i < n_symbols; i++)
+        recognizer->lhs_offsets[i + 1] += recognizer->lhs_offsets[i];
+
+    int *fill = malloc(n_symbols * sizeof(int));
+    memcpy(fill, recognizer->lhs_offsets, n_symbols * sizeof(int));
+    for (size_t i = 0; i < n_rules; i++)
+        recognizer->lhs_rules[fill[recognizer->rule_lhs[i]]++] = i;
+    free(fill);
+
+    init_list(&recognizer->items, 64, sizeof(earley_item));
+    init_list(&recognizer->set_offsets, 64, sizeof(size_t));
+    init_list(&recognizer->scanned, 16, sizeof(earley_item));
+    init_list(&recognizer->leo_items, 16, sizeof(leo_item));
+    init_list(&recognizer->leo_offsets, 64, sizeof(size_t));
+    recognizer->slot_capacity = START_SLOT_CAPACITY;
+    recognizer->slots = calloc(recognizer->slot_capacity, sizeof(earley_slot));
+
+    recognizer->predicted = calloc(n_symbols, sizeof(uint32_t));
+    recognizer->waiting_stamps = calloc(n_symbols, sizeof(uint32_t));
+    recognizer->waiting_counts = calloc(n_symbols, sizeof(uint32_t));
+    recognizer->waiting_items = calloc(n_symbols, sizeof(uint32_t));
+    init_list(&recognizer->waiting_symbols, 16, sizeof(int));
+    recognizer->n_leo_completions = 0;
+}
+
+bool earley_recognize(earley_recognizer *recognizer, const int *tokens, size_t n_tokens)
+{
+    const parser *parser = recognizer->parser;
+    recognizer->items.count = 0;
+    recognizer->set_offsets.count = 0;
+    recognizer->leo_items.count = 0;
+    recognizer->leo_offsets.count = 0;
+    recognizer->n_leo_completions = 0;
+
+    // Stamps are only unique within one run
+    size_t n_symbols = parser->n_terminals + parser->n_nonterminals;
+    memset(recognizer->predicted, 0, n_symbols * sizeof(uint32_t));
+    memset(recognizer->waiting_stamps, 0, n_symbols * sizeof(uint32_t));
+    memset(recognizer->slots, 0, recognizer->slot_capacity * sizeof(earley_slot));
+
+    begin_set(recognizer);
+    add_item(recognizer, 0, recognizer->start_rule, 0, 0);
+
+    // The end symbol is matched as the token after the last one
+    for (size_t position = 0; position <= n_tokens; position++)
+    {
+        int token = position < n_tokens ? tokens[position] : parser->end_symbol;
+        size_t begin = *(size_t *)get_list_element(&recognizer->set_offsets, position);
+
+        // The set grows while it is processed, predictions and completions
+        // are appended to it
+        for (size_t i = begin; i < recognizer->items.count; i++)
+        {
+            earley_item item = *(earley_item *)get_list_element(&recognizer->items, i);
+            int symbol = next_symbol(parser, &item);
+            if (symbol < 0)
+            {
+                complete(recognizer, &item, position);
+            }
+            else if (parser->terminal_symbols[symbol])
+            {
+                if (symbol == token)
+                {
+                    earley_item *scanned = push_back(&recognizer->scanned);
+                    *scanned = item;
+                    scanned->dot++;
+                }
+            }
+            else
+            {
+                predict(recognizer, &item, symbol, position, token);
+            }
+        }
+
+        add_leo_items(recognizer, position);
+
+        begin_set(recognizer);
+        const earley_item *scanned = recognizer->scanned.head;
+        for (size_t i = 0; i < recognizer->scanned.count; i++)
+            add_item(recognizer, position + 1, scanned[i].rule, scanned[i].dot, scanned[i].origin);
+        recognizer->scanned.count = 0;
+
+        if (*(size_t *)peek_back(&recognizer->set_offsets) == recognizer->items.count)
+            return false;
+    }
+
+    // Matching the end symbol completes the start rule
+    return find_slot(recognizer, n_tokens + 1, recognizer->start_rule, rule_length(parser, recognizer->start_rule),
+                     0)->stamp == n_tokens + 2;
+}
+
+bool earley_recognize_span(earley_recognizer *recognizer, parse_context *context, const char *str, size_t length)
+{
+    context->tokens.count = 0;
+    return tokenize_span(recognizer->parser, str, length, &context->tokens) &&
+           earley_recognize(recognizer, context->tokens.head, context->tokens.count);
+}
+
+void begin_set(earley_recognizer *recognizer)
+{
+    *(size_t *)push_back(&recognizer->set_offsets) = recognizer->items.count;
+    *(size_t *)push_back(&recognizer->leo_offsets) = recognizer->leo_items.count;
+}
+
+// Adds an item to the set at position unless it is there already
+bool add_item(earley_recognizer *recognizer, size_t position, int rule, int dot, uint32_t origin)
+{
+    size_t begin = *(size_t *)get_list_element(&recognizer->set_offsets, position);
+    if ((recognizer->items.count - begin + 1) * 2 > recognizer->slot_capacity)
+        grow_slots(recognizer, position);
+
+    earley_slot *slot = find_slot(recognizer, position, rule, dot, origin);
+    if (slot->stamp == position + 1)
+        return false;
+
+    slot->stamp = position + 1;
+    slot->item = recognizer->items.count;
+    earley_item *item = push_back(&recognizer->items);
+    item->rule = rule;
+    item->dot = dot;
+    item->origin = origin;
+    return true;
+}
+
+// Returns the slot of the item in the set at position, or the free slot it
+// would go in
+earley_slot *find_slot(const earley_recognizer *recognizer, size_t position, int rule, int dot, uint32_t origin)
+{
+    uint32_t hash = (uint32_t)rule * 0x9E3779B1u ^ (uint32_t)dot * 0x85EBCA77u ^ origin * 0xC2B2AE3Du;
+    hash ^= hash >> 15;
+    size_t mask = recognizer->slot_capacity - 1;
+    const earley_item *items = recognizer->items.head;
+    for (size_t index = hash & mask;; index = (index + 1) & mask)
+    {
+        earley_slot *slot = recognizer->slots + index;
+        if (slot->stamp != position + 1)
+            return slot;
+
+        const earley_item *item = items + slot->item;
+        if (item->rule == rule && item->dot == dot && item->origin == origin)
+            return slot;
+    }
+}
+
+void grow_slots(earley_recognizer *recognizer, size_t position)
+{
+    free(recognizer->slots);
+    recognizer->slot_capacity *= 2;
+    recognizer->slots = calloc(recognizer->slot_capacity, sizeof(earley_slot));
+
+    size_t begin = *(size_t *)get_list_element(&recognizer->set_offsets, position);
+    const earley_item *items = recognizer->items.head;
+    for (size_t i = begin; i < recognizer->items.count; i++)
+    {
+        earley_slot *slot = find_slot(recognizer, position, items[i].rule, items[i].dot, items[i].origin);
+        slot->stamp = position + 1;
+        slot->item = i;
+    }
+}
+
+int rule_length(const parser *parser, int rule)
+{
+    return parser->rhs_offsets[rule + 1] - parser->rhs_offsets[rule];
+}
+
+// Symbol after the dot, -1 if the item is complete. The driver stores rhs
+// symbols reversed.
+int next_symbol(const parser *parser, const earley_item *item)
+{
+    int length = rule_length(parser, item->rule);
+    if (item->dot == length)
+        return -1;
+
+    return parser->rhs_symbols[parser->rhs_offsets[item->rule] + length - 1 - item->dot];
+}
+
+void predict(earley_recognizer *recognizer, const earley_item *item, int symbol, size_t position, int token)
+{
+    const parser *parser = recognizer->parser;
+    if (recognizer->predicted[symbol] != position + 1)
+    {
+        recognizer->predicted[symbol] = position + 1;
+        for (int i = recognizer->lhs_offsets[symbol]; i < recognizer->lhs_offsets[symbol + 1]; i++)
+        {
+            int rule = recognizer->lhs_rules[i];
+            if (bitset_test(get_rule_first_set(parser, rule), token))
+                add_item(recognizer, position, rule, 0, position);
+        }
+    }
+
+    // Rules that only derive the empty string are never predicted, the
+    // item steps over the nonterminal instead
+    if (bitset_test(parser->nullable_symbols, symbol))
+        add_item(recognizer, position, item->rule, item->dot + 1, item->origin);
+}
+
+void complete(earley_recognizer *recognizer, const earley_item *item, size_t position)
+{
+    // An empty completion comes from a nullable nonterminal, which the items
+    // waiting on it have stepped over already
+    if (item->origin == position)
+        return;
+
+    int symbol = recognizer->rule_lhs[item->rule];
+    const leo_item *leo = find_leo_item(recognizer, item->origin, symbol);
+    if (leo)
+    {
+        recognizer->n_leo_completions++;
+        add_item(recognizer, position, leo->top.rule, leo->top.dot, leo->top.origin);
+        return;
+    }
+
+    size_t begin = *(size_t *)get_list_element(&recognizer->set_offsets, item->origin);
+    size_t end = *(size_t *)get_list_element(&recognizer->set_offsets, item->origin + 1);
+    for (size_t i = begin; i < end; i++)
+    {
+        earley_item waiting = *(earley_item *)get_list_element(&recognizer->items, i);
+        if (next_symbol(recognizer->parser, &waiting) == symbol)
+            add_item(recognizer, position, waiting.rule, waiting.dot + 1, waiting.origin);
+    }
+}
+
+const leo_item *find_leo_item(const earley_recognizer *recognizer, size_t position, int symbol)
+{
+    size_t begin = *(size_t *)get_list_element(&recognizer->leo_offsets, position);
+    size_t end = position + 1 < recognizer->leo_offsets.count
+                     ? *(size_t *)get_list_element(&recognizer->leo_offsets, position + 1)
+                     : recognizer->leo_items.count;
+    const leo_item *leo_items = recognizer->leo_items.head;
+    for (size_t i = begin; i < end; i++)
+    {
+        if (leo_items[i].symbol == symbol)
+            return leo_items + i;
+    }
+
+    return NULL;
+}
+
+// Finds the nonterminals that exactly one item of the finished set at
+// position waits on, as the last symbol of its rule
+void add_leo_items(earley_recognizer *recognizer, size_t position)
+{
+    const parser *parser = recognizer->parser;
+    size_t begin = *(size_t *)get_list_element(&recognizer->set_offsets, position);
+    const earley_item *items = recognizer->items.head;
+    uint32_t stamp = position + 1;
+    recognizer->waiting_symbols.count = 0;
+    for (size_t i = begin; i < recognizer->items.count; i++)
+    {
+        int symbol = next_symbol(parser, items + i);
+        if (symbol < 0 || parser->terminal_symbols[symbol])
+            continue;
+
+        if (recognizer->waiting_stamps[symbol] != stamp)
+        {
+            recognizer->waiting_stamps[symbol] = stamp;
+            recognizer->waiting_counts[symbol] = 0;
+            *(int *)push_back(&recognizer->waiting_symbols) = symbol;
+        }
+
+        recognizer->waiting_counts[symbol]++;
+        recognizer->waiting_items[symbol] = i;
+    }
+
+    const int *symbols = recognizer->waiting_symbols.head;
+    for (size_t i = 0; i < recognizer->waiting_symbols.count; i++)
+    {
+        int symbol = symbols[i];
+        earley_item waiting = items[recognizer->waiting_items[symbol]];
+        if (recognizer->waiting_counts[symbol] != 1 || waiting.dot + 1 != rule_length(parser, waiting.rule))
+            continue;
+
+        // The chain goes on through the set the waiting rule started in
+        earley_item top = waiting;
+        top.dot++;
+        if (waiting.origin < position)
+        {
+            const leo_item *below = find_leo_item(recognizer, waiting.origin, recognizer->rule_lhs[waiting.rule]);
+            if (below)
+                top = below->top;
+        }
+
+        leo_item *leo = push_back(&recognizer->leo_items);
+        leo->symbol = symbol;
+        leo->top = top;
+    }
+}
+
+void clear_earley_recognizer(earley_recognizer *recognizer)
+{
+    free(recognizer->rule_lhs);
+    free(recognizer->lhs_offsets);
+    free(recognizer->lhs_rules);
+    clear_list(&recognizer->items);
+    clear_list(&recognizer->set_offsets);
+    clear_list(&recognizer->scanned);
+    clear_list(&recognizer->leo_items);
+    clear_list(&recognizer->leo_offsets);
+    free(recognizer->slots);
+    free(recognizer->predicted);
+    free(recognizer->waiting_stamps);
+    free(recognizer->waiting_counts);
+    free(recognizer->waiting_items);
+    clear_list(&recognizer->waiting_symbols);
+}
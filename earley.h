@@ -0,0 +1,73 @@
+#ifndef EARLEY_H
+#define EARLEY_H
+
+#include "parser.h"
+
+// Rule with the dot after dot rhs symbols, started at token origin. Rules
+// are read from the driver arrays, so empty symbols are not counted.
+typedef struct
+{
+    int rule;
+    int dot;
+    uint32_t origin;
+} earley_item;
+
+// Leo's transitive item: completing symbol in the set it is stored for ends
+// in completing top, through a chain of right recursive rules that each had
+// the only item waiting on the symbol before it
+typedef struct
+{
+    int symbol;
+    earley_item top;
+} leo_item;
+
+typedef struct
+{
+    uint32_t stamp;
+    uint32_t item;
+} earley_slot;
+
+// Earley recognizer for grammars the table can not drive. Nullable
+// nonterminals are stepped over when they are predicted (Aycock and
+// Horspool), rules are only predicted when their first set has the next
+// token, and right recursion completes through Leo items. Each set then
+// stays small where the grammar is LL(1), so those inputs take linear time.
+// Needs a parser built from a grammar.
+typedef struct
+{
+    const parser *parser;
+    int start_rule;
+    int *rule_lhs;
+    // Rules of each nonterminal, indexed by symbol id
+    int *lhs_offsets;
+    int *lhs_rules;
+
+    // Set i is items[set_offsets[i], set_offsets[i + 1])
+    list items;
+    list set_offsets;
+    list scanned;
+    list leo_items;
+    list leo_offsets;
+
+    // Index of the set being built, slots are in use when their stamp is
+    // the set number plus one
+    earley_slot *slots;
+    size_t slot_capacity;
+
+    // Per symbol stamps, also set number plus one
+    uint32_t *predicted;
+    uint32_t *waiting_stamps;
+    uint32_t *waiting_counts;
+    uint32_t *waiting_items;
+    list waiting_symbols;
+
+    size_t n_leo_completions;
+} earley_recognizer;
+
+void init_earley_recognizer(earley_recognizer *recognizer, const parser *parser);
+bool earley_recognize(earley_recognizer *recognizer, const int *tokens, size_t n_tokens);
+// Counterpart of validate_span, the tokens go in the context's token list
+bool earley_recognize_span(earley_recognizer *recognizer, parse_context *context, const char *str, size_t length);
+void clear_earley_recognizer(earley_recognizer *recognizer);
+
+#endif
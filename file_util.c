@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 long file_size(FILE *file)
 {
@@ -22,7 +24,7 @@ char *read_file(FILE *file)
 
     char *buffer = malloc(sizeof(char) * (size + 1));
     size_t n_read = fread(buffer, sizeof(char), size, file);
-    if (ferror(stdin))
+    if (ferror(file))
     {
         free(buffer);
         return NULL;
@@ -31,3 +33,41 @@ char *read_file(FILE *file)
     buffer[n_read++] = '\0';
     return buffer;
 }
+
+bool map_file(FILE *file, mapped_file *mapped)
+{
+    // Only regular files can be mapped, pipes and terminals have to be read
+    struct stat file_stat;
+    if (fstat(fileno(file), &file_stat) != 0 || !S_ISREG(file_stat.st_mode))
+    {
+        return false;
+    }
+
+    mapped->size = file_stat.st_size;
+    if (mapped->size == 0)
+    {
+        mapped->data = "";
+        return true;
+    }
+
+    void *data = mmap(NULL, mapped->size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    madvise(data, mapped->size, MADV_SEQUENTIAL);
+    mapped->data = data;
+    return true;
+}
+
+void unmap_file(mapped_file *mapped)
+{
+    if (mapped->size > 0)
+    {
+        munmap((void *)mapped->data, mapped->size);
+    }
+
+    mapped->data = NULL;
+    mapped->size = 0;
+}
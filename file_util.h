@@ -1,9 +1,20 @@
 #ifndef FILE_UTIL_H
 #define FILE_UTIL_H
 
+#include <stdbool.h>
 #include <stdio.h>
 
+// Read only view of a whole file, backed by the page cache
+typedef struct
+{
+    const char *data;
+    size_t size;
+} mapped_file;
+
 long file_size(FILE *file);
 char *read_file(FILE *file);
 
+bool map_file(FILE *file, mapped_file *mapped);
+void unmap_file(mapped_file *mapped);
+
 #endif
@@ -3,7 +3,9 @@
 #include <stdlib.h>
 #include <string.h>
 
-static bool is_reserved_symbol(const char *sym_name);
+static void relocate_symbol_refs(grammar *grammar, const symbol *old_head);
+static int *find_symbol_slot(const grammar *grammar, const char *name, size_t length, uint32_t hash);
+static void grow_symbol_index(grammar *grammar);
 
 void init_rule(rule *rule, symbol *lhs, int id)
 {
@@ -23,42 +25,86 @@ void clear_rule(rule *rule)
     clear_list(&rule->rhs);
 }
 
-void init_symbol(symbol *symbol, char *name, int id)
+void init_symbol(symbol *symbol, size_t name_offset, size_t name_length, uint32_t name_hash, int id)
 {
-    symbol->name = name;
+    symbol->name_offset = name_offset;
+    symbol->name_length = name_length;
+    symbol->name_hash = name_hash;
     symbol->type = UNKNOWN;
     symbol->id = id;
 }
 
-void clear_symbol(symbol *symbol)
+bool is_empty_symbol(const grammar *grammar, const symbol *symbol)
 {
-    free(symbol->name);
+    return symbol->name_length == 1 && symbol_name(grammar, symbol)[0] == '"';
 }
 
-bool is_empty_symbol(const symbol *symbol)
+bool is_end_symbol(const grammar *grammar, const symbol *symbol)
 {
-    return strcmp(symbol->name, "\"") == 0;
+    return symbol->name_length == 1 && symbol_name(grammar, symbol)[0] == '$';
 }
 
-bool is_end_symbol(const symbol *symbol)
+const char *symbol_name(const grammar *grammar, const symbol *symbol)
 {
-    return strcmp(symbol->name, "$") == 0;
+    return arena_at(&grammar->names, symbol->name_offset);
 }
 
 void init_grammar(grammar *grammar, size_t start_size)
 {
     init_list(&grammar->symbols, start_size, sizeof(symbol));
     init_list(&grammar->rules, start_size, sizeof(rule));
+    init_arena(&grammar->names, start_size * 8);
+
+    // A power of two so probing can mask instead of divide
+    grammar->n_symbol_slots = 8;
+    while (grammar->n_symbol_slots < start_size * 2)
+        grammar->n_symbol_slots *= 2;
+
+    grammar->symbol_slots = malloc(grammar->n_symbol_slots * sizeof(int));
+    for (size_t i = 0; i < grammar->n_symbol_slots; i++)
+        grammar->symbol_slots[i] = NO_SYMBOL;
 }
 
-symbol *add_new_symbol(grammar *grammar, char *name)
+symbol *add_new_symbol(grammar *grammar, const char *name, size_t length)
 {
     int id = grammar->symbols.count;
+    const symbol *old_head = grammar->symbols.head;
     symbol *new_symbol = new_list_element(&grammar->symbols);
-    init_symbol(new_symbol, name, id);
+    if (old_head && grammar->symbols.head != old_head)
+    {
+        relocate_symbol_refs(grammar, old_head);
+    }
+
+    size_t name_offset = arena_alloc(&grammar->names, length + 1, 1);
+    char *interned = arena_at(&grammar->names, name_offset);
+    memcpy(interned, name, length);
+    interned[length] = '\0';
+
+    uint32_t hash = hash_string(name, length);
+    init_symbol(new_symbol, name_offset, length, hash, id);
+    if (grammar->symbols.count * 4 > grammar->n_symbol_slots * 3)
+        grow_symbol_index(grammar);
+
+    *find_symbol_slot(grammar, name, length, hash) = id;
     return new_symbol;
 }
 
+void relocate_symbol_refs(grammar *grammar, const symbol *old_head)
+{
+    // Rules point into the symbol list, so they have to follow it when it grows
+    symbol *new_head = grammar->symbols.head;
+    for (size_t i = 0; i < grammar->rules.count; i++)
+    {
+        rule *rule = get_list_element(&grammar->rules, i);
+        rule->lhs = new_head + (rule->lhs - old_head);
+        for (size_t j = 0; j < rule->rhs.count; j++)
+        {
+            symbol **rhs_symbol = get_list_element(&rule->rhs, j);
+            *rhs_symbol = new_head + (*rhs_symbol - old_head);
+        }
+    }
+}
+
 rule *add_new_rule(grammar *grammar, symbol *lhs)
 {
     int id = grammar->rules.count;
@@ -69,25 +115,62 @@ rule *add_new_rule(grammar *grammar, symbol *lhs)
 
 symbol *find_symbol(const grammar *grammar, const char *name)
 {
-    for (size_t i = 0; i < grammar->symbols.count; i++)
+    return find_symbol_span(grammar, name, strlen(name));
+}
+
+symbol *find_symbol_span(const grammar *grammar, const char *name, size_t length)
+{
+    int id = *find_symbol_slot(grammar, name, length, hash_string(name, length));
+    return id == NO_SYMBOL ? NULL : get_list_element(&grammar->symbols, id);
+}
+
+// Slot of the symbol with the name, or the empty slot it would take. The
+// probing is hash_table's, but a hash_table would keep its own copy of
+// every name, these slots only hold ids into the symbol list.
+int *find_symbol_slot(const grammar *grammar, const char *name, size_t length, uint32_t hash)
+{
+    size_t mask = grammar->n_symbol_slots - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
     {
-        symbol *symbol = get_list_element(&grammar->symbols, i);
-        if (strcmp(symbol->name, name) == 0)
-            return symbol;
+        int *slot = &grammar->symbol_slots[i];
+        if (*slot == NO_SYMBOL)
+            return slot;
+
+        const symbol *candidate = get_list_element(&grammar->symbols, *slot);
+        if (candidate->name_hash == hash && candidate->name_length == length &&
+            memcmp(symbol_name(grammar, candidate), name, length) == 0)
+            return slot;
     }
-
-    return NULL;
 }
 
-void clear_grammar(grammar *grammar)
+void grow_symbol_index(grammar *grammar)
 {
-    for (size_t i = 0; i < grammar->symbols.count; i++)
+    free(grammar->symbol_slots);
+    grammar->n_symbol_slots *= 2;
+    grammar->symbol_slots = malloc(grammar->n_symbol_slots * sizeof(int));
+    for (size_t i = 0; i < grammar->n_symbol_slots; i++)
+        grammar->symbol_slots[i] = NO_SYMBOL;
+
+    // Names are distinct, so each symbol takes the first empty slot
+    size_t mask = grammar->n_symbol_slots - 1;
+    for (size_t id = 0; id < grammar->symbols.count; id++)
     {
-        symbol *symbol = get_list_element(&grammar->symbols, i);
-        clear_symbol(symbol);
+        const symbol *indexed = get_list_element(&grammar->symbols, id);
+        size_t i = indexed->name_hash & mask;
+        while (grammar->symbol_slots[i] != NO_SYMBOL)
+            i = (i + 1) & mask;
+
+        grammar->symbol_slots[i] = id;
     }
+}
 
+void clear_grammar(grammar *grammar)
+{
     clear_list(&grammar->symbols);
+    clear_arena(&grammar->names);
+    free(grammar->symbol_slots);
+    grammar->symbol_slots = NULL;
+    grammar->n_symbol_slots = 0;
 
     for (size_t i = 0; i < grammar->rules.count; i++)
     {
@@ -100,110 +183,131 @@ void clear_grammar(grammar *grammar)
 
 bool create_grammar_from_file(grammar *grammar, FILE *file)
 {
+    mapped_file mapped;
+    if (map_file(file, &mapped))
+    {
+        bool success = create_grammar_from_buffer(grammar, mapped.data, mapped.size);
+        unmap_file(&mapped);
+        return success;
+    }
+
+    // Fall back to reading the file when it can not be mapped
     char *input_buffer = read_file(file);
     if (!input_buffer)
     {
         return false;
     }
 
-    // Add artifical starting symbol
-   symbol *artificial_start_symbol = add_new_symbol(grammar, strdup("S"));
+    bool success = create_grammar_from_buffer(grammar, input_buffer, strlen(input_buffer));
+    free(input_buffer);
+    return success;
+}
 
-   bool has_start_symbol = false;
+bool create_grammar_from_buffer(grammar *grammar, const char *buffer, size_t size)
+{
+    // Names are at most as long as the text they come from, so the name
+    // arena is sized once up front
+    if (grammar->names.capacity < grammar->names.size + size + 4)
+        grow_arena(&grammar->names, grammar->names.size + size + 4);
 
-    char *newline_split = input_buffer;
-    char *save1 = NULL;
-    strtok_r(newline_split, "\n", &save1);
-    while (newline_split)
+    // Add artifical starting symbol
+    add_new_symbol(grammar, "S", 1);
+
+    // One pass over the buffer, each name is looked up once as it is read
+    const char *end = buffer + size;
+    const char *line = buffer;
+    size_t space_split_counter = 0;
+    rule *current_rule = NULL;
+    for (const char *c = buffer;;)
     {
-        char *line_copy = strdup(newline_split);
-        char *space_split = line_copy;
-        char *save2 = NULL;
-        size_t space_split_counter = 0;
-        space_split = strtok_r(space_split, " ", &save2);
-
-        symbol *lhs_symbol = NULL;
-        rule *rule = NULL;
-        while (space_split)
+        if (c == end || *c == '\n')
         {
-            space_split_counter++;
-            if (space_split_counter == 1)
+            // Empty lines are skipped, other lines need a full rule
+            if (c != line && space_split_counter < 3)
             {
-                // Left hand side
+                return false;
+            }
 
-                // Check that name is not reserved
-                if (is_reserved_symbol(space_split))
-                {
-                    free(line_copy);
-                    free(input_buffer);
-                    return false;
-                }
+            if (c == end)
+                break;
 
-                lhs_symbol = find_symbol(grammar, space_split);
+            space_split_counter = 0;
+            line = ++c;
+            continue;
+        }
 
-                if (!lhs_symbol)
-                {
-                    lhs_symbol = add_new_symbol(grammar, strdup(space_split));
-                }
+        if (*c == ' ')
+        {
+            c++;
+            continue;
+        }
 
-                lhs_symbol->type = NONTERMINAL;
-                rule = add_new_rule(grammar, lhs_symbol);
-            }
-            else if (space_split_counter == 2)
+        const char *name = c;
+        while (c < end && *c != ' ' && *c != '\n')
+            c++;
+
+        size_t name_length = c - name;
+        space_split_counter++;
+        if (space_split_counter == 1)
+        {
+            // Left hand side
+
+            // Check that name is not reserved
+            if (is_reserved_symbol(name, name_length))
             {
-                // Definition symbol
-                if (strcmp(space_split, "::=") != 0)
-                {
-                    free(line_copy);
-                    free(input_buffer);
-                    return false;
-                }
+                return false;
             }
-            else
-            {
-                // Right hand side
-                symbol *rhs_symbol = find_symbol(grammar, space_split);
 
-                if (!rhs_symbol)
-                {
-                    rhs_symbol = add_new_symbol(grammar, strdup(space_split));
-                    rhs_symbol->type = TERMINAL;
-                }
+            symbol *lhs_symbol = find_symbol_span(grammar, name, name_length);
 
-                add_production(rule, rhs_symbol);
+            if (!lhs_symbol)
+            {
+                lhs_symbol = add_new_symbol(grammar, name, name_length);
             }
 
-            space_split = strtok_r(NULL, " ", &save2);
+            lhs_symbol->type = NONTERMINAL;
+            current_rule = add_new_rule(grammar, lhs_symbol);
         }
-
-        free(line_copy);
-
-        if (space_split_counter < 3)
+        else if (space_split_counter == 2)
         {
-            free(input_buffer);
-            return false;
+            // Definition symbol
+            if (name_length != 3 || memcmp(name, "::=", 3) != 0)
+            {
+                return false;
+            }
         }
+        else
+        {
+            // Right hand side
+            symbol *rhs_symbol = find_symbol_span(grammar, name, name_length);
+
+            if (!rhs_symbol)
+            {
+                rhs_symbol = add_new_symbol(grammar, name, name_length);
+                rhs_symbol->type = TERMINAL;
+            }
 
-        newline_split = strtok_r(NULL, "\n", &save1);
+            add_production(current_rule, rhs_symbol);
+        }
     }
 
-    free(input_buffer);
+    if (grammar->rules.count == 0)
+    {
+        return false;
+    }
 
     // Add end of input symbol and starting rule
-    symbol *end_symbol = add_new_symbol(grammar, strdup("$"));
+    symbol *end_symbol = add_new_symbol(grammar, "$", 1);
     end_symbol->type = TERMINAL;
 
-    rule *start_rule = add_new_rule(grammar, artificial_start_symbol);
+    rule *start_rule = add_new_rule(grammar, get_list_element(&grammar->symbols, 0));
     add_production(start_rule, get_list_element(&grammar->symbols, 1));
     add_production(start_rule, end_symbol);
 
     return true;
 }
 
-bool is_reserved_symbol(const char *sym_name)
+bool is_reserved_symbol(const char *sym_name, size_t length)
 {
-    return
-        strcmp(sym_name, "S") == 0 ||
-        strcmp(sym_name, "\"") == 0 ||
-        strcmp(sym_name, "$") == 0;
+    return length == 1 && (sym_name[0] == 'S' || sym_name[0] == '"' || sym_name[0] == '$');
 }
@@ -2,7 +2,10 @@
 #define SYMBOL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include "arena.h"
+#include "hash_table.h"
 #include "list.h"
 
 typedef enum
@@ -12,12 +15,18 @@ typedef enum
     NONTERMINAL
 } symbol_type;
 
+#define NO_SYMBOL -1
+
 typedef struct symbol symbol;
 typedef struct rule rule;
 
+// Names are interned in the grammar, each distinct name is stored once, so
+// two symbols have the same name only if their name offsets are equal
 struct symbol
 {
-    char *name;
+    size_t name_offset;
+    uint32_t name_length;
+    uint32_t name_hash;
     symbol_type type;
     int id;
 };
@@ -33,22 +42,32 @@ typedef struct
 {
     list symbols;
     list rules;
+    // Null terminated symbol names, they move while symbols are added
+    arena names;
+    // Open addressing index of symbol ids by name hash, NO_SYMBOL in empty
+    // slots. Names are compared in the arena, so they are stored only once.
+    int *symbol_slots;
+    size_t n_symbol_slots;
 } grammar;
 
 void init_rule(rule *rule, symbol *lhs, int id);
 void add_production(rule *rule, symbol *symbol);
 void clear_rule(rule *rule);
 
-void init_symbol(symbol *symbol, char *name, int id);
-void clear_symbol(symbol *symbol);
-bool is_empty_symbol(const symbol *symbol);
-bool is_end_symbol(const symbol *symbol);
+void init_symbol(symbol *symbol, size_t name_offset, size_t name_length, uint32_t name_hash, int id);
+bool is_empty_symbol(const grammar *grammar, const symbol *symbol);
+bool is_end_symbol(const grammar *grammar, const symbol *symbol);
+// The start, empty and end symbols can not be defined by a rule
+bool is_reserved_symbol(const char *sym_name, size_t length);
+const char *symbol_name(const grammar *grammar, const symbol *symbol);
 
 void init_grammar(grammar *grammar, size_t start_size);
-symbol *add_new_symbol(grammar *grammar, char *name);
+symbol *add_new_symbol(grammar *grammar, const char *name, size_t length);
 rule *add_new_rule(grammar *grammar, symbol *lhs);
 symbol *find_symbol(const grammar *grammar, const char *name);
+symbol *find_symbol_span(const grammar *grammar, const char *name, size_t length);
 void clear_grammar(grammar *table);
 bool create_grammar_from_file(grammar *grammar, FILE *file);
+bool create_grammar_from_buffer(grammar *grammar, const char *buffer, size_t size);
 
 #endif
@@ -0,0 +1,119 @@
+#include "hash_table.h"
+#include <string.h>
+
+static void grow_hash_table(hash_table *table);
+static hash_entry *find_slot(const hash_table *table, const char *key, size_t length, uint32_t hash);
+
+uint32_t hash_string(const char *key, size_t length)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)key[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+void init_hash_table(hash_table *table, size_t start_capacity)
+{
+    // Capacity is kept a power of two so probing can mask instead of divide
+    size_t capacity = 8;
+    while (capacity < start_capacity * 2)
+        capacity *= 2;
+
+    table->entries = malloc(capacity * sizeof(hash_entry));
+    for (size_t i = 0; i < capacity; i++)
+        table->entries[i].value = HASH_TABLE_MISSING;
+
+    table->capacity = capacity;
+    table->count = 0;
+    init_list(&table->keys, 0, sizeof(char));
+}
+
+bool hash_table_insert(hash_table *table, const char *key, size_t length, int value)
+{
+    if ((table->count + 1) * 4 > table->capacity * 3)
+        grow_hash_table(table);
+
+    uint32_t hash = hash_string(key, length);
+    hash_entry *entry = find_slot(table, key, length, hash);
+    if (entry->value != HASH_TABLE_MISSING)
+        return false;
+
+    entry->hash = hash;
+    entry->key_offset = table->keys.count;
+    entry->key_length = length;
+    entry->value = value;
+    table->count++;
+
+    // Keys are null terminated so they can be used as C strings
+    push_back_many(&table->keys, key, length);
+    *(char *)push_back(&table->keys) = '\0';
+
+    return true;
+}
+
+int hash_table_find(const hash_table *table, const char *key, size_t length)
+{
+    return hash_table_find_hashed(table, key, length, hash_string(key, length));
+}
+
+int hash_table_find_hashed(const hash_table *table, const char *key, size_t length, uint32_t hash)
+{
+    return find_slot(table, key, length, hash)->value;
+}
+
+void clear_hash_table(hash_table *table)
+{
+    free(table->entries);
+    clear_list(&table->keys);
+
+    table->entries = NULL;
+    table->capacity = 0;
+    table->count = 0;
+}
+
+hash_entry *find_slot(const hash_table *table, const char *key, size_t length, uint32_t hash)
+{
+    size_t mask = table->capacity - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        hash_entry *entry = table->entries + i;
+        if (entry->value == HASH_TABLE_MISSING)
+            return entry;
+
+        if (entry->hash == hash && entry->key_length == length &&
+            memcmp(get_list_element(&table->keys, entry->key_offset), key, length) == 0)
+            return entry;
+    }
+}
+
+void grow_hash_table(hash_table *table)
+{
+    hash_entry *old_entries = table->entries;
+    size_t old_capacity = table->capacity;
+
+    table->capacity *= 2;
+    table->entries = malloc(table->capacity * sizeof(hash_entry));
+    for (size_t i = 0; i < table->capacity; i++)
+        table->entries[i].value = HASH_TABLE_MISSING;
+
+    size_t mask = table->capacity - 1;
+    for (size_t i = 0; i < old_capacity; i++)
+    {
+        hash_entry *old_entry = old_entries + i;
+        if (old_entry->value == HASH_TABLE_MISSING)
+            continue;
+
+        size_t slot = old_entry->hash & mask;
+        while (table->entries[slot].value != HASH_TABLE_MISSING)
+            slot = (slot + 1) & mask;
+
+        table->entries[slot] = *old_entry;
+    }
+
+    free(old_entries);
+}
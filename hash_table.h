@@ -0,0 +1,37 @@
+#ifndef HASH_TABLE_H
+#define HASH_TABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "list.h"
+
+// Open addressing string -> int map. Keys are copied into a single key
+// pool and entries refer to them by offset, so the table holds no pointers
+// besides the entry array and the pool.
+typedef struct
+{
+    uint32_t hash;
+    uint32_t key_offset;
+    uint32_t key_length;
+    int value;
+} hash_entry;
+
+typedef struct
+{
+    hash_entry *entries;
+    size_t capacity;
+    size_t count;
+    list keys;
+} hash_table;
+
+#define HASH_TABLE_MISSING -1
+
+uint32_t hash_string(const char *key, size_t length);
+
+void init_hash_table(hash_table *table, size_t start_capacity);
+bool hash_table_insert(hash_table *table, const char *key, size_t length, int value);
+int hash_table_find(const hash_table *table, const char *key, size_t length);
+int hash_table_find_hashed(const hash_table *table, const char *key, size_t length, uint32_t hash);
+void clear_hash_table(hash_table *table);
+
+#endif
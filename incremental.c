@@ -0,0 +1,316 @@
+#include "incremental.h"
+#include <string.h>
+
+#define START_SLOT_CAPACITY 1024
+
+static void reparse_session(parse_session *session);
+static void reset_session_nodes(parse_session *session, size_t n_nodes);
+static int intern_node(parse_session *session, int symbol, int next);
+static int add_node(parse_session *session, int symbol, int next);
+static inline uint32_t hash_node(int symbol, int next);
+static int *find_node_slot(const parse_session *session, int symbol, int next);
+static int *find_free_slot(const parse_session *session, int symbol, int next);
+static void grow_node_slots(parse_session *session);
+static int advance_state(parse_session *session, int state, int token);
+static bool is_accepting_state(parse_session *session, int state);
+static void splice_ints(list *list, size_t start, size_t n_removed, const int *inserted, size_t n_inserted);
+
+void init_parse_session(parse_session *session, const parser *parser)
+{
+    session->parser = parser;
+    init_list(&session->tokens, 16, sizeof(int));
+    init_list(&session->states, 16, sizeof(int));
+    init_list(&session->nodes, 16, sizeof(stack_node));
+    session->slot_capacity = START_SLOT_CAPACITY;
+    session->node_slots = malloc(session->slot_capacity * sizeof(int));
+    session->n_rebuilds = 0;
+
+    reparse_session(session);
+}
+
+bool set_session_tokens(parse_session *session, const int *tokens, size_t n_tokens)
+{
+    session->tokens.count = 0;
+    push_back_many(&session->tokens, tokens, n_tokens);
+    reparse_session(session);
+    return session->valid;
+}
+
+void reparse_session(parse_session *session)
+{
+    const int *tokens = session->tokens.head;
+    size_t n_tokens = session->tokens.count;
+
+    // A parse makes a node or two per token, so the pool and its index are
+    // sized for that up front rather than regrown through the parse
+    reset_session_nodes(session, 2 * (n_tokens + 1));
+    reserve_list(&session->states, n_tokens + 1);
+    session->states.count = n_tokens + 1;
+    int *states = session->states.head;
+
+    session->n_states = n_tokens + 1;
+    int state = intern_node(session, session->parser->start_symbol, SESSION_EMPTY_STACK);
+    for (size_t i = 0; i < n_tokens && state != SESSION_FAILED; i++)
+    {
+        states[i] = state;
+        state = advance_state(session, state, tokens[i]);
+        if (state == SESSION_FAILED)
+            session->n_states = i + 1;
+    }
+
+    if (state != SESSION_FAILED)
+        states[n_tokens] = state;
+    session->valid = state != SESSION_FAILED && is_accepting_state(session, state);
+    session->n_reparsed = session->n_states - 1;
+
+    session->tail_begin = 0;
+    session->tail_end = session->n_states;
+    session->tail_valid = session->valid;
+}
+
+bool edit_session_tokens(parse_session *session, size_t start, size_t n_removed, const int *inserted,
+                         size_t n_inserted)
+{
+    size_t n_old_tokens = session->tokens.count;
+    if (start > n_old_tokens)
+        start = n_old_tokens;
+    if (n_removed > n_old_tokens - start)
+        n_removed = n_old_tokens - start;
+
+    // States are spliced like the tokens, so a state after the edit still
+    // lines up with the token it was computed for. The one before the first
+    // token after the edit is kept too, its suffix did not change.
+    int state = *(int *)get_list_element(&session->states, start);
+    splice_ints(&session->tokens, start, n_removed, inserted, n_inserted);
+    splice_ints(&session->states, start, n_removed, NULL, n_inserted);
+    session->n_reparsed = 0;
+
+    size_t rejoin = start + n_inserted;
+    if (session->tail_end <= start + n_removed)
+        session->tail_begin = session->tail_end = 0;
+    else
+    {
+        session->tail_begin = session->tail_begin > start + n_removed
+                                  ? session->tail_begin - n_removed + n_inserted
+                                  : rejoin;
+        session->tail_end = session->tail_end - n_removed + n_inserted;
+    }
+
+    // A parse that failed before the edit still fails at the same token
+    if (start >= session->n_states)
+        return false;
+
+    const int *tokens = session->tokens.head;
+    int *states = session->states.head;
+    size_t n_tokens = session->tokens.count;
+    for (size_t i = start;; i++)
+    {
+        // Same stack before the same remaining tokens, so the rest of the
+        // earlier parse still holds
+        if (i >= session->tail_begin && i < session->tail_end && states[i] == state)
+        {
+            session->n_states = session->tail_end;
+            session->valid = session->tail_valid;
+            break;
+        }
+
+        states[i] = state;
+        if (i == n_tokens)
+        {
+            session->n_states = n_tokens + 1;
+            session->valid = is_accepting_state(session, state);
+            break;
+        }
+
+        state = advance_state(session, state, tokens[i]);
+        session->n_reparsed++;
+        if (state == SESSION_FAILED)
+        {
+            session->n_states = i + 1;
+            session->valid = false;
+            break;
+        }
+    }
+
+    // A failed parse keeps what is left of the tail for the edit that fixes
+    // it, otherwise the whole input is known again
+    if (state == SESSION_FAILED)
+    {
+        if (session->tail_begin < session->n_states)
+            session->tail_begin = session->n_states;
+        if (session->tail_begin >= session->tail_end)
+            session->tail_begin = session->tail_end = 0;
+    }
+    else
+    {
+        session->tail_begin = 0;
+        session->tail_end = session->n_states;
+        session->tail_valid = session->valid;
+    }
+
+    // Nodes are never freed one by one, so the pool is rebuilt once most of
+    // it can no longer be reached
+    if (session->nodes.count > 8 * (n_tokens + 1) + START_SLOT_CAPACITY)
+    {
+        reparse_session(session);
+        session->n_rebuilds++;
+    }
+
+    return session->valid;
+}
+
+void reset_session_nodes(parse_session *session, size_t n_nodes)
+{
+    size_t capacity = session->slot_capacity;
+    while (n_nodes * 4 > capacity * 3)
+        capacity *= 2;
+    if (capacity != session->slot_capacity)
+    {
+        free(session->node_slots);
+        session->slot_capacity = capacity;
+        session->node_slots = malloc(session->slot_capacity * sizeof(int));
+    }
+
+    reserve_list(&session->nodes, n_nodes);
+    session->nodes.count = 0;
+    for (size_t i = 0; i < session->slot_capacity; i++)
+        session->node_slots[i] = -1;
+}
+
+int intern_node(parse_session *session, int symbol, int next)
+{
+    int *slot = find_node_slot(session, symbol, next);
+    if (*slot >= 0)
+        return *slot;
+
+    if ((session->nodes.count + 1) * 4 > session->slot_capacity * 3)
+    {
+        grow_node_slots(session);
+        slot = find_free_slot(session, symbol, next);
+    }
+
+    stack_node *node = push_back(&session->nodes);
+    node->symbol = symbol;
+    node->next = next;
+    *slot = session->nodes.count - 1;
+    return *slot;
+}
+
+// Adds a node known not to exist yet, which only needs a free slot
+int add_node(parse_session *session, int symbol, int next)
+{
+    if ((session->nodes.count + 1) * 4 > session->slot_capacity * 3)
+        grow_node_slots(session);
+
+    stack_node *node = push_back(&session->nodes);
+    node->symbol = symbol;
+    node->next = next;
+    int *slot = find_free_slot(session, symbol, next);
+    *slot = session->nodes.count - 1;
+    return *slot;
+}
+
+uint32_t hash_node(int symbol, int next)
+{
+    uint32_t hash = (uint32_t)symbol * 0x9e3779b1u ^ (uint32_t)next * 0x85ebca6bu;
+    return hash ^ hash >> 15;
+}
+
+int *find_node_slot(const parse_session *session, int symbol, int next)
+{
+    const stack_node *nodes = session->nodes.head;
+    size_t mask = session->slot_capacity - 1;
+    for (size_t i = hash_node(symbol, next) & mask;; i = (i + 1) & mask)
+    {
+        int *slot = session->node_slots + i;
+        if (*slot < 0 || (nodes[*slot].symbol == symbol && nodes[*slot].next == next))
+            return slot;
+    }
+}
+
+int *find_free_slot(const parse_session *session, int symbol, int next)
+{
+    size_t mask = session->slot_capacity - 1;
+    for (size_t i = hash_node(symbol, next) & mask;; i = (i + 1) & mask)
+    {
+        if (session->node_slots[i] < 0)
+            return session->node_slots + i;
+    }
+}
+
+void grow_node_slots(parse_session *session)
+{
+    free(session->node_slots);
+    session->slot_capacity *= 2;
+    session->node_slots = malloc(session->slot_capacity * sizeof(int));
+    for (size_t i = 0; i < session->slot_capacity; i++)
+        session->node_slots[i] = -1;
+
+    const stack_node *nodes = session->nodes.head;
+    for (size_t i = 0; i < session->nodes.count; i++)
+        *find_free_slot(session, nodes[i].symbol, nodes[i].next) = i;
+}
+
+int advance_state(parse_session *session, int state, int token)
+{
+    const parser *parser = session->parser;
+
+    // Same steps as parse_token, but popping only moves to the next node and
+    // pushing shares the rest of the stack
+    int node = state;
+    while (node != SESSION_EMPTY_STACK)
+    {
+        stack_node top = *(stack_node *)get_list_element(&session->nodes, node);
+        if (parser->terminal_symbols[top.symbol])
+            return top.symbol == token ? top.next : SESSION_FAILED;
+
+        int rule_index = get_matching_rule(parser, top.symbol, token);
+        if (rule_index < 0)
+            return SESSION_FAILED;
+
+        // Nothing points to a node made by this step yet, so once a push
+        // makes one the pushes above it are new too
+        node = top.next;
+        bool fresh = false;
+        for (int i = parser->rhs_offsets[rule_index]; i < parser->rhs_offsets[rule_index + 1]; i++)
+        {
+            if (fresh)
+                node = add_node(session, parser->rhs_symbols[i], node);
+            else
+            {
+                size_t n_nodes = session->nodes.count;
+                node = intern_node(session, parser->rhs_symbols[i], node);
+                fresh = session->nodes.count > n_nodes;
+            }
+        }
+    }
+
+    return SESSION_FAILED;
+}
+
+bool is_accepting_state(parse_session *session, int state)
+{
+    // Past the last token the input is at the end symbol
+    return advance_state(session, state, session->parser->end_symbol) == SESSION_EMPTY_STACK;
+}
+
+void splice_ints(list *list, size_t start, size_t n_removed, const int *inserted, size_t n_inserted)
+{
+    size_t n_after = list->count - start - n_removed;
+    reserve_list(list, list->count - n_removed + n_inserted);
+
+    int *values = list->head;
+    memmove(values + start + n_inserted, values + start + n_removed, n_after * sizeof(int));
+    if (inserted)
+        memcpy(values + start, inserted, n_inserted * sizeof(int));
+
+    list->count = list->count - n_removed + n_inserted;
+}
+
+void clear_parse_session(parse_session *session)
+{
+    clear_list(&session->tokens);
+    clear_list(&session->states);
+    clear_list(&session->nodes);
+    free(session->node_slots);
+}
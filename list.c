@@ -21,8 +21,7 @@ void *new_list_element(list *list)
 {
     if (list->count == list->size)
     {
-        list->size = (list->size + 1) * 2;
-        list->head = realloc(list->head, list->size * list->elem_byte_size);
+        reserve_list(list, (list->size + 1) * 2);
     }
 
     void *element = get_list_element(list, list->count);
@@ -35,10 +34,19 @@ void *get_list_element(const list *list, size_t index)
     return ((char*)list->head) + index * list->elem_byte_size;
 }
 
+void reserve_list(list *list, size_t size)
+{
+    if (size <= list->size)
+        return;
+
+    list->size = size;
+    list->head = realloc(list->head, list->size * list->elem_byte_size);
+}
+
 void *push_front(list *list)
 {
     new_list_element(list);
-    memcpy((char*)list->head + list->elem_byte_size, list->head, (list->count - 1) * list->elem_byte_size);
+    memmove((char*)list->head + list->elem_byte_size, list->head, (list->count - 1) * list->elem_byte_size);
 
     return get_list_element(list, 0);
 }
@@ -46,7 +54,7 @@ void *push_front(list *list)
 void pop_front(list *list)
 {
     list->count--;
-    memcpy(list->head, (char*)list->head + list->elem_byte_size, list->count * list->elem_byte_size);
+    memmove(list->head, (char*)list->head + list->elem_byte_size, list->count * list->elem_byte_size);
 }
 
 void clear_list(list *list)
@@ -57,3 +65,30 @@ void clear_list(list *list)
     list->count = 0;
     list->size = 0;
 }
+
+void *push_back(list *list)
+{
+    return new_list_element(list);
+}
+
+void push_back_many(list *list, const void *elements, size_t n)
+{
+    if (list->count + n > list->size)
+    {
+        size_t new_size = (list->size + 1) * 2;
+        reserve_list(list, new_size > list->count + n ? new_size : list->count + n);
+    }
+
+    memcpy(get_list_element(list, list->count), elements, n * list->elem_byte_size);
+    list->count += n;
+}
+
+void *peek_back(const list *list)
+{
+    return get_list_element(list, list->count - 1);
+}
+
+void pop_back(list *list)
+{
+    list->count--;
+}
@@ -14,8 +14,15 @@ typedef struct
 void init_list(list *list, size_t start_size, size_t elem_byte_size);
 void *new_list_element(list *list);
 void *get_list_element(const list *list, size_t index);
+void reserve_list(list *list, size_t size);
 void *push_front(list *list);
 void pop_front(list *list);
 void clear_list(list *list);
 
+// Stack operations, the top of the stack is the last element
+void *push_back(list *list);
+void push_back_many(list *list, const void *elements, size_t n);
+void *peek_back(const list *list);
+void pop_back(list *list);
+
 #endif
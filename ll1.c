@@ -0,0 +1,300 @@
+#include "ll1.h"
+#include "cache.h"
+#include "parser.h"
+#include <string.h>
+
+struct ll1_grammar
+{
+    grammar grammar;
+};
+
+struct ll1_parser
+{
+    parser parser;
+};
+
+struct ll1_context
+{
+    parse_context context;
+};
+
+// Cached parsers are handed out as ll1_parser, whose only member is the
+// parser, so the pointers convert both ways
+struct ll1_cache
+{
+    parser_cache cache;
+};
+
+static bool is_input_token(const parser *parser, int token);
+
+const char *ll1_status_string(ll1_status status)
+{
+    switch (status)
+    {
+    case LL1_OK:
+        return "ok";
+    case LL1_REJECTED:
+        return "rejected";
+    case LL1_UNKNOWN_TOKEN:
+        return "unknown token";
+    case LL1_ERROR_ARGUMENT:
+        return "invalid argument";
+    case LL1_ERROR_IO:
+        return "could not open file";
+    case LL1_ERROR_GRAMMAR:
+        return "could not read grammar";
+    case LL1_ERROR_CONFLICT:
+        return "grammar has conflicts";
+    case LL1_ERROR_MEMORY:
+        return "out of memory";
+    }
+
+    return "unknown status";
+}
+
+ll1_status ll1_grammar_load(const char *path, ll1_grammar **grammar)
+{
+    if (!path || !grammar)
+        return LL1_ERROR_ARGUMENT;
+
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return LL1_ERROR_IO;
+
+    ll1_grammar *loaded = malloc(sizeof(ll1_grammar));
+    if (!loaded)
+    {
+        fclose(file);
+        return LL1_ERROR_MEMORY;
+    }
+
+    init_grammar(&loaded->grammar, 16);
+    bool success = create_grammar_from_file(&loaded->grammar, file);
+    fclose(file);
+    if (!success)
+    {
+        ll1_grammar_free(loaded);
+        return LL1_ERROR_GRAMMAR;
+    }
+
+    *grammar = loaded;
+    return LL1_OK;
+}
+
+ll1_status ll1_grammar_parse(const char *text, size_t length, ll1_grammar **grammar)
+{
+    if (!text || !grammar)
+        return LL1_ERROR_ARGUMENT;
+
+    ll1_grammar *parsed = malloc(sizeof(ll1_grammar));
+    if (!parsed)
+        return LL1_ERROR_MEMORY;
+
+    init_grammar(&parsed->grammar, 16);
+    if (!create_grammar_from_buffer(&parsed->grammar, text, length))
+    {
+        ll1_grammar_free(parsed);
+        return LL1_ERROR_GRAMMAR;
+    }
+
+    *grammar = parsed;
+    return LL1_OK;
+}
+
+void ll1_grammar_free(ll1_grammar *grammar)
+{
+    if (!grammar)
+        return;
+
+    clear_grammar(&grammar->grammar);
+    free(grammar);
+}
+
+ll1_status ll1_parser_build(const ll1_grammar *grammar, unsigned max_lookahead, ll1_parser **parser)
+{
+    if (!grammar || !parser || max_lookahead > MAX_LOOKAHEAD)
+        return LL1_ERROR_ARGUMENT;
+
+    ll1_parser *built = malloc(sizeof(ll1_parser));
+    if (!built)
+        return LL1_ERROR_MEMORY;
+
+    init_parser(&built->parser, &grammar->grammar);
+    built->parser.max_lookahead = max_lookahead > 1 ? max_lookahead : 1;
+    build_parse_table(&built->parser);
+    if (!is_valid_grammar(&built->parser))
+    {
+        ll1_parser_free(built);
+        return LL1_ERROR_CONFLICT;
+    }
+
+    *parser = built;
+    return LL1_OK;
+}
+
+void ll1_parser_free(ll1_parser *parser)
+{
+    if (!parser)
+        return;
+
+    clear_parser(&parser->parser);
+    free(parser);
+}
+
+ll1_status ll1_find_token(const ll1_parser *parser, const char *name, size_t length, int *token)
+{
+    if (!parser || !name || !token)
+        return LL1_ERROR_ARGUMENT;
+
+    int id = find_terminal(&parser->parser, name, length);
+    if (id == HASH_TABLE_MISSING)
+        return LL1_UNKNOWN_TOKEN;
+
+    *token = id;
+    return LL1_OK;
+}
+
+ll1_status ll1_context_create(ll1_context **context)
+{
+    if (!context)
+        return LL1_ERROR_ARGUMENT;
+
+    ll1_context *created = malloc(sizeof(ll1_context));
+    if (!created)
+        return LL1_ERROR_MEMORY;
+
+    init_parse_context(&created->context);
+    *context = created;
+    return LL1_OK;
+}
+
+void ll1_context_free(ll1_context *context)
+{
+    if (!context)
+        return;
+
+    clear_parse_context(&context->context);
+    free(context);
+}
+
+ll1_status ll1_validate(const ll1_parser *parser, ll1_context *context, const int *tokens, size_t n_tokens)
+{
+    if (!parser || (!tokens && n_tokens > 0))
+        return LL1_ERROR_ARGUMENT;
+
+    // Token ids come from the caller, so they are checked before they are
+    // used as table indices
+    for (size_t i = 0; i < n_tokens; i++)
+    {
+        if (!is_input_token(&parser->parser, tokens[i]))
+            return LL1_UNKNOWN_TOKEN;
+    }
+
+    ll1_context local;
+    if (!context)
+        init_parse_context(&local.context);
+
+    ll1_context *used = context ? context : &local;
+    bool valid = validate_tokens(&parser->parser, &used->context.stack, tokens, n_tokens);
+
+    if (!context)
+        clear_parse_context(&local.context);
+
+    return valid ? LL1_OK : LL1_REJECTED;
+}
+
+ll1_status ll1_validate_string(const ll1_parser *parser, ll1_context *context, const char *text, size_t length)
+{
+    if (!parser || (!text && length > 0))
+        return LL1_ERROR_ARGUMENT;
+
+    ll1_context local;
+    if (!context)
+        init_parse_context(&local.context);
+
+    ll1_context *used = context ? context : &local;
+    used->context.tokens.count = 0;
+    ll1_status status = LL1_UNKNOWN_TOKEN;
+    if (tokenize_span(&parser->parser, text, length, &used->context.tokens))
+    {
+        status = validate_tokens(&parser->parser, &used->context.stack, used->context.tokens.head,
+                                 used->context.tokens.count)
+                     ? LL1_OK
+                     : LL1_REJECTED;
+    }
+
+    if (!context)
+        clear_parse_context(&local.context);
+
+    return status;
+}
+
+ll1_status ll1_cache_create(size_t max_bytes, unsigned max_lookahead, ll1_cache **cache)
+{
+    if (!cache || max_lookahead > MAX_LOOKAHEAD)
+        return LL1_ERROR_ARGUMENT;
+
+    ll1_cache *created = malloc(sizeof(ll1_cache));
+    if (!created)
+        return LL1_ERROR_MEMORY;
+
+    init_parser_cache(&created->cache, max_bytes);
+    created->cache.max_lookahead = max_lookahead > 1 ? max_lookahead : 1;
+    *cache = created;
+    return LL1_OK;
+}
+
+void ll1_cache_free(ll1_cache *cache)
+{
+    if (!cache)
+        return;
+
+    clear_parser_cache(&cache->cache);
+    free(cache);
+}
+
+ll1_status ll1_cache_acquire(ll1_cache *cache, const char *text, size_t length, const ll1_parser **parser)
+{
+    if (!cache || (!text && length > 0) || !parser)
+        return LL1_ERROR_ARGUMENT;
+
+    const ll1_parser *cached = (const ll1_parser *)acquire_cached_parser(&cache->cache, text ? text : "", length);
+    if (!cached)
+        return LL1_ERROR_GRAMMAR;
+
+    if (!is_valid_grammar(&cached->parser))
+    {
+        release_cached_parser(&cache->cache, &cached->parser);
+        return LL1_ERROR_CONFLICT;
+    }
+
+    *parser = cached;
+    return LL1_OK;
+}
+
+void ll1_cache_release(ll1_cache *cache, const ll1_parser *parser)
+{
+    if (cache && parser)
+        release_cached_parser(&cache->cache, &parser->parser);
+}
+
+void ll1_cache_get_stats(ll1_cache *cache, ll1_cache_stats *stats)
+{
+    if (!cache || !stats)
+        return;
+
+    parser_cache_counters counters = get_parser_cache_counters(&cache->cache);
+    stats->hits = counters.hits;
+    stats->misses = counters.misses;
+    stats->waits = counters.waits;
+    stats->evictions = counters.evictions;
+    stats->table_bytes = counters.table_bytes;
+    stats->n_parsers = counters.n_entries;
+}
+
+bool is_input_token(const parser *parser, int token)
+{
+    size_t n_symbols = parser->n_terminals + parser->n_nonterminals;
+    return token >= 0 && (size_t)token < n_symbols && parser->terminal_symbols[token] &&
+           token != parser->end_symbol && token != parser->empty_symbol;
+}
@@ -0,0 +1,88 @@
+#ifndef LL1_H
+#define LL1_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Embedding interface of libll1. Handles are opaque and every call reports
+// failure through its status, nothing is printed and nothing exits.
+//
+// A built parser is only read while validating, so it can be shared by any
+// number of threads. Each thread needs its own context for the buffers a
+// validation grows, or passes NULL to have them allocated for the call.
+
+#if defined(__GNUC__)
+#define LL1_API __attribute__((visibility("default")))
+#else
+#define LL1_API
+#endif
+
+typedef enum
+{
+    // Results of a validation
+    LL1_OK = 0,
+    LL1_REJECTED = 1,
+    LL1_UNKNOWN_TOKEN = 2,
+
+    // Errors
+    LL1_ERROR_ARGUMENT = -1,
+    LL1_ERROR_IO = -2,
+    LL1_ERROR_GRAMMAR = -3,
+    LL1_ERROR_CONFLICT = -4,
+    LL1_ERROR_MEMORY = -5
+} ll1_status;
+
+typedef struct ll1_grammar ll1_grammar;
+typedef struct ll1_parser ll1_parser;
+typedef struct ll1_context ll1_context;
+typedef struct ll1_cache ll1_cache;
+
+typedef struct
+{
+    uint64_t hits;
+    uint64_t misses;
+    // Hits that waited for another caller to finish building the parser
+    uint64_t waits;
+    uint64_t evictions;
+    size_t table_bytes;
+    size_t n_parsers;
+} ll1_cache_stats;
+
+LL1_API const char *ll1_status_string(ll1_status status);
+
+LL1_API ll1_status ll1_grammar_load(const char *path, ll1_grammar **grammar);
+LL1_API ll1_status ll1_grammar_parse(const char *text, size_t length, ll1_grammar **grammar);
+LL1_API void ll1_grammar_free(ll1_grammar *grammar);
+
+// Builds the table for a grammar, which has to outlive the parser. Cells
+// that one token can not decide may use up to max_lookahead tokens, 0 and 1
+// both mean LL(1). Fails with LL1_ERROR_CONFLICT if cells are left.
+LL1_API ll1_status ll1_parser_build(const ll1_grammar *grammar, unsigned max_lookahead, ll1_parser **parser);
+LL1_API void ll1_parser_free(ll1_parser *parser);
+// Terminal id of a token name, for building token arrays up front
+LL1_API ll1_status ll1_find_token(const ll1_parser *parser, const char *name, size_t length, int *token);
+
+LL1_API ll1_status ll1_context_create(ll1_context **context);
+LL1_API void ll1_context_free(ll1_context *context);
+
+LL1_API ll1_status ll1_validate(const ll1_parser *parser, ll1_context *context, const int *tokens,
+                                size_t n_tokens);
+// Tokens are separated by whitespace
+LL1_API ll1_status ll1_validate_string(const ll1_parser *parser, ll1_context *context, const char *text,
+                                       size_t length);
+
+// Parsers for grammar texts, built once per text however many threads ask
+// for it at the same time. Texts that only differ in spacing or blank lines
+// share a parser. Released parsers are kept until the least recently used
+// are evicted to keep their tables under max_bytes.
+LL1_API ll1_status ll1_cache_create(size_t max_bytes, unsigned max_lookahead, ll1_cache **cache);
+// Every parser must have been released
+LL1_API void ll1_cache_free(ll1_cache *cache);
+// The parser stays valid until it is released and may be used by any
+// number of threads. Grammars with conflicts are cached too, so asking
+// again fails fast with LL1_ERROR_CONFLICT.
+LL1_API ll1_status ll1_cache_acquire(ll1_cache *cache, const char *text, size_t length, const ll1_parser **parser);
+LL1_API void ll1_cache_release(ll1_cache *cache, const ll1_parser *parser);
+LL1_API void ll1_cache_get_stats(ll1_cache *cache, ll1_cache_stats *stats);
+
+#endif
@@ -0,0 +1,507 @@
+#include "lookahead.h"
+#include <string.h>
+
+// Limits of the search for the lookahead strings of one cell, past them the
+// cell is left as a conflict. Derivations that never consume a token, like
+// left recursion, would not end otherwise.
+#define SEARCH_BUDGET 10000
+#define MAX_SEARCH_STACK 256
+
+// Lookahead string of a rule, strings shorter than the lookahead end with
+// the end symbol
+typedef struct
+{
+    int rule;
+    int length;
+    int tokens[MAX_LOOKAHEAD];
+} lookahead_string;
+
+// Derivation waiting to be searched, its stack is n_symbols symbols of the
+// search buffer from first_symbol, top last like the driver stack. When the
+// stack runs out the search goes on with whatever can follow context.
+typedef struct
+{
+    size_t first_symbol;
+    size_t n_symbols;
+    int context;
+    int length;
+    uint32_t stamp;
+    int tokens[MAX_LOOKAHEAD];
+} search_state;
+
+typedef struct
+{
+    const parser *parser;
+    // Rules of each nonterminal and right hand side uses of each symbol,
+    // indexed by symbol id. Use positions index the reversed driver rhs, so
+    // the symbols after a use are the ones before its position.
+    int *rule_lhs;
+    int *rule_offsets;
+    int *rules;
+    int *use_offsets;
+    int *use_rules;
+    int *use_positions;
+
+    list states;
+    list symbols;
+    list candidates;
+    list strings;
+    size_t steps;
+
+    // Every token added to a string starts a new stamp, a context is only
+    // followed once per stamp
+    uint32_t *follow_stamps;
+    uint32_t stamp;
+} lookahead_search;
+
+static void init_lookahead_search(lookahead_search *search, const parser *parser);
+static void clear_lookahead_search(lookahead_search *search);
+static int compare_conflicts(const void *a, const void *b);
+static int compare_strings(const void *a, const void *b);
+static int compare_tokens(const lookahead_string *x, const lookahead_string *y);
+static bool resolve_cell(lookahead_search *search, parser *parser, const table_conflict *conflicts, size_t n_rules,
+                         int terminal);
+static bool search_rule_strings(lookahead_search *search, int rule, int terminal, int depth);
+static bool advance_search(lookahead_search *search, search_state *state, int rule, int terminal, int depth);
+static search_state *push_state(lookahead_search *search, const search_state *from, int context);
+static void push_symbols(lookahead_search *search, search_state *state, const int *symbols, size_t n);
+static void add_string(lookahead_search *search, int rule, const search_state *state);
+static int build_trie_node(parser *parser, const lookahead_string *strings, size_t first, size_t last, int depth);
+
+size_t build_lookahead_tries(parser *parser)
+{
+    if (parser->max_lookahead > MAX_LOOKAHEAD)
+        parser->max_lookahead = MAX_LOOKAHEAD;
+
+    size_t n_symbols = parser->n_terminals + parser->n_nonterminals;
+    int *terminal_ids = malloc(parser->n_terminals * sizeof(int));
+    for (size_t i = 0; i < n_symbols; i++)
+    {
+        if (parser->terminal_symbols[i])
+            terminal_ids[parser->symbol_ordinals[i]] = i;
+    }
+
+    // Entries are grouped by cell on a copy, the list itself is only
+    // compacted at the end
+    size_t n_conflicts = parser->conflicts.count;
+    table_conflict *conflicts = malloc(n_conflicts * sizeof(table_conflict));
+    memcpy(conflicts, parser->conflicts.head, n_conflicts * sizeof(table_conflict));
+    qsort(conflicts, n_conflicts, sizeof(table_conflict), compare_conflicts);
+
+    lookahead_search search;
+    init_lookahead_search(&search, parser);
+
+    size_t n_resolved = 0;
+    for (size_t first = 0, last; first < n_conflicts; first = last)
+    {
+        for (last = first + 1; last < n_conflicts && conflicts[last].nonterminal == conflicts[first].nonterminal &&
+                               conflicts[last].terminal == conflicts[first].terminal;
+             last++)
+            ;
+
+        if (resolve_cell(&search, parser, conflicts + first, last - first, terminal_ids[conflicts[first].terminal]))
+            n_resolved++;
+    }
+
+    size_t n_kept = 0;
+    for (size_t i = 0; i < parser->conflicts.count; i++)
+    {
+        table_conflict *conflict = get_list_element(&parser->conflicts, i);
+        if (parser->table[conflict->nonterminal * parser->n_terminals + conflict->terminal] == CONFLICT_RULE)
+            *(table_conflict *)get_list_element(&parser->conflicts, n_kept++) = *conflict;
+    }
+
+    parser->conflicts.count = n_kept;
+    parser->n_lookahead_cells += n_resolved;
+    clear_lookahead_search(&search);
+    free(conflicts);
+    free(terminal_ids);
+    return n_resolved;
+}
+
+int find_lookahead_rule(const parser *parser, int cell, const token_window *window)
+{
+    const lookahead_node *nodes = parser->lookahead_nodes.head;
+    const lookahead_edge *edges = parser->lookahead_edges.head;
+    const lookahead_node *node = nodes + LOOKAHEAD_NODE(cell);
+
+    // The root was reached through the first token of the window
+    for (size_t i = 1; node->n_edges > 0; i++)
+    {
+        int token = get_window_token(parser, window, i);
+        const lookahead_edge *node_edges = edges + node->first_edge;
+        size_t low = 0;
+        size_t high = node->n_edges;
+        while (low < high)
+        {
+            size_t middle = (low + high) / 2;
+            if (node_edges[middle].token < token)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+
+        if (low == (size_t)node->n_edges || node_edges[low].token != token)
+            return NO_RULE;
+
+        node = nodes + node_edges[low].node;
+    }
+
+    return node->rule;
+}
+
+void init_lookahead_search(lookahead_search *search, const parser *parser)
+{
+    const grammar *grammar = parser->grammar;
+    size_t n_symbols = grammar->symbols.count;
+    size_t n_rules = grammar->rules.count;
+    search->parser = parser;
+    search->rule_lhs = malloc(n_rules * sizeof(int));
+    search->rule_offsets = calloc(n_symbols + 1, sizeof(int));
+    search->rules = malloc(n_rules * sizeof(int));
+    search->use_offsets = calloc(n_symbols + 1, sizeof(int));
+
+    // Rules and uses are bucketed by symbol with a counting pass
+    for (size_t i = 0; i < n_rules; i++)
+    {
+        const rule *rule = get_list_element(&grammar->rules, i);
+        search->rule_lhs[rule->id] = rule->lhs->id;
+        search->rule_offsets[rule->lhs->id + 1]++;
+        for (int j = parser->rhs_offsets[rule->id]; j < parser->rhs_offsets[rule->id + 1]; j++)
+            search->use_offsets[parser->rhs_symbols[j] + 1]++;
+    }
+
+    for (size_t i = 0; i < n_symbols; i++)
+    {
+        search->rule_offsets[i + 1] += search->rule_offsets[i];
+        search->use_offsets[i + 1] += search->use_offsets[i];
+    }
+
+    size_t n_uses = search->use_offsets[n_symbols];
+    search->use_rules = malloc(n_uses * sizeof(int));
+    search->use_positions = malloc(n_uses * sizeof(int));
+    int *rule_fill = malloc(n_symbols * sizeof(int));
+    int *use_fill = malloc(n_symbols * sizeof(int));
+    memcpy(rule_fill, search->rule_offsets, n_symbols * sizeof(int));
+    memcpy(use_fill, search->use_offsets, n_symbols * sizeof(int));
+    for (size_t i = 0; i < n_rules; i++)
+    {
+        search->rules[rule_fill[search->rule_lhs[i]]++] = i;
+        int rhs_offset = parser->rhs_offsets[i];
+        for (int j = rhs_offset; j < parser->rhs_offsets[i + 1]; j++)
+        {
+            int use = use_fill[parser->rhs_symbols[j]]++;
+            search->use_rules[use] = i;
+            search->use_positions[use] = j - rhs_offset;
+        }
+    }
+
+    free(rule_fill);
+    free(use_fill);
+
+    init_list(&search->states, 16, sizeof(search_state));
+    init_list(&search->symbols, 64, sizeof(int));
+    init_list(&search->candidates, 16, sizeof(int));
+    init_list(&search->strings, 16, sizeof(lookahead_string));
+    search->steps = 0;
+    search->follow_stamps = calloc(n_symbols, sizeof(uint32_t));
+    search->stamp = 0;
+}
+
+void clear_lookahead_search(lookahead_search *search)
+{
+    free(search->rule_lhs);
+    free(search->rule_offsets);
+    free(search->rules);
+    free(search->use_offsets);
+    free(search->use_rules);
+    free(search->use_positions);
+    clear_list(&search->states);
+    clear_list(&search->symbols);
+    clear_list(&search->candidates);
+    clear_list(&search->strings);
+    free(search->follow_stamps);
+}
+
+int compare_conflicts(const void *a, const void *b)
+{
+    const table_conflict *x = a;
+    const table_conflict *y = b;
+    if (x->nonterminal != y->nonterminal)
+        return x->nonterminal < y->nonterminal ? -1 : 1;
+    if (x->terminal != y->terminal)
+        return x->terminal < y->terminal ? -1 : 1;
+    return (x->rule > y->rule) - (x->rule < y->rule);
+}
+
+int compare_strings(const void *a, const void *b)
+{
+    const lookahead_string *x = a;
+    const lookahead_string *y = b;
+    int order = compare_tokens(x, y);
+    return order != 0 ? order : (x->rule > y->rule) - (x->rule < y->rule);
+}
+
+int compare_tokens(const lookahead_string *x, const lookahead_string *y)
+{
+    int length = x->length < y->length ? x->length : y->length;
+    for (int i = 0; i < length; i++)
+    {
+        if (x->tokens[i] != y->tokens[i])
+            return x->tokens[i] < y->tokens[i] ? -1 : 1;
+    }
+
+    return (x->length > y->length) - (x->length < y->length);
+}
+
+bool resolve_cell(lookahead_search *search, parser *parser, const table_conflict *conflicts, size_t n_rules,
+                  int terminal)
+{
+    int *cell = parser->table + conflicts[0].nonterminal * parser->n_terminals + conflicts[0].terminal;
+    for (size_t depth = 2; depth <= parser->max_lookahead; depth++)
+    {
+        search->strings.count = 0;
+        search->steps = 0;
+        for (size_t i = 0; i < n_rules; i++)
+        {
+            if (!search_rule_strings(search, conflicts[i].rule, terminal, depth))
+                return false;
+        }
+
+        if (search->strings.count == 0)
+            return false;
+
+        qsort(search->strings.head, search->strings.count, sizeof(lookahead_string), compare_strings);
+
+        // Rules that share a string ending with the end symbol can not be
+        // told apart with any lookahead
+        const lookahead_string *strings = search->strings.head;
+        for (size_t i = 1; i < search->strings.count; i++)
+        {
+            if (strings[i].rule != strings[i - 1].rule && strings[i].length < (int)depth &&
+                compare_tokens(strings + i, strings + i - 1) == 0)
+                return false;
+        }
+
+        size_t n_nodes = parser->lookahead_nodes.count;
+        size_t n_edges = parser->lookahead_edges.count;
+        int root = build_trie_node(parser, search->strings.head, 0, search->strings.count, 1);
+        if (root < 0)
+        {
+            parser->lookahead_nodes.count = n_nodes;
+            parser->lookahead_edges.count = n_edges;
+            continue;
+        }
+
+        *cell = LOOKAHEAD_CELL(root);
+        if (depth > parser->lookahead_depth)
+            parser->lookahead_depth = depth;
+        return true;
+    }
+
+    return false;
+}
+
+bool search_rule_strings(lookahead_search *search, int rule, int terminal, int depth)
+{
+    const parser *parser = search->parser;
+    search->states.count = 0;
+    search->symbols.count = 0;
+
+    search_state *start = push_back(&search->states);
+    start->first_symbol = 0;
+    start->n_symbols = 0;
+    start->context = search->rule_lhs[rule];
+    start->length = 0;
+    start->stamp = ++search->stamp;
+    int rhs_offset = parser->rhs_offsets[rule];
+    push_symbols(search, start, parser->rhs_symbols + rhs_offset, parser->rhs_offsets[rule + 1] - rhs_offset);
+
+    // Depth first, so the symbols of the state on top are the last ones in
+    // the buffer
+    while (search->states.count > 0)
+    {
+        search_state state = *(search_state *)peek_back(&search->states);
+        pop_back(&search->states);
+        search->symbols.count = state.first_symbol + state.n_symbols;
+        if (!advance_search(search, &state, rule, terminal, depth))
+            return false;
+    }
+
+    return true;
+}
+
+bool advance_search(lookahead_search *search, search_state *state, int rule, int terminal, int depth)
+{
+    const parser *parser = search->parser;
+    while (search->symbols.count > state->first_symbol)
+    {
+        if (++search->steps > SEARCH_BUDGET || search->symbols.count - state->first_symbol > MAX_SEARCH_STACK)
+            return false;
+
+        int symbol = *(int *)peek_back(&search->symbols);
+        pop_back(&search->symbols);
+        if (parser->terminal_symbols[symbol])
+        {
+            // Strings of other terminals belong to other cells
+            if (state->length == 0 && symbol != terminal)
+                return true;
+
+            state->tokens[state->length++] = symbol;
+            if (state->length == depth || symbol == parser->end_symbol)
+            {
+                add_string(search, rule, state);
+                return true;
+            }
+
+            state->stamp = ++search->stamp;
+            continue;
+        }
+
+        // Only rules that can start with the cell's terminal are expanded
+        // before it is matched
+        search->candidates.count = 0;
+        for (int i = search->rule_offsets[symbol]; i < search->rule_offsets[symbol + 1]; i++)
+        {
+            int candidate = search->rules[i];
+            if (state->length > 0 || bitset_test(get_rule_first_set(parser, candidate), terminal) ||
+                bitset_test(parser->nullable_rules, candidate))
+                *(int *)push_back(&search->candidates) = candidate;
+        }
+
+        if (search->candidates.count == 0)
+            return true;
+
+        // The last candidate keeps the symbols left in place, the others
+        // get their own copy above it
+        const int *candidates = search->candidates.head;
+        size_t n_left = search->symbols.count - state->first_symbol;
+        int last = candidates[search->candidates.count - 1];
+        int rhs_offset = parser->rhs_offsets[last];
+        if (search->candidates.count == 1)
+        {
+            push_symbols(search, state, parser->rhs_symbols + rhs_offset, parser->rhs_offsets[last + 1] - rhs_offset);
+            continue;
+        }
+
+        search_state *in_place = push_back(&search->states);
+        *in_place = *state;
+        in_place->n_symbols = n_left;
+        push_symbols(search, in_place, parser->rhs_symbols + rhs_offset, parser->rhs_offsets[last + 1] - rhs_offset);
+
+        for (size_t i = 0; i + 1 < search->candidates.count; i++)
+        {
+            search_state *copy = push_state(search, state, state->context);
+            reserve_list(&search->symbols, search->symbols.count + n_left);
+            int *symbols = search->symbols.head;
+            memcpy(symbols + search->symbols.count, symbols + state->first_symbol, n_left * sizeof(int));
+            search->symbols.count += n_left;
+            copy->n_symbols = n_left;
+
+            rhs_offset = parser->rhs_offsets[candidates[i]];
+            push_symbols(search, copy, parser->rhs_symbols + rhs_offset,
+                         parser->rhs_offsets[candidates[i] + 1] - rhs_offset);
+        }
+
+        return true;
+    }
+
+    // The stack ran out, so the rule of context is complete and the string
+    // goes on with the symbols after each use of context
+    if (search->follow_stamps[state->context] == state->stamp)
+        return true;
+
+    // Strings end with the end symbol before the start rule is complete,
+    // so a context without uses is not reachable and nothing follows it
+    search->follow_stamps[state->context] = state->stamp;
+    for (int i = search->use_offsets[state->context]; i < search->use_offsets[state->context + 1]; i++)
+    {
+        int use_rule = search->use_rules[i];
+        search_state *next = push_state(search, state, search->rule_lhs[use_rule]);
+        push_symbols(search, next, parser->rhs_symbols + parser->rhs_offsets[use_rule], search->use_positions[i]);
+    }
+
+    return true;
+}
+
+search_state *push_state(lookahead_search *search, const search_state *from, int context)
+{
+    search_state *state = push_back(&search->states);
+    *state = *from;
+    state->first_symbol = search->symbols.count;
+    state->n_symbols = 0;
+    state->context = context;
+    return state;
+}
+
+void push_symbols(lookahead_search *search, search_state *state, const int *symbols, size_t n)
+{
+    if (n > 0)
+        push_back_many(&search->symbols, symbols, n);
+    state->n_symbols += n;
+}
+
+void add_string(lookahead_search *search, int rule, const search_state *state)
+{
+    lookahead_string *string = push_back(&search->strings);
+    string->rule = rule;
+    string->length = state->length;
+    memcpy(string->tokens, state->tokens, state->length * sizeof(int));
+}
+
+int build_trie_node(parser *parser, const lookahead_string *strings, size_t first, size_t last, int depth)
+{
+    // Strings from first to last are sorted and share their first depth
+    // tokens
+    int node_index = parser->lookahead_nodes.count;
+    lookahead_node *node = push_back(&parser->lookahead_nodes);
+    node->rule = strings[first].rule;
+    node->first_edge = parser->lookahead_edges.count;
+    node->n_edges = 0;
+
+    bool decided = true;
+    bool ended = false;
+    for (size_t i = first; i < last; i++)
+    {
+        decided = decided && strings[i].rule == strings[first].rule;
+        ended = ended || strings[i].length == depth;
+    }
+
+    if (decided)
+        return node_index;
+
+    // Two rules share a string that can not be told apart with more tokens,
+    // or with the lookahead being tried
+    if (ended)
+        return -1;
+
+    node->rule = NO_RULE;
+    size_t first_edge = parser->lookahead_edges.count;
+    for (size_t i = first; i < last; i++)
+    {
+        if (i == first || strings[i].tokens[depth] != strings[i - 1].tokens[depth])
+        {
+            ((lookahead_edge *)push_back(&parser->lookahead_edges))->token = strings[i].tokens[depth];
+            node->n_edges++;
+        }
+    }
+
+    // Children are added after the edges, so nodes of the same parent keep
+    // their edges together
+    size_t edge_index = first_edge;
+    size_t group = first;
+    for (size_t i = first + 1; i <= last; i++)
+    {
+        if (i < last && strings[i].tokens[depth] == strings[group].tokens[depth])
+            continue;
+
+        int child = build_trie_node(parser, strings, group, i, depth + 1);
+        if (child < 0)
+            return -1;
+
+        ((lookahead_edge *)get_list_element(&parser->lookahead_edges, edge_index++))->node = child;
+        group = i;
+    }
+
+    return node_index;
+}
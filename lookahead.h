@@ -0,0 +1,30 @@
+#ifndef LOOKAHEAD_H
+#define LOOKAHEAD_H
+
+#include "parser.h"
+
+// Node of the trie of a cell that needs more than one token of lookahead.
+// The root stands for the cell's own terminal, each edge for the token
+// after it. Nodes with no edges decide the rule, edges are sorted by token.
+typedef struct
+{
+    int rule;
+    int first_edge;
+    int n_edges;
+} lookahead_node;
+
+typedef struct
+{
+    int token;
+    int node;
+} lookahead_edge;
+
+// Replaces conflicting cells that up to max_lookahead tokens can tell apart
+// with a lookahead trie, trying one more token at a time. Lookahead strings
+// are those of strong LL(k): what a rule derives followed by anything that
+// can follow its lhs. Returns the number of cells replaced.
+size_t build_lookahead_tries(parser *parser);
+// Rule for a cell that holds a lookahead trie, or NO_RULE
+int find_lookahead_rule(const parser *parser, int cell, const token_window *window);
+
+#endif
@@ -1,29 +1,721 @@
+#include "batch.h"
+#include "codegen.h"
+#include "compiled.h"
+#include "earley.h"
+#include "file_util.h"
 #include "grammar.h"
+#include "packed.h"
 #include "parser.h"
+#include "recovery.h"
+#include "server.h"
+#include "stream.h"
+#include "transform.h"
+#include "tree.h"
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
-void read_input(char *buffer, size_t n)
+// Grammars one server can load
+#define MAX_SERVER_GRAMMARS 64
+
+typedef struct
+{
+    const char *grammar_path;
+    const char *grammar_paths[MAX_SERVER_GRAMMARS];
+    size_t n_grammars;
+    analysis_strategy strategy;
+    bool stream_mode;
+    const char *batch_path;
+    long n_threads;
+    const char *compile_path;
+    bool compiled;
+    const char *generate_path;
+    const char *prefix;
+    bool print_stats;
+    bool tree_mode;
+    bool errors_mode;
+    bool transform;
+    bool greedy;
+    size_t max_lookahead;
+    bool pack;
+    const char *socket_path;
+} options;
+
+// Validates one line of input, returns false if there was nothing left to read
+bool read_line_input(const parser *parser, FILE *file, bool *valid)
+{
+    parse_stream stream;
+    begin_stream(&stream, parser);
+
+    char chunk[1024];
+    bool has_input = false;
+    while (fgets(chunk, sizeof(chunk), file))
+    {
+        has_input = true;
+        size_t length = strlen(chunk);
+        feed_stream(&stream, chunk, length);
+
+        if (length > 0 && chunk[length - 1] == '\n') break;
+    }
+
+    *valid = end_stream(&stream);
+    return has_input;
+}
+
+// Validates everything that is left in file as a single input
+bool read_stream_input(const parser *parser, FILE *file)
+{
+    parse_stream stream;
+    begin_stream(&stream, parser);
+
+    // Regular files are tokenized in place from the page cache
+    mapped_file mapped;
+    if (map_file(file, &mapped))
+    {
+        feed_stream(&stream, mapped.data, mapped.size);
+        unmap_file(&mapped);
+        return end_stream(&stream);
+    }
+
+    char chunk[65536];
+    size_t length;
+    while ((length = fread(chunk, sizeof(char), sizeof(chunk), file)) > 0)
+    {
+        if (!feed_stream(&stream, chunk, length)) break;
+    }
+
+    return end_stream(&stream);
+}
+
+// Recognizes everything that is left in file as a single input, for
+// grammars the table can not drive. The recognizer needs every token at
+// once, so the input is not read in chunks.
+bool read_earley_input(const parser *parser, FILE *file)
+{
+    parse_context context;
+    init_parse_context(&context);
+    earley_recognizer recognizer;
+    init_earley_recognizer(&recognizer, parser);
+
+    bool valid = false;
+    mapped_file mapped;
+    if (map_file(file, &mapped))
+    {
+        valid = earley_recognize_span(&recognizer, &context, mapped.data, mapped.size);
+        unmap_file(&mapped);
+    }
+    else
+    {
+        list input;
+        init_list(&input, 65536, sizeof(char));
+        size_t length;
+        while ((length = fread((char *)input.head + input.count, sizeof(char), input.size - input.count, file)) > 0)
+        {
+            input.count += length;
+            reserve_list(&input, input.count * 2);
+        }
+
+        valid = earley_recognize_span(&recognizer, &context, input.head, input.count);
+        clear_list(&input);
+    }
+
+    clear_earley_recognizer(&recognizer);
+    clear_parse_context(&context);
+    return valid;
+}
+
+// Validates every line of the file at path, one result per line
+int validate_batch_file(const parser *parser, const char *path, long n_threads)
+{
+    // Results go to standard output, so the fallback is only noted on
+    // standard error
+    if (!is_valid_grammar(parser))
+    {
+        if (!parser->grammar)
+        {
+            printf("Grammar is not LL(1)\n");
+            return EXIT_FAILURE;
+        }
+
+        fputs("Grammar is not LL(1), using the Earley recognizer\n", stderr);
+    }
+
+    FILE *batch_file = fopen(path, "r");
+    if (!batch_file)
+    {
+        fputs("ERROR: could not open file\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    mapped_file mapped;
+    if (map_file(batch_file, &mapped))
+    {
+        validate_batch(parser, mapped.data, mapped.size, n_threads > 0 ? n_threads : 1, stdout);
+        unmap_file(&mapped);
+    }
+    else
+    {
+        char *input = read_file(batch_file);
+        if (input)
+        {
+            validate_batch(parser, input, strlen(input), n_threads > 0 ? n_threads : 1, stdout);
+            free(input);
+        }
+    }
+
+    fclose(batch_file);
+    return EXIT_SUCCESS;
+}
+
+// Interactive prompt, one string per line
+void run_prompt(const parser *parser)
+{
+    while (1)
+    {
+        printf("Your string: ");
+        fflush(stdout);
+
+        bool valid;
+        if (!read_line_input(parser, stdin, &valid)) break;
+
+        if (valid)
+            printf("Valid string\n");
+        else
+            printf("Invalid string\n");
+    };
+}
+
+// Interactive prompt that also prints the derivation of valid strings, in
+// terms of the original grammar when the parser was built from a transform
+void run_tree_prompt(const parser *parser, const grammar_transform *transform)
+{
+    parse_context context;
+    init_parse_context(&context);
+
+    // Each tree is dropped with a single reset before the next line
+    arena arena;
+    init_arena(&arena, 4096);
+    parse_tree tree;
+    parse_tree original_tree;
+    init_parse_tree(&tree, &arena);
+    init_parse_tree(&original_tree, &arena);
+
+    char *line = NULL;
+    size_t line_size = 0;
+    while (1)
+    {
+        printf("Your string: ");
+        fflush(stdout);
+
+        ssize_t length = getline(&line, &line_size, stdin);
+        if (length < 0) break;
+
+        context.tokens.count = 0;
+        reset_arena(&arena);
+        if (tokenize_span(parser, line, length, &context.tokens) &&
+            build_parse_tree(parser, &context.stack, context.tokens.head, context.tokens.count, &tree))
+        {
+            printf("Valid string\n");
+            if (transform)
+            {
+                map_parse_tree(transform, &tree, &original_tree);
+                print_grammar_tree(transform->original, &original_tree);
+            }
+            else
+            {
+                print_parse_tree(parser, &tree);
+            }
+        }
+        else
+        {
+            printf("Invalid string\n");
+        }
+    }
+
+    free(line);
+    clear_arena(&arena);
+    clear_parse_context(&context);
+}
+
+// Interactive prompt that lists every syntax error of invalid strings.
+// Unknown tokens are reported and left out of the parse.
+void run_error_prompt(const parser *parser)
 {
-    memset(buffer, 0, n);
-    fgets(buffer, n, stdin);
+    list stack;
+    list tokens;
+    init_list(&stack, 16, sizeof(int));
+    init_list(&tokens, 16, sizeof(int));
+    error_report report;
+    init_error_report(&report);
+
+    char *line = NULL;
+    size_t line_size = 0;
+    while (1)
+    {
+        printf("Your string: ");
+        fflush(stdout);
+
+        ssize_t length = getline(&line, &line_size, stdin);
+        if (length < 0) break;
+
+        tokens.count = 0;
+        bool known = true;
+        const char *c = line;
+        const char *end = line + length;
+        while (c < end)
+        {
+            if (is_token_separator(*c))
+            {
+                c++;
+                continue;
+            }
+
+            const char *token = c;
+            while (c < end && !is_token_separator(*c))
+                c++;
+
+            int id = find_terminal(parser, token, c - token);
+            if (id == HASH_TABLE_MISSING)
+            {
+                if (known)
+                    printf("Invalid string\n");
+                printf("\tUnknown token %.*s\n", (int)(c - token), token);
+                known = false;
+                continue;
+            }
+
+            *(int *)new_list_element(&tokens) = id;
+        }
+
+        if (recover_tokens(parser, &stack, tokens.head, tokens.count, true, &report) && known)
+        {
+            printf("Valid string\n");
+        }
+        else
+        {
+            if (known)
+                printf("Invalid string\n");
+            print_parse_errors(parser, tokens.head, tokens.count, &report);
+        }
+    }
+
+    free(line);
+    clear_error_report(&report);
+    clear_list(&tokens);
+    clear_list(&stack);
+}
+
+// Interactive prompt for grammars the table can not drive
+void run_earley_prompt(const parser *parser)
+{
+    parse_context context;
+    init_parse_context(&context);
+    earley_recognizer recognizer;
+    init_earley_recognizer(&recognizer, parser);
+
+    char *line = NULL;
+    size_t line_size = 0;
+    while (1)
+    {
+        printf("Your string: ");
+        fflush(stdout);
+
+        ssize_t length = getline(&line, &line_size, stdin);
+        if (length < 0) break;
+
+        context.tokens.count = 0;
+        if (tokenize_span(parser, line, length, &context.tokens) &&
+            earley_recognize(&recognizer, context.tokens.head, context.tokens.count))
+            printf("Valid string\n");
+        else
+            printf("Invalid string\n");
+    }
+
+    free(line);
+    clear_earley_recognizer(&recognizer);
+    clear_parse_context(&context);
+}
+
+// Runs the selected validation mode on a built parser
+int run_parser(const parser *parser, const options *options, const grammar_transform *transform)
+{
+    if (options->batch_path)
+    {
+        return validate_batch_file(parser, options->batch_path, options->n_threads);
+    }
+
+    if (options->stream_mode)
+    {
+        // Standard input is validated as one input of any size
+        bool valid;
+        if (is_valid_grammar(parser))
+        {
+            valid = read_stream_input(parser, stdin);
+        }
+        else if (parser->grammar)
+        {
+            fputs("Grammar is not LL(1), using the Earley recognizer\n", stderr);
+            valid = read_earley_input(parser, stdin);
+        }
+        else
+        {
+            printf("Grammar is not LL(1)\n");
+            return EXIT_FAILURE;
+        }
+
+        if (!valid)
+        {
+            printf("Invalid string\n");
+            return EXIT_FAILURE;
+        }
+
+        printf("Valid string\n");
+        return EXIT_SUCCESS;
+    }
+
+    if (parser->grammar)
+    {
+        print_rules(parser);
+        putc('\n', stdout);
+        print_symbols(parser);
+        putc('\n', stdout);
+        print_table(parser);
+        putc('\n', stdout);
+        printf("Set unions: %zu\n\n", parser->n_set_unions);
+    }
+
+    if (transform)
+    {
+        printf("Left recursive nonterminals: %zu\n", transform->n_recursive);
+        printf("Factored prefixes: %zu\n\n", transform->n_factored);
+    }
+
+    if (options->greedy)
+    {
+        printf("Resolved conflicts: %zu\n\n", parser->n_resolved_conflicts);
+    }
+
+    if (options->max_lookahead > 1)
+    {
+        printf("Lookahead cells: %zu\n", parser->n_lookahead_cells);
+        printf("Longest lookahead: %zu\n\n", parser->lookahead_depth);
+    }
+
+    if (parser->packed_cells)
+    {
+        size_t dense_bytes = parser->n_nonterminals * parser->n_terminals * sizeof(int);
+        size_t packed_bytes = parser->n_nonterminals * sizeof(int) + parser->n_packed_cells * sizeof(packed_cell);
+        printf("Packed table cells: %zu\n", parser->n_packed_cells);
+        printf("Packed table bytes: %zu of %zu\n\n", packed_bytes, dense_bytes);
+    }
+
+    if (is_valid_grammar(parser))
+    {
+        if (options->tree_mode)
+            run_tree_prompt(parser, transform);
+        else if (options->errors_mode && parser->lookahead_depth == 1)
+            run_error_prompt(parser);
+        else if (options->errors_mode)
+            printf("Error recovery needs an LL(1) grammar\n");
+        else
+            run_prompt(parser);
+    }
+    else if (parser->grammar)
+    {
+        printf("Grammar is not LL(1), using the Earley recognizer\n");
+        run_earley_prompt(parser);
+    }
+    else
+    {
+        printf("Grammar is not LL(1)\n");
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// Writes the compiled form of a parser to the file at path
+int compile_parser(const parser *parser, const char *path)
+{
+    if (!is_valid_grammar(parser) || parser->lookahead_depth > 1)
+    {
+        printf("Grammar is not LL(1)\n");
+        return EXIT_FAILURE;
+    }
+
+    FILE *compiled_file = fopen(path, "wb");
+    if (!compiled_file)
+    {
+        fputs("ERROR: could not open file\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    bool success = write_compiled_parser(parser, compiled_file);
+    if (fclose(compiled_file) != 0 || !success)
+    {
+        fputs("ERROR: could not write compiled grammar\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// Writes a standalone C recognizer for the grammar to the file at path
+int generate_parser_source(const parser *parser, const char *path, const char *prefix)
+{
+    if (!is_valid_grammar(parser) || parser->lookahead_depth > 1)
+    {
+        printf("Grammar is not LL(1)\n");
+        return EXIT_FAILURE;
+    }
+
+    FILE *source_file = fopen(path, "w");
+    if (!source_file)
+    {
+        fputs("ERROR: could not open file\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    bool success = generate_recognizer(parser, prefix, source_file);
+    if (fclose(source_file) != 0 || !success)
+    {
+        fputs("ERROR: could not write generated source\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// Loads a parser written by --compile and runs it without a grammar
+int run_compiled(FILE *compiled_file, const options *options)
+{
+    uint64_t load_start = stats_now();
+    compiled_parser compiled;
+    if (!load_compiled_parser(&compiled, compiled_file, true))
+    {
+        fputs("Error reading compiled grammar\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    compiled.parser.stats.load_time = stats_now() - load_start;
+    if (options->pack)
+        pack_parse_table(&compiled.parser);
+
+    int status = run_parser(&compiled.parser, options, NULL);
+    if (options->print_stats)
+        write_stats_json(&compiled.parser.stats, compiled.parser.n_set_unions, stderr);
+
+    // The packed table is the only part of the parser outside the mapping
+    clear_packed_table(&compiled.parser);
+    unload_compiled_parser(&compiled);
+    return status;
+}
+
+// Builds a parser for every grammar and answers requests for them on a
+// socket until the process is told to stop
+int serve_grammars(const options *options)
+{
+    size_t n_grammars = options->n_grammars;
+    grammar *grammars = malloc(n_grammars * sizeof(grammar));
+    grammar_transform *transforms = malloc(n_grammars * sizeof(grammar_transform));
+    parser *parsers = malloc(n_grammars * sizeof(parser));
+    const parser **shared = malloc(n_grammars * sizeof(parser *));
+
+    size_t n_loaded = 0;
+    int status = EXIT_SUCCESS;
+    while (n_loaded < n_grammars && status == EXIT_SUCCESS)
+    {
+        const char *path = options->grammar_paths[n_loaded];
+        FILE *grammar_file = fopen(path, "r");
+        if (!grammar_file)
+        {
+            fprintf(stderr, "ERROR: could not open file %s\n", path);
+            status = EXIT_FAILURE;
+            break;
+        }
+
+        grammar *loaded = &grammars[n_loaded];
+        init_grammar(loaded, 16);
+        bool success = create_grammar_from_file(loaded, grammar_file);
+        fclose(grammar_file);
+        if (!success)
+        {
+            fprintf(stderr, "Error reading grammar %s\n", path);
+            clear_grammar(loaded);
+            status = EXIT_FAILURE;
+            break;
+        }
+
+        if (options->transform)
+            init_grammar_transform(&transforms[n_loaded], loaded);
+
+        parser *built = &parsers[n_loaded];
+        init_parser(built, options->transform ? &transforms[n_loaded].grammar : loaded);
+        built->strategy = options->strategy;
+        built->max_lookahead = options->max_lookahead;
+        build_parse_table(built);
+        if (options->greedy)
+            resolve_follow_conflicts(built);
+        if (options->pack)
+            pack_parse_table(built);
+
+        shared[n_loaded++] = built;
+        if (!is_valid_grammar(built))
+            printf("Grammar %s is not LL(1), using the Earley recognizer\n", path);
+    }
+
+    if (status == EXIT_SUCCESS &&
+        !run_server(options->socket_path, shared, n_grammars, options->n_threads > 0 ? options->n_threads : 1))
+    {
+        fprintf(stderr, "ERROR: could not listen on %s\n", options->socket_path);
+        status = EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < n_loaded; i++)
+    {
+        clear_parser(&parsers[i]);
+        if (options->transform)
+            clear_grammar_transform(&transforms[i]);
+        clear_grammar(&grammars[i]);
+    }
+
+    free(shared);
+    free(parsers);
+    free(transforms);
+    free(grammars);
+    return status;
+}
+
+bool parse_options(options *options, int argc, char **argv)
+{
+    options->grammar_path = NULL;
+    options->strategy = ANALYSIS_WORKLIST;
+    options->stream_mode = false;
+    options->batch_path = NULL;
+    options->n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    options->compile_path = NULL;
+    options->compiled = false;
+    options->generate_path = NULL;
+    options->prefix = "ll1";
+    options->print_stats = false;
+    options->tree_mode = false;
+    options->errors_mode = false;
+    options->transform = false;
+    options->greedy = false;
+    options->max_lookahead = 1;
+    options->pack = false;
+    options->socket_path = NULL;
+    options->n_grammars = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--iterative") == 0)
+        {
+            options->strategy = ANALYSIS_ITERATIVE;
+        }
+        else if (strcmp(argv[i], "--stream") == 0)
+        {
+            options->stream_mode = true;
+        }
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+        {
+            options->batch_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            options->n_threads = atol(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--compile") == 0 && i + 1 < argc)
+        {
+            options->compile_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--compiled") == 0)
+        {
+            options->compiled = true;
+        }
+        else if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc)
+        {
+            options->generate_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--prefix") == 0 && i + 1 < argc)
+        {
+            options->prefix = argv[++i];
+        }
+        else if (strcmp(argv[i], "--stats") == 0)
+        {
+            options->print_stats = true;
+        }
+        else if (strcmp(argv[i], "--tree") == 0)
+        {
+            options->tree_mode = true;
+        }
+        else if (strcmp(argv[i], "--errors") == 0)
+        {
+            options->errors_mode = true;
+        }
+        else if (strcmp(argv[i], "--transform") == 0)
+        {
+            options->transform = true;
+        }
+        else if (strcmp(argv[i], "--greedy") == 0)
+        {
+            options->greedy = true;
+        }
+        else if (strcmp(argv[i], "--lookahead") == 0 && i + 1 < argc)
+        {
+            options->max_lookahead = atol(argv[++i]);
+            if (options->max_lookahead < 1 || options->max_lookahead > MAX_LOOKAHEAD)
+                return false;
+        }
+        else if (strcmp(argv[i], "--pack") == 0)
+        {
+            options->pack = true;
+        }
+        else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc)
+        {
+            options->socket_path = argv[++i];
+        }
+        else if (options->n_grammars < MAX_SERVER_GRAMMARS)
+        {
+            options->grammar_paths[options->n_grammars++] = argv[i];
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    // Only a server takes more than one grammar
+    options->grammar_path = options->n_grammars > 0 ? options->grammar_paths[0] : NULL;
+    return options->n_grammars == 1 || (options->socket_path && options->n_grammars > 1);
 }
 
 int main(int argc, char **argv)
 {
-    if (argc != 2)
+    options options;
+    if (!parse_options(&options, argc, argv))
     {
         fputs("ERROR: wrong number of arguments\n", stderr);
         exit(EXIT_FAILURE);
     }
 
-    FILE *grammar_file = fopen(argv[1], "r");
+    if (options.socket_path)
+        return serve_grammars(&options);
+
+    FILE *grammar_file = fopen(options.grammar_path, "r");
     if (!grammar_file)
     {
         fputs("ERROR: could not open file\n", stderr);
         exit(EXIT_FAILURE);
     }
 
+    if (options.compiled)
+    {
+        int status = run_compiled(grammar_file, &options);
+        fclose(grammar_file);
+        return status;
+    }
+
+    uint64_t load_start = stats_now();
     grammar grammar;
     init_grammar(&grammar, 16);
 
@@ -37,44 +729,41 @@ int main(int argc, char **argv)
 
     fclose(grammar_file);
 
-    parser parser;
-    init_parser(&parser, &grammar);
-    build_parse_table(&parser);
-
-    print_rules(&parser);
-    putc('\n', stdout);
-    print_symbols(&parser);
-    putc('\n', stdout);
-    print_table(&parser);
-    putc('\n', stdout);
-
-    if (is_valid_grammar(&parser))
-    {
-        char input[1024];
-        while (1)
-        {
-            printf("Your string: ");
-            fflush(stdout);
-            read_input(input, sizeof(input));
+    uint64_t load_time = stats_now() - load_start;
 
-            if (input[0] == '\0') break;
+    // The table is built for the transformed grammar, derivations are
+    // still reported against the grammar that was loaded
+    grammar_transform transform;
+    if (options.transform)
+        init_grammar_transform(&transform, &grammar);
 
-            // Remove trailing newline
-            input[strcspn(input, "\n")] = 0;
+    parser parser;
+    init_parser(&parser, options.transform ? &transform.grammar : &grammar);
+    parser.stats.load_time = load_time;
+    parser.strategy = options.strategy;
+    parser.max_lookahead = options.max_lookahead;
+    build_parse_table(&parser);
+    if (options.greedy)
+        resolve_follow_conflicts(&parser);
+    if (options.pack)
+        pack_parse_table(&parser);
 
-            if (is_valid_string(&parser, input))
-                printf("Valid string\n");
-            else
-                printf("Invalid string\n");
-        };
-    }
+    int status;
+    if (options.compile_path)
+        status = compile_parser(&parser, options.compile_path);
+    else if (options.generate_path)
+        status = generate_parser_source(&parser, options.generate_path, options.prefix);
     else
-    {
-        printf("Grammar is not LL(1)\n");
-    }
+        status = run_parser(&parser, &options, options.transform ? &transform : NULL);
+
+    // Written to stderr so the dump can be separated from validation output
+    if (options.print_stats)
+        write_stats_json(&parser.stats, parser.n_set_unions, stderr);
 
     clear_parser(&parser);
+    if (options.transform)
+        clear_grammar_transform(&transform);
     clear_grammar(&grammar);
 
-    return EXIT_SUCCESS;
+    return status;
 }
@@ -0,0 +1,135 @@
+#include "packed.h"
+#include <string.h>
+
+typedef struct
+{
+    int row;
+    int n_entries;
+} packed_row;
+
+static int compare_rows(const void *a, const void *b);
+static bool fits_packed_cell(int value);
+static void reserve_cells(packed_cell **cells, size_t count, size_t capacity);
+
+bool pack_parse_table(parser *parser)
+{
+    size_t n_rows = parser->n_nonterminals;
+    size_t n_columns = parser->n_terminals;
+    if (n_rows > INT16_MAX)
+        return false;
+
+    packed_row *rows = malloc(n_rows * sizeof(packed_row));
+    size_t n_entries = 0;
+    for (size_t i = 0; i < n_rows; i++)
+    {
+        const int *cells = parser->table + i * n_columns;
+        rows[i] = (packed_row){(int)i, 0};
+        for (size_t column = 0; column < n_columns; column++)
+        {
+            if (cells[column] == NO_RULE)
+                continue;
+
+            if (!fits_packed_cell(cells[column]))
+            {
+                free(rows);
+                return false;
+            }
+
+            rows[i].n_entries++;
+        }
+
+        n_entries += rows[i].n_entries;
+    }
+
+    qsort(rows, n_rows, sizeof(packed_row), compare_rows);
+
+    // Grows when a row is placed past the end, a table that packs well
+    // needs little more than its entries
+    size_t capacity = n_entries + n_columns + 1;
+    packed_cell *cells = NULL;
+    reserve_cells(&cells, 0, capacity);
+
+    int *bases = calloc(n_rows ? n_rows : 1, sizeof(int));
+    int *columns = malloc((n_columns ? n_columns : 1) * sizeof(int));
+    size_t first_free = 0;
+    size_t max_base = 0;
+    for (size_t i = 0; i < n_rows && rows[i].n_entries > 0; i++)
+    {
+        const int *row = parser->table + rows[i].row * n_columns;
+        int n = 0;
+        for (size_t column = 0; column < n_columns; column++)
+        {
+            if (row[column] != NO_RULE)
+                columns[n++] = (int)column;
+        }
+
+        // Slots before first_free are all taken, so the first entry can not
+        // land before it
+        size_t base = first_free > (size_t)columns[0] ? first_free - columns[0] : 0;
+        for (;; base++)
+        {
+            if (base + n_columns > capacity)
+            {
+                reserve_cells(&cells, capacity, capacity * 2);
+                capacity *= 2;
+            }
+
+            int k = 0;
+            while (k < n && cells[base + columns[k]].row < 0)
+                k++;
+            if (k == n)
+                break;
+        }
+
+        for (int k = 0; k < n; k++)
+            cells[base + columns[k]] = (packed_cell){(int16_t)rows[i].row, (int16_t)row[columns[k]]};
+
+        bases[rows[i].row] = (int)base;
+        if (base > max_base)
+            max_base = base;
+
+        while (first_free < capacity && cells[first_free].row >= 0)
+            first_free++;
+    }
+
+    // Empty rows keep base 0, any slot they read names another row
+    size_t n_cells = max_base + n_columns;
+    free(rows);
+    free(columns);
+    clear_packed_table(parser);
+    parser->packed_base = bases;
+    parser->packed_cells = realloc(cells, (n_cells ? n_cells : 1) * sizeof(packed_cell));
+    parser->n_packed_cells = n_cells;
+    return true;
+}
+
+void clear_packed_table(parser *parser)
+{
+    free(parser->packed_base);
+    free(parser->packed_cells);
+    parser->packed_base = NULL;
+    parser->packed_cells = NULL;
+    parser->n_packed_cells = 0;
+}
+
+// Most entries first, ties by row so the layout does not depend on qsort
+int compare_rows(const void *a, const void *b)
+{
+    const packed_row *x = a, *y = b;
+    if (x->n_entries != y->n_entries)
+        return y->n_entries - x->n_entries;
+
+    return x->row - y->row;
+}
+
+bool fits_packed_cell(int value)
+{
+    return value >= INT16_MIN && value <= INT16_MAX;
+}
+
+void reserve_cells(packed_cell **cells, size_t count, size_t capacity)
+{
+    *cells = realloc(*cells, capacity * sizeof(packed_cell));
+    for (size_t i = count; i < capacity; i++)
+        (*cells)[i] = (packed_cell){-1, NO_RULE};
+}
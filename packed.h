@@ -0,0 +1,16 @@
+#ifndef PACKED_H
+#define PACKED_H
+
+#include "parser.h"
+
+// Packs the table of a built parser into packed_base and packed_cells by
+// row displacement. Rows are placed most entries first, each at the lowest
+// base where its entries only land on free slots. get_matching_rule reads
+// the packed table from then on, the dense one is kept for updates and
+// code generation. Returns false and leaves the parser as it was if row
+// ordinals or cell values do not fit a packed cell.
+bool pack_parse_table(parser *parser);
+// Goes back to reading the dense table
+void clear_packed_table(parser *parser);
+
+#endif
@@ -1,58 +1,178 @@
 #include "parser.h"
+#include "lookahead.h"
 #include <string.h>
 
-static void compute_nullable(parser *parser);
-static void compute_first(parser *parser);
-static void compute_follow(parser *parser);
+// Occurrences of each symbol in rule right hand sides, grouped by symbol
+typedef struct
+{
+    int *offsets;
+    int *rules;
+    int *positions;
+} symbol_uses;
+
+static void compute_nullable_iterative(parser *parser);
+static void compute_first_iterative(parser *parser);
+static void compute_follow_iterative(parser *parser);
+
+static void compute_nullable_worklist(parser *parser, const symbol_uses *uses);
+static void compute_first_worklist(parser *parser, const symbol_uses *uses);
+static void compute_follow_worklist(parser *parser);
+
+static void init_symbol_uses(symbol_uses *uses, const grammar *grammar);
+static void clear_symbol_uses(symbol_uses *uses);
+static void push_worklist(list *worklist, bool *queued, int symbol);
+static bool union_sets(parser *parser, uint64_t *dst, const uint64_t *src);
 
-static bool or_all(const bool *src, bool *dst, size_t n);
 static bool *create_bool_arr(size_t size);
+static void add_table_entry(parser *parser, const rule *rule, const symbol *terminal);
+static int *get_table_cell(const parser *parser, const symbol *nonterminal, const symbol *terminal);
 
-static rule *get_matching_rule(const parser *parser, const symbol *symbol, const char *token);
+static void init_driver_rules(parser *parser);
+static inline bool advance_stack(const parser *parser, list *stack, int token, const token_window *window,
+                                 parse_counters *counters);
+static void print_lookahead_node(const parser *parser, int node_index, list *path);
 
 void init_parser(parser *parser, const grammar *grammar)
 {
     parser->grammar = grammar;
-    parser->nullable_rules = create_bool_arr(grammar->rules.count);
-    parser->nullable_symbols = create_bool_arr(grammar->symbols.count);
+    parser->nullable_rules = create_bitset_arr(1, bitset_words(grammar->rules.count));
+    parser->nullable_symbols = create_bitset_arr(1, bitset_words(grammar->symbols.count));
+
+    // First and follow sets are bitsets over symbol ids
+    parser->set_words = bitset_words(grammar->symbols.count);
+    parser->rule_first_sets = create_bitset_arr(grammar->rules.count, parser->set_words);
+    parser->symbol_first_sets = create_bitset_arr(grammar->symbols.count, parser->set_words);
+    parser->symbol_follow_sets = create_bitset_arr(grammar->symbols.count, parser->set_words);
+    parser->strategy = ANALYSIS_WORKLIST;
+    parser->n_set_unions = 0;
+    init_parser_stats(&parser->stats);
+
+    parser->symbol_ordinals = malloc(grammar->symbols.count * sizeof(int));
+    parser->n_terminals = 0;
+    parser->n_nonterminals = 0;
+    for (size_t i = 0; i < grammar->symbols.count; i++)
+    {
+        symbol *symbol = get_list_element(&grammar->symbols, i);
+        if (symbol->type == TERMINAL)
+            parser->symbol_ordinals[symbol->id] = parser->n_terminals++;
+        else
+            parser->symbol_ordinals[symbol->id] = parser->n_nonterminals++;
+    }
 
-    parser->rule_first_sets = create_bool_arr(grammar->rules.count * grammar->symbols.count);
-    parser->symbol_first_sets = create_bool_arr(grammar->symbols.count * grammar->symbols.count);
-    parser->symbol_follow_sets = create_bool_arr(grammar->symbols.count * grammar->symbols.count);
+    size_t n_cells = parser->n_nonterminals * parser->n_terminals;
+    parser->table = malloc(n_cells * sizeof(int));
+    for (size_t i = 0; i < n_cells; i++)
+        parser->table[i] = NO_RULE;
 
-    parser->table = create_bool_arr(
-            grammar->symbols.count * grammar->symbols.count * grammar->rules.count);
+    init_list(&parser->conflicts, 0, sizeof(table_conflict));
+    parser->n_resolved_conflicts = 0;
+    parser->packed_base = NULL;
+    parser->packed_cells = NULL;
+    parser->n_packed_cells = 0;
+
+    parser->max_lookahead = 1;
+    parser->lookahead_depth = 1;
+    parser->n_lookahead_cells = 0;
+    init_list(&parser->lookahead_nodes, 0, sizeof(lookahead_node));
+    init_list(&parser->lookahead_edges, 0, sizeof(lookahead_edge));
+
+    parser->start_symbol = 0;
+    parser->end_symbol = -1;
+    parser->empty_symbol = -1;
+    parser->max_terminal_length = 0;
+    init_hash_table(&parser->terminals, parser->n_terminals);
+    for (size_t i = 0; i < grammar->symbols.count; i++)
+    {
+        symbol *symbol = get_list_element(&grammar->symbols, i);
+        if (symbol->type != TERMINAL)
+            continue;
+
+        // The empty and end symbols can never be matched by an input token
+        if (is_empty_symbol(grammar, symbol))
+            parser->empty_symbol = symbol->id;
+        else if (is_end_symbol(grammar, symbol))
+            parser->end_symbol = symbol->id;
+        else
+        {
+            hash_table_insert(&parser->terminals, symbol_name(grammar, symbol), symbol->name_length, symbol->id);
+            if (symbol->name_length > parser->max_terminal_length)
+                parser->max_terminal_length = symbol->name_length;
+        }
+    }
+
+    init_driver_rules(parser);
 }
 
-void compute_nullable(parser *parser)
+void init_driver_rules(parser *parser)
 {
-    // Start by saying that empty symbol is nullable
-    for (size_t i = 0; i < parser->grammar->symbols.count; i++)
+    const grammar *grammar = parser->grammar;
+
+    parser->terminal_symbols = create_bool_arr(grammar->symbols.count);
+    for (size_t i = 0; i < grammar->symbols.count; i++)
     {
-        symbol *symbol = get_list_element(&parser->grammar->symbols, i);
-        if (is_empty_symbol(symbol))
+        symbol *symbol = get_list_element(&grammar->symbols, i);
+        parser->terminal_symbols[symbol->id] = symbol->type == TERMINAL;
+    }
+
+    parser->rhs_symbols = NULL;
+    parser->rhs_offsets = NULL;
+    update_driver_rules(parser, 0);
+}
+
+void update_driver_rules(parser *parser, size_t first_rule)
+{
+    const grammar *grammar = parser->grammar;
+
+    // Rules before first_rule keep their place in rhs_symbols
+    int offset = first_rule > 0 ? parser->rhs_offsets[first_rule] : 0;
+    size_t n_rhs_symbols = offset;
+    for (size_t i = first_rule; i < grammar->rules.count; i++)
+    {
+        rule *rule = get_list_element(&grammar->rules, i);
+        n_rhs_symbols += rule->rhs.count;
+    }
+
+    parser->rhs_symbols = realloc(parser->rhs_symbols, (n_rhs_symbols + 1) * sizeof(int));
+    parser->rhs_offsets = realloc(parser->rhs_offsets, (grammar->rules.count + 1) * sizeof(int));
+
+    for (size_t i = first_rule; i < grammar->rules.count; i++)
+    {
+        rule *rule = get_list_element(&grammar->rules, i);
+        parser->rhs_offsets[rule->id] = offset;
+        for (int rhs_index = rule->rhs.count - 1; rhs_index >= 0; rhs_index--)
         {
-            parser->nullable_symbols[symbol->id] = true;
-            break;
+            symbol *rhs_symbol = *(symbol **)get_list_element(&rule->rhs, rhs_index);
+            if (rhs_symbol->id != parser->empty_symbol)
+                parser->rhs_symbols[offset++] = rhs_symbol->id;
         }
     }
 
+    parser->rhs_offsets[grammar->rules.count] = offset;
+}
+
+void compute_nullable_iterative(parser *parser)
+{
+    // Start by saying that empty symbol is nullable
+    if (parser->empty_symbol >= 0)
+        bitset_set(parser->nullable_symbols, parser->empty_symbol);
+
     size_t n_rules = parser->grammar->rules.count;
     bool changed;
     do
     {
+        STATS_ADD(&parser->stats, nullable_iterations, 1);
         changed = false;
         for (size_t rule_index = 0; rule_index < n_rules; rule_index++)
         {
             rule *rule = get_list_element(&parser->grammar->rules, rule_index);
-            if (!parser->nullable_rules[rule->id])
+            if (!bitset_test(parser->nullable_rules, rule->id))
             {
                 // Rule is nullable if all rhs symbols are nullable
                 bool nullable_rule = true;
                 for (size_t rhs_index = 0; rhs_index < rule->rhs.count; rhs_index++)
                 {
                     symbol *rhs_symbol = *(symbol **)get_list_element(&rule->rhs, rhs_index);
-                    if (!parser->nullable_symbols[rhs_symbol->id])
+                    if (!bitset_test(parser->nullable_symbols, rhs_symbol->id))
                     {
                         nullable_rule = false;
                         break;
@@ -61,8 +181,8 @@ void compute_nullable(parser *parser)
 
                 if (nullable_rule)
                 {
-                    parser->nullable_rules[rule->id] = true;
-                    parser->nullable_symbols[rule->lhs->id] = true;
+                    bitset_set(parser->nullable_rules, rule->id);
+                    bitset_set(parser->nullable_symbols, rule->lhs->id);
                     changed = true;
                 }
             }
@@ -70,9 +190,8 @@ void compute_nullable(parser *parser)
     } while (changed);
 }
 
-void compute_first(parser *parser)
+void compute_first_iterative(parser *parser)
 {
-    size_t n_symbols = parser->grammar->symbols.count;
     size_t n_rules = parser->grammar->rules.count;
 
     // Start by saying that all terminals contain themself in
@@ -80,51 +199,45 @@ void compute_first(parser *parser)
     for (size_t i = 0; i < parser->grammar->symbols.count; i++)
     {
         symbol *symbol = get_list_element(&parser->grammar->symbols, i);
-        if (symbol->type == TERMINAL && !is_empty_symbol(symbol))
-            parser->symbol_first_sets[symbol->id * n_symbols + symbol->id] = true;
+        if (symbol->type == TERMINAL && symbol->id != parser->empty_symbol)
+            bitset_set(get_symbol_first_set(parser, symbol->id), symbol->id);
     }
 
     bool changed;
     do
     {
+        STATS_ADD(&parser->stats, first_iterations, 1);
         changed = false;
         for (size_t rule_index = 0; rule_index < n_rules; rule_index++)
         {
             rule *rule = get_list_element(&parser->grammar->rules, rule_index);
+            uint64_t *rule_first_set = get_rule_first_set(parser, rule->id);
             for (size_t rhs_index = 0; rhs_index < rule->rhs.count; rhs_index++)
             {
                 // Add all elements from first set of production symbol
                 symbol *rhs_symbol = *(symbol **)get_list_element(&rule->rhs, rhs_index);
-                for (size_t symbol_index = 0; symbol_index < n_symbols; symbol_index++)
+                if (union_sets(parser, rule_first_set, get_symbol_first_set(parser, rhs_symbol->id)))
                 {
-                    size_t rhs_first_set_index = rhs_symbol->id * n_symbols + symbol_index;
-                    size_t rule_first_set_index = rule->id * n_symbols + symbol_index;
-
-                    if (parser->symbol_first_sets[rhs_first_set_index] &&
-                        !parser->rule_first_sets[rule_first_set_index])
-                    {
-                        parser->rule_first_sets[rule_first_set_index] = true;
-                        parser->symbol_first_sets[rule->lhs->id * n_symbols + symbol_index] = true;
-                        changed = true;
-                    }
+                    union_sets(parser, get_symbol_first_set(parser, rule->lhs->id), rule_first_set);
+                    changed = true;
                 }
 
                 // Only go to next production symbol if this one is nullable
-                if (!parser->nullable_symbols[rhs_symbol->id])
+                if (!bitset_test(parser->nullable_symbols, rhs_symbol->id))
                     break;
             }
         }
     } while (changed);
 }
 
-void compute_follow(parser *parser)
+void compute_follow_iterative(parser *parser)
 {
-    size_t n_symbols = parser->grammar->symbols.count;
     size_t n_rules = parser->grammar->rules.count;
 
     bool changed;
     do
     {
+        STATS_ADD(&parser->stats, follow_iterations, 1);
         changed = false;
         for (size_t rule_index = 0; rule_index < n_rules; rule_index++)
         {
@@ -136,19 +249,18 @@ void compute_follow(parser *parser)
                     continue;
 
                 symbol *next_rhs_symbol = *(symbol **)get_list_element(&rule->rhs, rhs_index + 1);
+                uint64_t *follow_set = get_symbol_follow_set(parser, rhs_symbol->id);
 
                 // Add all elements from first set of next symbol in production
-                if (or_all(parser->symbol_first_sets + next_rhs_symbol->id * n_symbols,
-                           parser->symbol_follow_sets + rhs_symbol->id * n_symbols, n_symbols))
+                if (union_sets(parser, follow_set, get_symbol_first_set(parser, next_rhs_symbol->id)))
                 {
                     changed = true;
                 }
 
                 // If the next symbol is nullable, add it's follow elements
-                if (parser->nullable_symbols[next_rhs_symbol->id])
+                if (bitset_test(parser->nullable_symbols, next_rhs_symbol->id))
                 {
-                    if (or_all(parser->symbol_follow_sets + next_rhs_symbol->id * n_symbols,
-                               parser->symbol_follow_sets + rhs_symbol->id * n_symbols, n_symbols))
+                    if (union_sets(parser, follow_set, get_symbol_follow_set(parser, next_rhs_symbol->id)))
                     {
                         changed = true;
                     }
@@ -160,8 +272,8 @@ void compute_follow(parser *parser)
             symbol *last_rhs_symbol = *(symbol **)get_list_element(&rule->rhs, rule->rhs.count - 1);
             if (last_rhs_symbol->type == NONTERMINAL)
             {
-                if (or_all(parser->symbol_follow_sets + rule->lhs->id * n_symbols,
-                           parser->symbol_follow_sets + last_rhs_symbol->id * n_symbols, n_symbols))
+                if (union_sets(parser, get_symbol_follow_set(parser, last_rhs_symbol->id),
+                               get_symbol_follow_set(parser, rule->lhs->id)))
                 {
                     changed = true;
                 }
@@ -170,149 +282,626 @@ void compute_follow(parser *parser)
     } while (changed);
 }
 
-void build_parse_table(parser *parser)
+void compute_nullable_worklist(parser *parser, const symbol_uses *uses)
 {
-    compute_nullable(parser);
-    compute_first(parser);
-    compute_follow(parser);
-
-    size_t n_symbols = parser->grammar->symbols.count;
     size_t n_rules = parser->grammar->rules.count;
 
+    // Number of rhs symbols of each rule that are not yet known to be nullable
+    int *remaining = malloc(n_rules * sizeof(int));
     for (size_t rule_index = 0; rule_index < n_rules; rule_index++)
     {
         rule *rule = get_list_element(&parser->grammar->rules, rule_index);
-        for (size_t symbol_index = 0; symbol_index < n_symbols; symbol_index++)
+        remaining[rule->id] = rule->rhs.count;
+    }
+
+    list worklist;
+    init_list(&worklist, 16, sizeof(int));
+
+    if (parser->empty_symbol >= 0)
+    {
+        bitset_set(parser->nullable_symbols, parser->empty_symbol);
+        int *empty = push_back(&worklist);
+        *empty = parser->empty_symbol;
+    }
+
+    // Every symbol enters the worklist once, when it becomes nullable
+    while (worklist.count > 0)
+    {
+        int symbol = *(int *)peek_back(&worklist);
+        pop_back(&worklist);
+        STATS_ADD(&parser->stats, nullable_iterations, 1);
+
+        for (int use = uses->offsets[symbol]; use < uses->offsets[symbol + 1]; use++)
         {
-            if (parser->rule_first_sets[rule->id * n_symbols + symbol_index])
+            int rule_id = uses->rules[use];
+            if (--remaining[rule_id] > 0)
+                continue;
+
+            rule *rule = get_list_element(&parser->grammar->rules, rule_id);
+            bitset_set(parser->nullable_rules, rule_id);
+            if (!bitset_test(parser->nullable_symbols, rule->lhs->id))
             {
-                parser->table[rule->lhs->id * n_symbols * n_rules + symbol_index * n_rules + rule->id] = true;
+                bitset_set(parser->nullable_symbols, rule->lhs->id);
+                int *lhs = push_back(&worklist);
+                *lhs = rule->lhs->id;
             }
         }
+    }
+
+    clear_list(&worklist);
+    free(remaining);
+}
 
-        if (parser->nullable_rules[rule->id])
+void compute_first_worklist(parser *parser, const symbol_uses *uses)
+{
+    size_t n_symbols = parser->grammar->symbols.count;
+
+    // A rule only depends on the rhs symbols up to its first non nullable one
+    int *prefix_ends = malloc(parser->grammar->rules.count * sizeof(int));
+    for (size_t rule_index = 0; rule_index < parser->grammar->rules.count; rule_index++)
+    {
+        rule *rule = get_list_element(&parser->grammar->rules, rule_index);
+        size_t rhs_index = 0;
+        while (rhs_index < rule->rhs.count - 1)
         {
-            for (size_t symbol_index = 0; symbol_index < n_symbols; symbol_index++)
-            {
-                if (parser->symbol_follow_sets[rule->lhs->id * n_symbols + symbol_index])
-                {
-                    parser->table[rule->lhs->id * n_symbols * n_rules + symbol_index * n_rules + rule->id] = true;
-                }
-            }
+            symbol *rhs_symbol = *(symbol **)get_list_element(&rule->rhs, rhs_index);
+            if (!bitset_test(parser->nullable_symbols, rhs_symbol->id))
+                break;
+
+            rhs_index++;
         }
+
+        prefix_ends[rule->id] = rhs_index;
     }
+
+    list worklist;
+    init_list(&worklist, 16, sizeof(int));
+    bool *queued = create_bool_arr(n_symbols);
+
+    for (size_t i = 0; i < n_symbols; i++)
+    {
+        symbol *symbol = get_list_element(&parser->grammar->symbols, i);
+        if (symbol->type == TERMINAL && symbol->id != parser->empty_symbol)
+        {
+            bitset_set(get_symbol_first_set(parser, symbol->id), symbol->id);
+            push_worklist(&worklist, queued, symbol->id);
+        }
+    }
+
+    // Symbols are revisited only when their first set has grown
+    while (worklist.count > 0)
+    {
+        int symbol = *(int *)peek_back(&worklist);
+        pop_back(&worklist);
+        queued[symbol] = false;
+        STATS_ADD(&parser->stats, first_iterations, 1);
+
+        for (int use = uses->offsets[symbol]; use < uses->offsets[symbol + 1]; use++)
+        {
+            int rule_id = uses->rules[use];
+            if (uses->positions[use] > prefix_ends[rule_id])
+                continue;
+
+            uint64_t *rule_first_set = get_rule_first_set(parser, rule_id);
+            if (!union_sets(parser, rule_first_set, get_symbol_first_set(parser, symbol)))
+                continue;
+
+            rule *rule = get_list_element(&parser->grammar->rules, rule_id);
+            if (union_sets(parser, get_symbol_first_set(parser, rule->lhs->id), rule_first_set))
+                push_worklist(&worklist, queued, rule->lhs->id);
+        }
+    }
+
+    free(queued);
+    clear_list(&worklist);
+    free(prefix_ends);
 }
 
-bool is_valid_grammar(const parser *parser)
+void compute_follow_worklist(parser *parser)
 {
     size_t n_symbols = parser->grammar->symbols.count;
     size_t n_rules = parser->grammar->rules.count;
-    for (size_t row = 0; row < n_symbols; row++)
-    {
-        symbol *row_symbol = get_list_element(&parser->grammar->symbols, row);
-        if (row_symbol->type == TERMINAL)
-            continue;
 
-        for (size_t col = 0; col < n_symbols; col++)
+    // Edge a -> b means that follow(b) contains follow(a)
+    list edges;
+    init_list(&edges, 16, 2 * sizeof(int));
+
+    for (size_t rule_index = 0; rule_index < n_rules; rule_index++)
+    {
+        rule *rule = get_list_element(&parser->grammar->rules, rule_index);
+        for (size_t rhs_index = 0; rhs_index < rule->rhs.count - 1; rhs_index++)
         {
-            symbol *col_symbol = get_list_element(&parser->grammar->symbols, col);
-            if (col_symbol->type == NONTERMINAL)
+            symbol *rhs_symbol = *(symbol **)get_list_element(&rule->rhs, rhs_index);
+            if (rhs_symbol->type == TERMINAL)
                 continue;
 
-            bool has_entry = false;
-            for (size_t rule_index = 0; rule_index < n_rules; rule_index++)
+            // The first set of the next symbol does not change anymore, so
+            // it only has to be added once
+            symbol *next_rhs_symbol = *(symbol **)get_list_element(&rule->rhs, rhs_index + 1);
+            union_sets(parser, get_symbol_follow_set(parser, rhs_symbol->id),
+                       get_symbol_first_set(parser, next_rhs_symbol->id));
+
+            if (bitset_test(parser->nullable_symbols, next_rhs_symbol->id))
             {
+                int *edge = new_list_element(&edges);
+                edge[0] = next_rhs_symbol->id;
+                edge[1] = rhs_symbol->id;
+            }
+        }
 
-                if (parser->table[row * n_symbols * n_rules + col * n_rules + rule_index])
-                {
-                    if (has_entry)
-                        return false;
+        symbol *last_rhs_symbol = *(symbol **)get_list_element(&rule->rhs, rule->rhs.count - 1);
+        if (last_rhs_symbol->type == NONTERMINAL)
+        {
+            int *edge = new_list_element(&edges);
+            edge[0] = rule->lhs->id;
+            edge[1] = last_rhs_symbol->id;
+        }
+    }
 
-                    has_entry = true;
-                }
-            }
+    // Group edges by source symbol
+    int *edge_offsets = calloc(n_symbols + 1, sizeof(int));
+    int *edge_targets = malloc((edges.count + 1) * sizeof(int));
+    for (size_t i = 0; i < edges.count; i++)
+    {
+        int *edge = get_list_element(&edges, i);
+        edge_offsets[edge[0] + 1]++;
+    }
+
+    for (size_t i = 0; i < n_symbols; i++)
+        edge_offsets[i + 1] += edge_offsets[i];
+
+    int *fill = malloc((n_symbols + 1) * sizeof(int));
+    memcpy(fill, edge_offsets, (n_symbols + 1) * sizeof(int));
+    for (size_t i = 0; i < edges.count; i++)
+    {
+        int *edge = get_list_element(&edges, i);
+        edge_targets[fill[edge[0]]++] = edge[1];
+    }
+
+    list worklist;
+    init_list(&worklist, 16, sizeof(int));
+    bool *queued = create_bool_arr(n_symbols);
+    for (size_t i = 0; i < n_symbols; i++)
+        push_worklist(&worklist, queued, i);
+
+    while (worklist.count > 0)
+    {
+        int symbol = *(int *)peek_back(&worklist);
+        pop_back(&worklist);
+        queued[symbol] = false;
+        STATS_ADD(&parser->stats, follow_iterations, 1);
+
+        for (int edge = edge_offsets[symbol]; edge < edge_offsets[symbol + 1]; edge++)
+        {
+            int target = edge_targets[edge];
+            if (union_sets(parser, get_symbol_follow_set(parser, target), get_symbol_follow_set(parser, symbol)))
+                push_worklist(&worklist, queued, target);
         }
     }
 
-    return true;
+    free(queued);
+    clear_list(&worklist);
+    free(fill);
+    free(edge_targets);
+    free(edge_offsets);
+    clear_list(&edges);
 }
 
-bool is_valid_string(const parser *parser, const char *str)
+void init_symbol_uses(symbol_uses *uses, const grammar *grammar)
 {
-    list stack;
-    init_list(&stack, 16, sizeof(symbol*));
+    size_t n_symbols = grammar->symbols.count;
+    size_t n_uses = 0;
 
-    // Add starting symbol to stack
-    symbol **start_sym = new_list_element(&stack);
-    *start_sym = get_list_element(&parser->grammar->symbols, 0);
+    uses->offsets = calloc(n_symbols + 1, sizeof(int));
+    for (size_t rule_index = 0; rule_index < grammar->rules.count; rule_index++)
+    {
+        rule *rule = get_list_element(&grammar->rules, rule_index);
+        for (size_t rhs_index = 0; rhs_index < rule->rhs.count; rhs_index++)
+        {
+            symbol *rhs_symbol = *(symbol **)get_list_element(&rule->rhs, rhs_index);
+            uses->offsets[rhs_symbol->id + 1]++;
+            n_uses++;
+        }
+    }
+
+    for (size_t i = 0; i < n_symbols; i++)
+        uses->offsets[i + 1] += uses->offsets[i];
 
-    char *token = strdup(str);
-    char *token_ref = token;
-    strtok(token, " ");
+    uses->rules = malloc((n_uses + 1) * sizeof(int));
+    uses->positions = malloc((n_uses + 1) * sizeof(int));
 
-    while (token || stack.count > 0)
+    int *fill = malloc((n_symbols + 1) * sizeof(int));
+    memcpy(fill, uses->offsets, (n_symbols + 1) * sizeof(int));
+    for (size_t rule_index = 0; rule_index < grammar->rules.count; rule_index++)
     {
-        symbol *sym = *(symbol**)get_list_element(&stack, 0);
-        if (sym->type == TERMINAL)
+        rule *rule = get_list_element(&grammar->rules, rule_index);
+        for (size_t rhs_index = 0; rhs_index < rule->rhs.count; rhs_index++)
         {
-            if (!is_empty_symbol(sym) && !is_end_symbol(sym))
-            {
-                if (!token || strcmp(sym->name, token) != 0)
-                {
-                    break;
-                }
+            symbol *rhs_symbol = *(symbol **)get_list_element(&rule->rhs, rhs_index);
+            int use = fill[rhs_symbol->id]++;
+            uses->rules[use] = rule->id;
+            uses->positions[use] = rhs_index;
+        }
+    }
 
-                token = strtok(NULL, " ");
-            }
+    free(fill);
+}
+
+void clear_symbol_uses(symbol_uses *uses)
+{
+    free(uses->offsets);
+    free(uses->rules);
+    free(uses->positions);
+}
+
+void push_worklist(list *worklist, bool *queued, int symbol)
+{
+    if (queued[symbol])
+        return;
+
+    queued[symbol] = true;
+    int *entry = push_back(worklist);
+    *entry = symbol;
+}
+
+bool union_sets(parser *parser, uint64_t *dst, const uint64_t *src)
+{
+    parser->n_set_unions++;
+    return bitset_union(dst, src, parser->set_words);
+}
+
+void build_parse_table(parser *parser)
+{
+    parser_stats *stats = &parser->stats;
+    uint64_t start = stats_now();
+    if (parser->strategy == ANALYSIS_ITERATIVE)
+    {
+        compute_nullable_iterative(parser);
+        stats->nullable_time = stats_now() - start;
+        start += stats->nullable_time;
+        compute_first_iterative(parser);
+        stats->first_time = stats_now() - start;
+        start += stats->first_time;
+        compute_follow_iterative(parser);
+        stats->follow_time = stats_now() - start;
+        start += stats->follow_time;
+    }
+    else
+    {
+        // Building the use index is counted as part of the nullable pass
+        symbol_uses uses;
+        init_symbol_uses(&uses, parser->grammar);
+        compute_nullable_worklist(parser, &uses);
+        stats->nullable_time = stats_now() - start;
+        start += stats->nullable_time;
+        compute_first_worklist(parser, &uses);
+        stats->first_time = stats_now() - start;
+        start += stats->first_time;
+        compute_follow_worklist(parser);
+        stats->follow_time = stats_now() - start;
+        start += stats->follow_time;
+        clear_symbol_uses(&uses);
+    }
 
-            pop_front(&stack);
+    size_t n_rules = parser->grammar->rules.count;
+
+    for (size_t rule_index = 0; rule_index < n_rules; rule_index++)
+    {
+        rule *rule = get_list_element(&parser->grammar->rules, rule_index);
+        add_table_entries(parser, rule, get_rule_first_set(parser, rule->id));
+
+        if (bitset_test(parser->nullable_rules, rule->id))
+        {
+            add_table_entries(parser, rule, get_symbol_follow_set(parser, rule->lhs->id));
         }
-        else
+    }
+
+    if (parser->max_lookahead > 1 && parser->conflicts.count > 0)
+        build_lookahead_tries(parser);
+
+    stats->table_time = stats_now() - start;
+}
+
+void add_table_entries(parser *parser, const rule *rule, const uint64_t *terminals)
+{
+    size_t n_symbols = parser->grammar->symbols.count;
+    for (size_t symbol_index = bitset_next(terminals, parser->set_words, 0); symbol_index < n_symbols;
+         symbol_index = bitset_next(terminals, parser->set_words, symbol_index + 1))
+    {
+        add_table_entry(parser, rule, get_list_element(&parser->grammar->symbols, symbol_index));
+    }
+}
+
+void add_table_entry(parser *parser, const rule *rule, const symbol *terminal)
+{
+    // First and follow sets only contain terminals
+    STATS_ADD(&parser->stats, table_entries, 1);
+    int *cell = get_table_cell(parser, rule->lhs, terminal);
+    if (*cell == rule->id)
+        return;
+
+    if (*cell == NO_RULE)
+    {
+        *cell = rule->id;
+        return;
+    }
+
+    int nonterminal_ordinal = parser->symbol_ordinals[rule->lhs->id];
+    int terminal_ordinal = parser->symbol_ordinals[terminal->id];
+
+    if (*cell != CONFLICT_RULE)
+    {
+        // Move the rule that was already in the cell to the conflict list
+        table_conflict *first = new_list_element(&parser->conflicts);
+        first->nonterminal = nonterminal_ordinal;
+        first->terminal = terminal_ordinal;
+        first->rule = *cell;
+        *cell = CONFLICT_RULE;
+    }
+    else
+    {
+        // A rule can reach the same cell through both its first set and
+        // the follow set of its lhs
+        for (size_t i = 0; i < parser->conflicts.count; i++)
         {
-            rule *rule;
-            if (token)
-                rule = get_matching_rule(parser, sym, token);
-            else
-                rule = get_matching_rule(parser, sym, "$");
+            table_conflict *conflict = get_list_element(&parser->conflicts, i);
+            if (conflict->nonterminal == nonterminal_ordinal && conflict->terminal == terminal_ordinal &&
+                conflict->rule == rule->id)
+                return;
+        }
+    }
+
+    table_conflict *conflict = new_list_element(&parser->conflicts);
+    conflict->nonterminal = nonterminal_ordinal;
+    conflict->terminal = terminal_ordinal;
+    conflict->rule = rule->id;
+}
+
+int *get_table_cell(const parser *parser, const symbol *nonterminal, const symbol *terminal)
+{
+    return parser->table + parser->symbol_ordinals[nonterminal->id] * parser->n_terminals +
+           parser->symbol_ordinals[terminal->id];
+}
+
+bool is_valid_grammar(const parser *parser)
+{
+    return parser->conflicts.count == 0;
+}
+
+size_t resolve_follow_conflicts(parser *parser)
+{
+    size_t n_symbols = parser->n_terminals + parser->n_nonterminals;
+    int *terminal_ids = malloc(parser->n_terminals * sizeof(int));
+    for (size_t i = 0; i < n_symbols; i++)
+    {
+        if (parser->terminal_symbols[i])
+            terminal_ids[parser->symbol_ordinals[i]] = i;
+    }
 
-            if (!rule) break;
+    // Cells are visited at their first conflict entry
+    size_t n_resolved = 0;
+    for (size_t i = 0; i < parser->conflicts.count; i++)
+    {
+        const table_conflict *conflict = get_list_element(&parser->conflicts, i);
+        int *cell = parser->table + conflict->nonterminal * parser->n_terminals + conflict->terminal;
+        if (*cell != CONFLICT_RULE)
+            continue;
 
-            pop_front(&stack);
-            for (int rhs_index = rule->rhs.count - 1; rhs_index >= 0; rhs_index--)
+        int terminal = terminal_ids[conflict->terminal];
+        int consuming_rule = NO_RULE;
+        size_t n_consuming = 0;
+        for (size_t j = i; j < parser->conflicts.count; j++)
+        {
+            const table_conflict *other = get_list_element(&parser->conflicts, j);
+            if (other->nonterminal == conflict->nonterminal && other->terminal == conflict->terminal &&
+                bitset_test(get_rule_first_set(parser, other->rule), terminal))
             {
-                symbol **new_sym = push_front(&stack);
-                *new_sym = *(symbol**)get_list_element(&rule->rhs, rhs_index);
+                consuming_rule = other->rule;
+                n_consuming++;
             }
         }
+
+        if (n_consuming == 1)
+        {
+            *cell = consuming_rule;
+            n_resolved++;
+        }
     }
 
-    bool success = !token && stack.count == 0;
+    // Entries of resolved cells are dropped
+    size_t n_kept = 0;
+    for (size_t i = 0; i < parser->conflicts.count; i++)
+    {
+        table_conflict *conflict = get_list_element(&parser->conflicts, i);
+        if (parser->table[conflict->nonterminal * parser->n_terminals + conflict->terminal] == CONFLICT_RULE)
+            *(table_conflict *)get_list_element(&parser->conflicts, n_kept++) = *conflict;
+    }
+
+    parser->conflicts.count = n_kept;
+    parser->n_resolved_conflicts += n_resolved;
+    free(terminal_ids);
+    return n_resolved;
+}
+
+int find_terminal(const parser *parser, const char *token, size_t length)
+{
+    return hash_table_find(&parser->terminals, token, length);
+}
+
+bool tokenize_string(const parser *parser, const char *str, list *tokens)
+{
+    return tokenize_span(parser, str, strlen(str), tokens);
+}
+
+bool tokenize_span(const parser *parser, const char *str, size_t length, list *tokens)
+{
+    const char *c = str;
+    const char *end = str + length;
+    while (c < end)
+    {
+        if (is_token_separator(*c))
+        {
+            c++;
+            continue;
+        }
+
+        const char *token = c;
+        while (c < end && !is_token_separator(*c))
+            c++;
+
+        int id = find_terminal(parser, token, c - token);
+        if (id == HASH_TABLE_MISSING)
+            return false;
+
+        int *new_token = new_list_element(tokens);
+        *new_token = id;
+    }
+
+    return true;
+}
+
+bool is_valid_string(const parser *parser, const char *str)
+{
+    parse_context context;
+    init_parse_context(&context);
+
+    bool success = validate_span(parser, &context, str, strlen(str));
+
+    clear_parse_context(&context);
+
+    return success;
+}
+
+bool is_valid_tokens(const parser *parser, const int *tokens, size_t n_tokens)
+{
+    list stack;
+    init_list(&stack, 16, sizeof(int));
+
+    bool success = validate_tokens(parser, &stack, tokens, n_tokens);
 
-    free(token_ref);
     clear_list(&stack);
 
     return success;
 }
 
-rule *get_matching_rule(const parser *parser, const symbol *symbol, const char *token)
+bool validate_tokens(const parser *parser, list *stack, const int *tokens, size_t n_tokens)
 {
-    size_t n_symbols = parser->grammar->symbols.count;
-    size_t n_rules = parser->grammar->rules.count;
+    reset_parse_stack(parser, stack);
 
-    const struct symbol *token_symbol = find_symbol(parser->grammar, token);
-    if (token_symbol)
+    parse_counters counters = {0};
+    token_window window = {tokens, SIZE_MAX, 0, n_tokens};
+    bool success = true;
+    for (size_t token_index = 0; token_index < n_tokens && success; token_index++)
     {
-        for (size_t rule_index = 0; rule_index < n_rules; rule_index++)
+        window.start = token_index;
+        window.count = n_tokens - token_index;
+        success = advance_stack(parser, stack, tokens[token_index], &window, &counters);
+    }
+
+    // Past the last token the input is at the end symbol
+    window.count = 0;
+    success = success && advance_stack(parser, stack, parser->end_symbol, &window, &counters) && stack->count == 0;
+    STATS_RECORD_PARSE(&parser->stats, &counters);
+    return success;
+}
+
+void init_parse_context(parse_context *context)
+{
+    init_list(&context->stack, 16, sizeof(int));
+    init_list(&context->tokens, 16, sizeof(int));
+}
+
+bool validate_span(const parser *parser, parse_context *context, const char *str, size_t length)
+{
+    context->tokens.count = 0;
+    return tokenize_span(parser, str, length, &context->tokens) &&
+           validate_tokens(parser, &context->stack, context->tokens.head, context->tokens.count);
+}
+
+void clear_parse_context(parse_context *context)
+{
+    clear_list(&context->stack);
+    clear_list(&context->tokens);
+}
+
+void init_parse_stack(const parser *parser, list *stack)
+{
+    init_list(stack, 16, sizeof(int));
+    reset_parse_stack(parser, stack);
+}
+
+void reset_parse_stack(const parser *parser, list *stack)
+{
+    // Add starting symbol to stack
+    stack->count = 0;
+    int *start_sym = push_back(stack);
+    *start_sym = parser->start_symbol;
+    STATS_COUNT_PARSE(&parser->stats);
+}
+
+bool parse_token(const parser *parser, list *stack, int token)
+{
+    parse_counters counters = {0};
+    bool success = advance_stack(parser, stack, token, NULL, &counters);
+    STATS_RECORD_PARSE(&parser->stats, &counters);
+    return success;
+}
+
+bool parse_window(const parser *parser, list *stack, const token_window *window)
+{
+    parse_counters counters = {0};
+    bool success = advance_stack(parser, stack, get_window_token(parser, window, 0), window, &counters);
+    STATS_RECORD_PARSE(&parser->stats, &counters);
+    return success;
+}
+
+bool advance_stack(const parser *parser, list *stack, int token, const token_window *window,
+                   parse_counters *counters)
+{
+    STATS_ADD(counters, tokens, 1);
+
+    // Expand nonterminals until the token can be matched with a terminal
+    while (stack->count > 0)
+    {
+        int sym = *(int *)peek_back(stack);
+        if (parser->terminal_symbols[sym])
         {
-            if (parser->table[symbol->id * n_symbols * n_rules +
-                    token_symbol->id * n_rules + rule_index])
+            if (sym != token)
             {
-                return get_list_element(&parser->grammar->rules, rule_index);
+                return false;
             }
+
+            STATS_ADD(counters, terminal_matches, 1);
+            pop_back(stack);
+            return true;
         }
+
+        STATS_ADD(counters, table_lookups, 1);
+        int rule_index = get_matching_rule(parser, sym, token);
+        if (rule_index < 0)
+        {
+            // Cells that need more lookahead can only be decided with a window
+            if (rule_index > LOOKAHEAD_CELL(0) || !window)
+                return false;
+
+            rule_index = find_lookahead_rule(parser, rule_index, window);
+            if (rule_index < 0)
+                return false;
+        }
+
+        STATS_ADD(counters, expansions, 1);
+        pop_back(stack);
+        int rhs_offset = parser->rhs_offsets[rule_index];
+        push_back_many(stack, parser->rhs_symbols + rhs_offset, parser->rhs_offsets[rule_index + 1] - rhs_offset);
+        STATS_MAX(counters, max_stack_depth, stack->count);
     }
 
-    return NULL;
+    return false;
+}
+
+bool is_token_separator(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
 }
 
 void clear_parser(parser *parser)
@@ -322,22 +911,17 @@ void clear_parser(parser *parser)
     free(parser->rule_first_sets);
     free(parser->symbol_first_sets);
     free(parser->symbol_follow_sets);
+    free(parser->symbol_ordinals);
     free(parser->table);
-}
-
-bool or_all(const bool *src, bool *dst, size_t n)
-{
-    bool changed = false;
-    for (size_t i = 0; i < n; i++)
-    {
-        if (src[i] && !dst[i])
-        {
-            dst[i] = true;
-            changed = true;
-        }
-    }
-
-    return changed;
+    free(parser->packed_base);
+    free(parser->packed_cells);
+    clear_list(&parser->conflicts);
+    clear_list(&parser->lookahead_nodes);
+    clear_list(&parser->lookahead_edges);
+    clear_hash_table(&parser->terminals);
+    free(parser->terminal_symbols);
+    free(parser->rhs_symbols);
+    free(parser->rhs_offsets);
 }
 
 bool *create_bool_arr(size_t size)
@@ -347,13 +931,28 @@ bool *create_bool_arr(size_t size)
     return arr;
 }
 
-void print_rule(const rule *rule)
+uint64_t *get_rule_first_set(const parser *parser, int rule)
+{
+    return parser->rule_first_sets + rule * parser->set_words;
+}
+
+uint64_t *get_symbol_first_set(const parser *parser, int symbol)
+{
+    return parser->symbol_first_sets + symbol * parser->set_words;
+}
+
+uint64_t *get_symbol_follow_set(const parser *parser, int symbol)
+{
+    return parser->symbol_follow_sets + symbol * parser->set_words;
+}
+
+void print_rule(const grammar *grammar, const rule *rule)
 {
-    printf("\t%s ::=", rule->lhs->name);
+    printf("\t%s ::=", symbol_name(grammar, rule->lhs));
     for (size_t j = 0; j < rule->rhs.count; j++)
     {
         symbol *rhs_symbol = *(symbol **)get_list_element(&rule->rhs, j);
-        printf(" %s", rhs_symbol->name);
+        printf(" %s", symbol_name(grammar, rhs_symbol));
     }
 }
 
@@ -364,7 +963,7 @@ void print_rules(const parser *parser)
     for (size_t i = 0; i < grammar->rules.count; i++)
     {
         rule *rule = get_list_element(&grammar->rules, i);
-        print_rule(rule);
+        print_rule(grammar, rule);
         putc('\n', stdout);
     }
 }
@@ -376,26 +975,26 @@ void print_symbols(const parser *parser)
     for (size_t i = 0; i < grammar->symbols.count; i++)
     {
         symbol *symbol = get_list_element(&grammar->symbols, i);
-        printf("\tName: %s\n", symbol->name);
+        printf("\tName: %s\n", symbol_name(grammar, symbol));
         printf("\t\tType: %s\n", symbol->type == TERMINAL ? "terminal" : "nonterminal");
-        printf("\t\tNullable: %d\n", parser->nullable_symbols[symbol->id]);
+        printf("\t\tNullable: %d\n", bitset_test(parser->nullable_symbols, symbol->id));
         printf("\t\tFirst:");
         for (size_t first_index = 0; first_index < grammar->symbols.count; first_index++)
         {
-            if (parser->symbol_first_sets[symbol->id * grammar->symbols.count + first_index])
+            if (bitset_test(get_symbol_first_set(parser, symbol->id), first_index))
             {
                 struct symbol *first_symbol = get_list_element(&grammar->symbols, first_index);
-                printf(" %s", first_symbol->name);
+                printf(" %s", symbol_name(grammar, first_symbol));
             }
         }
 
         printf("\n\t\tFollow:");
         for (size_t follow_index = 0; follow_index < grammar->symbols.count; follow_index++)
         {
-            if (parser->symbol_follow_sets[symbol->id * grammar->symbols.count + follow_index])
+            if (bitset_test(get_symbol_follow_set(parser, symbol->id), follow_index))
             {
                 struct symbol *follow_symbol = get_list_element(&grammar->symbols, follow_index);
-                printf(" %s", follow_symbol->name);
+                printf(" %s", symbol_name(grammar, follow_symbol));
             }
         }
         putc('\n', stdout);
@@ -406,7 +1005,6 @@ void print_symbols(const parser *parser)
 void print_table(const parser *parser)
 {
     size_t n_symbols = parser->grammar->symbols.count;
-    size_t n_rules = parser->grammar->rules.count;
 
     printf("Table:\n");
 
@@ -415,23 +1013,70 @@ void print_table(const parser *parser)
         const symbol *row_symbol = get_list_element(&parser->grammar->symbols, row);
         if (row_symbol->type != NONTERMINAL) continue;
 
-        printf("\t%s:\n", row_symbol->name);
+        printf("\t%s:\n", symbol_name(parser->grammar, row_symbol));
         for (size_t col = 0; col < n_symbols; col++)
         {
             const symbol *col_symbol = get_list_element(&parser->grammar->symbols, col);
             if (col_symbol->type != TERMINAL) continue;
 
-            printf("\t\t%s: ", col_symbol->name);
-            for (size_t rule_index = 0; rule_index < n_rules; rule_index++)
+            printf("\t\t%s: ", symbol_name(parser->grammar, col_symbol));
+            int rule_index = *get_table_cell(parser, row_symbol, col_symbol);
+            if (rule_index >= 0)
+            {
+                print_rule(parser->grammar, get_list_element(&parser->grammar->rules, rule_index));
+                putc(' ', stdout);
+            }
+            else if (rule_index == CONFLICT_RULE)
             {
-                if (parser->table[row * n_symbols * n_rules + col * n_rules + rule_index])
+                for (size_t i = 0; i < parser->conflicts.count; i++)
                 {
-                    print_rule(get_list_element(&parser->grammar->rules, rule_index));
-                    putc(' ', stdout);
+                    table_conflict *conflict = get_list_element(&parser->conflicts, i);
+                    if (conflict->nonterminal == parser->symbol_ordinals[row_symbol->id] &&
+                        conflict->terminal == parser->symbol_ordinals[col_symbol->id])
+                    {
+                        print_rule(parser->grammar, get_list_element(&parser->grammar->rules, conflict->rule));
+                        putc(' ', stdout);
+                    }
                 }
             }
+            else if (rule_index <= LOOKAHEAD_CELL(0))
+            {
+                list path;
+                init_list(&path, MAX_LOOKAHEAD, sizeof(int));
+                print_lookahead_node(parser, LOOKAHEAD_NODE(rule_index), &path);
+                clear_list(&path);
+            }
 
             putc('\n', stdout);
         }
     }
 }
+
+// Prints the rule of every decided node under node_index, after the tokens
+// that lead to it
+void print_lookahead_node(const parser *parser, int node_index, list *path)
+{
+    const lookahead_node *node = get_list_element(&parser->lookahead_nodes, node_index);
+    if (node->n_edges == 0)
+    {
+        putc('[', stdout);
+        for (size_t i = 0; i < path->count; i++)
+        {
+            const symbol *token = get_list_element(&parser->grammar->symbols, ((int *)path->head)[i]);
+            printf(i == 0 ? "%s" : " %s", symbol_name(parser->grammar, token));
+        }
+
+        printf("]");
+        print_rule(parser->grammar, get_list_element(&parser->grammar->rules, node->rule));
+        putc(' ', stdout);
+        return;
+    }
+
+    for (int i = 0; i < node->n_edges; i++)
+    {
+        const lookahead_edge *edge = get_list_element(&parser->lookahead_edges, node->first_edge + i);
+        *(int *)push_back(path) = edge->token;
+        print_lookahead_node(parser, edge->node, path);
+        pop_back(path);
+    }
+}
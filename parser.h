@@ -2,25 +2,181 @@
 #define PARSER_H
 
 #include <stdlib.h>
+#include "bitset.h"
 #include "grammar.h"
+#include "hash_table.h"
+#include "stats.h"
+
+// Parse table cell values that do not name a rule
+#define NO_RULE -1
+#define CONFLICT_RULE -2
+// Cells that need more than one token of lookahead hold the root node of
+// their lookahead trie, below CONFLICT_RULE
+#define LOOKAHEAD_CELL(node) (-3 - (node))
+#define LOOKAHEAD_NODE(cell) (-3 - (cell))
+// Longest lookahead a trie can use, a power of two so stream buffers can
+// wrap with a mask
+#define MAX_LOOKAHEAD 8
+
+// How the nullable, first and follow fixpoints are computed. Iterative
+// reruns every rule until nothing changes, worklist only revisits the
+// dependents of sets that changed.
+typedef enum
+{
+    ANALYSIS_ITERATIVE,
+    ANALYSIS_WORKLIST
+} analysis_strategy;
+
+typedef struct
+{
+    int nonterminal;
+    int terminal;
+    int rule;
+} table_conflict;
+
+// Slot of the packed table, the cell of row at the slot's offset from the
+// row's base. Both fit in 16 bits so a lookup reads one 4 byte slot.
+typedef struct
+{
+    int16_t row;
+    int16_t rule;
+} packed_cell;
 
 typedef struct
 {
     const grammar *grammar;
-    bool *nullable_rules;
-    bool *nullable_symbols;
-    bool *rule_first_sets;
-    bool *symbol_first_sets;
-    bool *symbol_follow_sets;
-    bool *table;
+    uint64_t *nullable_rules;
+    uint64_t *nullable_symbols;
+
+    // Packed sets of symbol ids, set_words words per rule or symbol
+    size_t set_words;
+    uint64_t *rule_first_sets;
+    uint64_t *symbol_first_sets;
+    uint64_t *symbol_follow_sets;
+
+    analysis_strategy strategy;
+    size_t n_set_unions;
+
+    // Build timings and, with LL1_STATS, counters summed over every parse
+    parser_stats stats;
+
+    // Dense ordinal of each symbol among the terminals or nonterminals
+    size_t n_terminals;
+    size_t n_nonterminals;
+    int *symbol_ordinals;
+
+    // One rule index per nonterminal x terminal cell, conflicting cells
+    // have all their rules listed in conflicts
+    int *table;
+    list conflicts;
+    size_t n_resolved_conflicts;
+
+    // Optional row displacement form of the table, read by the driver in
+    // its place. Row r starts at packed_base[r] and a slot only belongs to
+    // the row it names, so rows fill each other's empty cells.
+    int *packed_base;
+    packed_cell *packed_cells;
+    size_t n_packed_cells;
+
+    // Tokens of lookahead build_parse_table may use for conflicting cells,
+    // the most any cell ended up needing and the cells that needed more than
+    // one. Trie nodes and edges are only added for those cells.
+    size_t max_lookahead;
+    size_t lookahead_depth;
+    size_t n_lookahead_cells;
+    list lookahead_nodes;
+    list lookahead_edges;
+
+    // Maps input token names to terminal symbol ids
+    hash_table terminals;
+    size_t max_terminal_length;
+    int start_symbol;
+    int end_symbol;
+    int empty_symbol;
+
+    // Driver view of the grammar: rule rhs ids are stored reversed, without
+    // empty symbols, so they can be pushed onto the stack in one copy
+    bool *terminal_symbols;
+    int *rhs_symbols;
+    int *rhs_offsets;
 } parser;
 
+// Buffers used while validating, one per thread. The parser itself is only
+// read during validation, so it can be shared between threads.
+typedef struct
+{
+    list stack;
+    list tokens;
+} parse_context;
+
 void init_parser(parser *parser, const grammar *grammar);
 void build_parse_table(parser *parser);
 bool is_valid_grammar(const parser *parser);
+// Settles conflicting cells where one rule has the terminal in its first set
+// and the others only reach the cell through the follow set of their lhs,
+// in favour of the rule that consumes the terminal. This is how an else
+// binds to the nearest if. It makes ambiguous grammars deterministic, but on
+// grammars that need more lookahead it rejects strings that are valid.
+size_t resolve_follow_conflicts(parser *parser);
+int find_terminal(const parser *parser, const char *token, size_t length);
+bool tokenize_string(const parser *parser, const char *str, list *tokens);
+bool tokenize_span(const parser *parser, const char *str, size_t length, list *tokens);
+bool is_valid_tokens(const parser *parser, const int *tokens, size_t n_tokens);
 bool is_valid_string(const parser *parser, const char *str);
+bool is_token_separator(char c);
+
+// Input seen by the driver, token i is tokens[(start + i) & mask] and past
+// count the input is at the end symbol. Arrays use a mask with every bit set.
+typedef struct
+{
+    const int *tokens;
+    size_t mask;
+    size_t start;
+    size_t count;
+} token_window;
+
+void init_parse_context(parse_context *context);
+bool validate_tokens(const parser *parser, list *stack, const int *tokens, size_t n_tokens);
+bool validate_span(const parser *parser, parse_context *context, const char *str, size_t length);
+void clear_parse_context(parse_context *context);
+
+// Incremental driver, parse_token advances the stack past one token
+void init_parse_stack(const parser *parser, list *stack);
+void reset_parse_stack(const parser *parser, list *stack);
+bool parse_token(const parser *parser, list *stack, int token);
+// Advances past the first token of the window, the rest is only looked at
+// in cells that need more lookahead
+bool parse_window(const parser *parser, list *stack, const token_window *window);
+
+// Table cell for a nonterminal and a terminal, a rule id or NO_RULE
+static inline int get_matching_rule(const parser *parser, int symbol, int token)
+{
+    int row = parser->symbol_ordinals[symbol];
+    int column = parser->symbol_ordinals[token];
+    if (parser->packed_cells)
+    {
+        packed_cell cell = parser->packed_cells[parser->packed_base[row] + column];
+        return cell.row == row ? cell.rule : NO_RULE;
+    }
+
+    return parser->table[row * parser->n_terminals + column];
+}
+
+static inline int get_window_token(const parser *parser, const token_window *window, size_t i)
+{
+    return i < window->count ? window->tokens[(window->start + i) & window->mask] : parser->end_symbol;
+}
+
 void clear_parser(parser *parser);
 
+// Set and table access for the incremental updates in update.c
+uint64_t *get_rule_first_set(const parser *parser, int rule);
+uint64_t *get_symbol_first_set(const parser *parser, int symbol);
+uint64_t *get_symbol_follow_set(const parser *parser, int symbol);
+void add_table_entries(parser *parser, const rule *rule, const uint64_t *terminals);
+// Rebuilds the driver rhs arrays for the rules from first_rule on
+void update_driver_rules(parser *parser, size_t first_rule);
+
 void print_rules(const parser *parser);
 void print_symbols(const parser *parser);
 void print_table(const parser *parser);
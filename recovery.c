@@ -0,0 +1,303 @@
+#include "recovery.h"
+#include <string.h>
+
+static size_t add_parse_error(const parser *parser, error_report *report, size_t position, int top);
+static bool is_row_terminal(const parser *parser, int nonterminal, int token);
+static bool expand_top(const parser *parser, list *stack, int token);
+static bool can_match_tokens(const parser *parser, const list *stack, list *scratch, const int *tokens,
+                             size_t n_tokens);
+static bool try_repair(const parser *parser, list *stack, list *scratch, const int *tokens, size_t n_tokens,
+                       size_t position, parse_error *error);
+static void print_terminal(const parser *parser, int terminal);
+
+void init_error_report(error_report *report)
+{
+    init_list(&report->errors, 16, sizeof(parse_error));
+    init_list(&report->expected_sets, 16, sizeof(uint64_t));
+    init_list(&report->scratch, 16, sizeof(int));
+    report->set_words = 0;
+}
+
+bool recover_tokens(const parser *parser, list *stack, const int *tokens, size_t n_tokens, bool repair,
+                    error_report *report)
+{
+    reset_parse_stack(parser, stack);
+    report->errors.count = 0;
+    report->expected_sets.count = 0;
+    report->set_words = parser->set_words;
+
+    // Errors found before the next terminal is matched come from the same
+    // mistake, their work is counted into the error that started it
+    bool recovering = false;
+    size_t error_index = 0;
+    size_t position = 0;
+    while (position <= n_tokens && stack->count > 0)
+    {
+        int token = position < n_tokens ? tokens[position] : parser->end_symbol;
+        int top = *(int *)peek_back(stack);
+        if (top == token)
+        {
+            pop_back(stack);
+            position++;
+            recovering = false;
+            continue;
+        }
+
+        if (!parser->terminal_symbols[top] && expand_top(parser, stack, token))
+            continue;
+
+        if (!recovering)
+            error_index = add_parse_error(parser, report, position, top);
+        recovering = true;
+        parse_error *error = get_list_element(&report->errors, error_index);
+
+        // Input after the end of a sentence has nothing to synchronize on
+        if (top == parser->end_symbol)
+        {
+            error->n_skipped += n_tokens - position;
+            position = n_tokens;
+            continue;
+        }
+
+        if (repair && error->repair == REPAIR_NONE && error->n_skipped == 0 && error->n_popped == 0)
+        {
+            if (try_repair(parser, stack, &report->scratch, tokens, n_tokens, position, error))
+            {
+                if (error->repair == REPAIR_DELETE)
+                    position++;
+                continue;
+            }
+        }
+
+        // Panic mode, skip to a token the nonterminal can start with or one
+        // that may follow it. A terminal that did not match is dropped.
+        if (!parser->terminal_symbols[top])
+        {
+            const uint64_t *follow = get_symbol_follow_set(parser, top);
+            while (position < n_tokens && !is_row_terminal(parser, top, tokens[position]) &&
+                   !bitset_test(follow, tokens[position]))
+            {
+                error->n_skipped++;
+                position++;
+            }
+
+            if (position < n_tokens && is_row_terminal(parser, top, tokens[position]))
+                continue;
+        }
+
+        pop_back(stack);
+        error->n_popped++;
+    }
+
+    return report->errors.count == 0;
+}
+
+size_t add_parse_error(const parser *parser, error_report *report, size_t position, int top)
+{
+    parse_error *error = push_back(&report->errors);
+    error->position = position;
+    error->repair = REPAIR_NONE;
+    error->inserted = -1;
+    error->n_skipped = 0;
+    error->n_popped = 0;
+    error->expected_offset = report->expected_sets.count;
+
+    reserve_list(&report->expected_sets, report->expected_sets.count + report->set_words);
+    uint64_t *expected = (uint64_t *)report->expected_sets.head + error->expected_offset;
+    memset(expected, 0, report->set_words * sizeof(uint64_t));
+    report->expected_sets.count += report->set_words;
+
+    if (parser->terminal_symbols[top])
+    {
+        bitset_set(expected, top);
+    }
+    else
+    {
+        size_t n_symbols = parser->n_terminals + parser->n_nonterminals;
+        for (size_t sym = 0; sym < n_symbols; sym++)
+        {
+            if (parser->terminal_symbols[sym] && is_row_terminal(parser, top, sym))
+                bitset_set(expected, sym);
+        }
+    }
+
+    return report->errors.count - 1;
+}
+
+const uint64_t *get_expected_set(const error_report *report, const parse_error *error)
+{
+    return (const uint64_t *)report->expected_sets.head + error->expected_offset;
+}
+
+bool is_row_terminal(const parser *parser, int nonterminal, int token)
+{
+    return get_matching_rule(parser, nonterminal, token) != NO_RULE;
+}
+
+// Replaces the nonterminal on top of the stack with the rule for token
+bool expand_top(const parser *parser, list *stack, int token)
+{
+    int rule_index = get_matching_rule(parser, *(int *)peek_back(stack), token);
+    if (rule_index < 0)
+        return false;
+
+    pop_back(stack);
+    int rhs_offset = parser->rhs_offsets[rule_index];
+    push_back_many(stack, parser->rhs_symbols + rhs_offset, parser->rhs_offsets[rule_index + 1] - rhs_offset);
+    return true;
+}
+
+// Checks whether the tokens would be matched from the stack without changing
+// it. Symbols of the stack are read in place, expansions go to scratch.
+bool can_match_tokens(const parser *parser, const list *stack, list *scratch, const int *tokens,
+                      size_t n_tokens)
+{
+    const int *stack_symbols = stack->head;
+    size_t depth = stack->count;
+    scratch->count = 0;
+
+    for (size_t i = 0; i < n_tokens; i++)
+    {
+        bool matched = false;
+        while (!matched)
+        {
+            int top;
+            if (scratch->count > 0)
+            {
+                top = *(int *)peek_back(scratch);
+                pop_back(scratch);
+            }
+            else if (depth > 0)
+            {
+                top = stack_symbols[--depth];
+            }
+            else
+            {
+                return false;
+            }
+
+            if (parser->terminal_symbols[top])
+            {
+                if (top != tokens[i])
+                    return false;
+                matched = true;
+                continue;
+            }
+
+            int rule_index = get_matching_rule(parser, top, tokens[i]);
+            if (rule_index < 0)
+                return false;
+
+            int rhs_offset = parser->rhs_offsets[rule_index];
+            push_back_many(scratch, parser->rhs_symbols + rhs_offset,
+                           parser->rhs_offsets[rule_index + 1] - rhs_offset);
+        }
+    }
+
+    return true;
+}
+
+// Tries deleting the token, then inserting one terminal before it. A repair
+// is only taken if the parser can match the token after it.
+bool try_repair(const parser *parser, list *stack, list *scratch, const int *tokens, size_t n_tokens,
+                size_t position, parse_error *error)
+{
+    int token = position < n_tokens ? tokens[position] : parser->end_symbol;
+    int top = *(int *)peek_back(stack);
+
+    if (position < n_tokens)
+    {
+        int next = position + 1 < n_tokens ? tokens[position + 1] : parser->end_symbol;
+        if (can_match_tokens(parser, stack, scratch, &next, 1))
+        {
+            error->repair = REPAIR_DELETE;
+            return true;
+        }
+    }
+
+    int candidates[2] = {0, token};
+    size_t n_symbols = parser->n_terminals + parser->n_nonterminals;
+    for (size_t sym = 0; sym < n_symbols; sym++)
+    {
+        if (!parser->terminal_symbols[sym] || (int)sym == parser->end_symbol)
+            continue;
+        if (parser->terminal_symbols[top] ? (int)sym != top : !is_row_terminal(parser, top, sym))
+            continue;
+
+        candidates[0] = sym;
+        if (can_match_tokens(parser, stack, scratch, candidates, 2))
+        {
+            // The inserted terminal is matched right away, so the parser is
+            // left at the token again
+            while (*(int *)peek_back(stack) != (int)sym)
+                expand_top(parser, stack, sym);
+            pop_back(stack);
+
+            error->repair = REPAIR_INSERT;
+            error->inserted = sym;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void print_terminal(const parser *parser, int terminal)
+{
+    if (parser->grammar)
+        printf("%s", symbol_name(parser->grammar, get_list_element(&parser->grammar->symbols, terminal)));
+    else
+        printf("#%d", terminal);
+}
+
+void print_parse_errors(const parser *parser, const int *tokens, size_t n_tokens, const error_report *report)
+{
+    size_t n_symbols = parser->n_terminals + parser->n_nonterminals;
+    for (size_t i = 0; i < report->errors.count; i++)
+    {
+        const parse_error *error = get_list_element(&report->errors, i);
+        if (error->position < n_tokens)
+        {
+            printf("\tError at token %zu (", error->position + 1);
+            print_terminal(parser, tokens[error->position]);
+            printf("), expected");
+        }
+        else
+        {
+            printf("\tError at end of input, expected");
+        }
+
+        const uint64_t *expected = get_expected_set(report, error);
+        for (size_t sym = 0; sym < n_symbols; sym++)
+        {
+            if (bitset_test(expected, sym))
+            {
+                putc(' ', stdout);
+                print_terminal(parser, sym);
+            }
+        }
+
+        if (error->repair == REPAIR_DELETE)
+        {
+            printf("; deleted it");
+        }
+        else if (error->repair == REPAIR_INSERT)
+        {
+            printf("; inserted ");
+            print_terminal(parser, error->inserted);
+        }
+
+        if (error->n_skipped > 0)
+            printf("; skipped %zu tokens", error->n_skipped);
+        if (error->n_popped > 0)
+            printf("; dropped %zu expected symbols", error->n_popped);
+        putc('\n', stdout);
+    }
+}
+
+void clear_error_report(error_report *report)
+{
+    clear_list(&report->errors);
+    clear_list(&report->expected_sets);
+    clear_list(&report->scratch);
+}
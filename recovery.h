@@ -0,0 +1,53 @@
+#ifndef RECOVERY_H
+#define RECOVERY_H
+
+#include "parser.h"
+
+// How the parser got past an error
+typedef enum
+{
+    // Panic mode, input tokens were skipped or stack symbols dropped
+    REPAIR_NONE,
+    // The token was dropped
+    REPAIR_DELETE,
+    // A missing terminal was assumed before the token
+    REPAIR_INSERT
+} repair_kind;
+
+typedef struct
+{
+    // Index of the token the error was found at, n_tokens for the end of
+    // input
+    size_t position;
+    repair_kind repair;
+    int inserted;
+    // Panic mode work until the parser could go on, errors found while
+    // still recovering are counted into the error that started it
+    size_t n_skipped;
+    size_t n_popped;
+    // Offset of the expected terminals in the report's set words
+    size_t expected_offset;
+} parse_error;
+
+// Errors of one input. Expected terminals are bitsets over symbol ids with
+// set_words words each.
+typedef struct
+{
+    list errors;
+    list expected_sets;
+    size_t set_words;
+    // Stack for trying repairs without changing the parse stack
+    list scratch;
+} error_report;
+
+void init_error_report(error_report *report);
+// Parses every token, recovering after each error, and returns whether the
+// input had no errors. Repairs try to delete or insert a single token before
+// falling back to panic mode.
+bool recover_tokens(const parser *parser, list *stack, const int *tokens, size_t n_tokens, bool repair,
+                    error_report *report);
+const uint64_t *get_expected_set(const error_report *report, const parse_error *error);
+void print_parse_errors(const parser *parser, const int *tokens, size_t n_tokens, const error_report *report);
+void clear_error_report(error_report *report);
+
+#endif
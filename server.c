@@ -0,0 +1,789 @@
+// For accept4
+#define _GNU_SOURCE
+
+#include "server.h"
+#include "earley.h"
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define SERVER_MAX_EVENTS 64
+#define SERVER_READ_SIZE 65536
+// Reading from a connection pauses while it has this many requests with the
+// workers or this many response bytes its client has not taken yet
+#define SERVER_MAX_IN_FLIGHT 1024
+#define SERVER_MAX_OUTPUT (16u << 20)
+
+// Connections are only touched by the event loop thread. One that is closed
+// while workers still hold its requests is freed when the last one is back.
+typedef struct
+{
+    int fd;
+    size_t index;
+    uint32_t events;
+    // Bytes received that do not make a whole request yet
+    list input;
+    // Responses not written yet, from output_offset on
+    list output;
+    size_t output_offset;
+    size_t n_in_flight;
+    // The client shut down its side, answers are still written
+    bool hung_up;
+    bool closed;
+} connection;
+
+typedef struct server_job
+{
+    connection *client;
+    // Request without its size field, replaced by the response
+    char *data;
+    size_t size;
+    struct server_job *next;
+} server_job;
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    server_job *head;
+    server_job *tail;
+    bool stopping;
+} job_queue;
+
+typedef struct
+{
+    const parser *const *parsers;
+    size_t n_parsers;
+
+    // The addresses of the descriptors tell them apart from connections in
+    // epoll events
+    int listen_fd;
+    int epoll_fd;
+    int done_fd;
+    int signal_fd;
+    // Off while the process is out of descriptors, until a connection closes
+    bool accepting;
+
+    job_queue jobs;
+    // Answered jobs, the workers signal done_fd when it stops being empty
+    job_queue done;
+
+    list connections;
+    list closed_connections;
+    list ready_connections;
+} server;
+
+static bool open_listen_socket(server *server, const char *socket_path);
+static bool remove_stale_socket(const struct sockaddr_un *address);
+static void run_event_loop(server *server);
+static void accept_connections(server *server);
+static void set_accepting(server *server, bool accepting);
+static void read_connection(server *server, connection *client);
+static void dispatch_requests(server *server, connection *client);
+static void write_connection(server *server, connection *client);
+static void update_events(server *server, connection *client);
+static void close_connection(server *server, connection *client);
+static void free_connection(connection *client);
+static void finish_jobs(server *server);
+static void drop_jobs(server *server, server_job *job);
+
+static void init_job_queue(job_queue *queue);
+static void append_jobs(job_queue *queue, server_job *head, server_job *tail);
+static server_job *take_job(job_queue *queue);
+static server_job *take_all_jobs(job_queue *queue);
+static void clear_job_queue(job_queue *queue);
+
+static void *run_worker(void *arg);
+static void answer_request(const server *server, parse_context *context, earley_recognizer *recognizers,
+                           server_job *job);
+static void set_response(server_job *job, uint32_t id, server_status status, uint32_t n_sentences);
+
+bool run_server(const char *socket_path, const parser *const *parsers, size_t n_parsers, size_t n_workers)
+{
+    server server;
+    server.parsers = parsers;
+    server.n_parsers = n_parsers;
+    server.listen_fd = -1;
+    server.epoll_fd = -1;
+    server.done_fd = -1;
+    server.signal_fd = -1;
+    server.accepting = true;
+    init_job_queue(&server.jobs);
+    init_job_queue(&server.done);
+    init_list(&server.connections, 16, sizeof(connection *));
+    init_list(&server.closed_connections, 16, sizeof(connection *));
+    init_list(&server.ready_connections, 16, sizeof(connection *));
+
+    // Blocked before the workers start so that they inherit the mask and
+    // the signals are only seen through signal_fd
+    sigset_t signals;
+    sigset_t old_signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, &old_signals);
+
+    bool success = open_listen_socket(&server, socket_path);
+    if (success)
+    {
+        server.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        server.done_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        server.signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+        success = server.epoll_fd >= 0 && server.done_fd >= 0 && server.signal_fd >= 0;
+    }
+
+    int *sources[] = {&server.listen_fd, &server.done_fd, &server.signal_fd};
+    for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]) && success; i++)
+    {
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = sources[i]};
+        success = epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, *sources[i], &event) == 0;
+    }
+
+    if (n_workers == 0)
+        n_workers = 1;
+
+    pthread_t *workers = malloc(n_workers * sizeof(pthread_t));
+    size_t n_started = 0;
+    for (size_t i = 0; i < n_workers && success; i++)
+    {
+        if (pthread_create(&workers[i], NULL, run_worker, &server) != 0)
+            break;
+
+        n_started++;
+    }
+
+    success = success && n_started > 0;
+    if (success)
+        run_event_loop(&server);
+
+    pthread_mutex_lock(&server.jobs.lock);
+    server.jobs.stopping = true;
+    pthread_cond_broadcast(&server.jobs.ready);
+    pthread_mutex_unlock(&server.jobs.lock);
+    for (size_t i = 0; i < n_started; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+
+    free(workers);
+    drop_jobs(&server, take_all_jobs(&server.jobs));
+    drop_jobs(&server, take_all_jobs(&server.done));
+    for (size_t i = 0; i < server.connections.count; i++)
+    {
+        connection *open = *(connection **)get_list_element(&server.connections, i);
+        close(open->fd);
+        free_connection(open);
+    }
+
+    for (size_t i = 0; i < server.closed_connections.count; i++)
+    {
+        free_connection(*(connection **)get_list_element(&server.closed_connections, i));
+    }
+
+    int *fds[] = {&server.listen_fd, &server.epoll_fd, &server.done_fd, &server.signal_fd};
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++)
+    {
+        if (*fds[i] >= 0)
+            close(*fds[i]);
+    }
+
+    if (server.listen_fd >= 0)
+        unlink(socket_path);
+
+    clear_list(&server.ready_connections);
+    clear_list(&server.closed_connections);
+    clear_list(&server.connections);
+    clear_job_queue(&server.done);
+    clear_job_queue(&server.jobs);
+    pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+    return success;
+}
+
+bool open_listen_socket(server *server, const char *socket_path)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(socket_path) >= sizeof(address.sun_path))
+        return false;
+
+    strcpy(address.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return false;
+
+    // A socket left behind by a server that did not shut down refuses
+    // connections and is replaced. One a live server still listens on is
+    // left to it, and anything else at the path makes bind fail.
+    struct stat status;
+    if (stat(socket_path, &status) == 0 && S_ISSOCK(status.st_mode) && !remove_stale_socket(&address))
+    {
+        close(fd);
+        return false;
+    }
+
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    server->listen_fd = fd;
+    return listen(fd, SOMAXCONN) == 0;
+}
+
+// Unlinks the socket at address if nothing listens on it
+bool remove_stale_socket(const struct sockaddr_un *address)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return false;
+
+    bool stale = connect(fd, (const struct sockaddr *)address, sizeof(*address)) != 0 && errno == ECONNREFUSED;
+    close(fd);
+    if (stale)
+        unlink(address->sun_path);
+
+    return stale;
+}
+
+void run_event_loop(server *server)
+{
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    bool running = true;
+    while (running)
+    {
+        int n_events = epoll_wait(server->epoll_fd, events, SERVER_MAX_EVENTS, -1);
+        if (n_events < 0 && errno != EINTR)
+            break;
+
+        for (int i = 0; i < n_events; i++)
+        {
+            void *source = events[i].data.ptr;
+            if (source == &server->listen_fd)
+            {
+                accept_connections(server);
+            }
+            else if (source == &server->done_fd)
+            {
+                finish_jobs(server);
+            }
+            else if (source == &server->signal_fd)
+            {
+                // Read so the signal is not delivered once it is unblocked
+                struct signalfd_siginfo info;
+                running = read(server->signal_fd, &info, sizeof(info)) != sizeof(info);
+            }
+            else
+            {
+                // A hang up means the client can not take answers either,
+                // one that only shut down writing is still read to the end
+                connection *client = source;
+                if (events[i].events & (EPOLLHUP | EPOLLERR))
+                    close_connection(server, client);
+                if (!client->closed && (events[i].events & EPOLLIN))
+                    read_connection(server, client);
+                if (!client->closed && (events[i].events & EPOLLOUT))
+                    write_connection(server, client);
+            }
+        }
+
+        // Freed only now, a connection closed by one event may still be
+        // named by a later one
+        for (size_t i = 0; i < server->closed_connections.count; i++)
+        {
+            free_connection(*(connection **)get_list_element(&server->closed_connections, i));
+        }
+
+        server->closed_connections.count = 0;
+    }
+}
+
+void accept_connections(server *server)
+{
+    while (true)
+    {
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+
+            // The listening socket stays readable, so it would wake the loop
+            // again right away
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+            {
+                fprintf(stderr, "Not accepting connections after %zu: %s\n", server->connections.count,
+                        strerror(errno));
+                set_accepting(server, false);
+            }
+
+            return;
+        }
+
+        connection *accepted = malloc(sizeof(connection));
+        accepted->fd = fd;
+        accepted->index = server->connections.count;
+        accepted->events = EPOLLIN;
+        init_list(&accepted->input, SERVER_READ_SIZE, sizeof(char));
+        init_list(&accepted->output, 0, sizeof(char));
+        accepted->output_offset = 0;
+        accepted->n_in_flight = 0;
+        accepted->hung_up = false;
+        accepted->closed = false;
+
+        struct epoll_event event = {.events = accepted->events, .data.ptr = accepted};
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+        {
+            close(fd);
+            free_connection(accepted);
+            continue;
+        }
+
+        *(connection **)push_back(&server->connections) = accepted;
+    }
+}
+
+void set_accepting(server *server, bool accepting)
+{
+    server->accepting = accepting;
+    if (accepting)
+    {
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = &server->listen_fd};
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &event);
+    }
+    else
+    {
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, server->listen_fd, NULL);
+    }
+}
+
+// Reads once per event so that one busy client can not hold up the others
+void read_connection(server *server, connection *client)
+{
+    list *input = &client->input;
+    if (input->size - input->count < SERVER_READ_SIZE)
+        reserve_list(input, input->count * 2 + SERVER_READ_SIZE);
+
+    ssize_t length = recv(client->fd, (char *)input->head + input->count, input->size - input->count, 0);
+    if (length < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            close_connection(server, client);
+
+        return;
+    }
+
+    if (length == 0)
+    {
+        // Whole requests that came before the shutdown are still answered
+        client->hung_up = true;
+        if (client->n_in_flight == 0 && client->output.count == 0)
+        {
+            close_connection(server, client);
+            return;
+        }
+    }
+
+    input->count += length;
+    dispatch_requests(server, client);
+    if (!client->closed)
+        update_events(server, client);
+}
+
+// Hands every whole request in the input to the workers in one batch
+void dispatch_requests(server *server, connection *client)
+{
+    list *input = &client->input;
+    const char *data = input->head;
+    server_job *head = NULL;
+    server_job *tail = NULL;
+    size_t offset = 0;
+    while (input->count - offset >= sizeof(uint32_t))
+    {
+        uint32_t size;
+        memcpy(&size, data + offset, sizeof(size));
+        if (size > SERVER_MAX_REQUEST)
+        {
+            close_connection(server, client);
+            break;
+        }
+
+        if (input->count - offset - sizeof(size) < size)
+            break;
+
+        server_job *job = malloc(sizeof(server_job));
+        job->client = client;
+        job->size = size;
+        job->data = malloc(size > 0 ? size : 1);
+        memcpy(job->data, data + offset + sizeof(size), size);
+        job->next = NULL;
+        if (tail)
+            tail->next = job;
+        else
+            head = job;
+
+        tail = job;
+        client->n_in_flight++;
+        offset += sizeof(size) + size;
+    }
+
+    if (head)
+        append_jobs(&server->jobs, head, tail);
+
+    memmove(input->head, data + offset, input->count - offset);
+    input->count -= offset;
+}
+
+void write_connection(server *server, connection *client)
+{
+    list *output = &client->output;
+    while (client->output_offset < output->count)
+    {
+        ssize_t length = send(client->fd, (char *)output->head + client->output_offset,
+                              output->count - client->output_offset, MSG_NOSIGNAL);
+        if (length < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                close_connection(server, client);
+
+            break;
+        }
+
+        client->output_offset += length;
+    }
+
+    if (client->closed)
+        return;
+
+    if (client->output_offset == output->count)
+    {
+        output->count = 0;
+        client->output_offset = 0;
+        if (client->hung_up && client->n_in_flight == 0)
+        {
+            close_connection(server, client);
+            return;
+        }
+    }
+
+    update_events(server, client);
+}
+
+void update_events(server *server, connection *client)
+{
+    size_t n_unsent = client->output.count - client->output_offset;
+    uint32_t events = 0;
+    if (!client->hung_up && client->n_in_flight < SERVER_MAX_IN_FLIGHT && n_unsent < SERVER_MAX_OUTPUT)
+        events |= EPOLLIN;
+    if (n_unsent > 0)
+        events |= EPOLLOUT;
+
+    if (events == client->events)
+        return;
+
+    struct epoll_event event = {.events = events, .data.ptr = client};
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, client->fd, &event) != 0)
+    {
+        close_connection(server, client);
+        return;
+    }
+
+    client->events = events;
+}
+
+void close_connection(server *server, connection *client)
+{
+    if (client->closed)
+        return;
+
+    client->closed = true;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+
+    // The last connection takes the place of the closed one
+    connection **last = peek_back(&server->connections);
+    (*last)->index = client->index;
+    *(connection **)get_list_element(&server->connections, client->index) = *last;
+    pop_back(&server->connections);
+
+    if (client->n_in_flight == 0)
+        *(connection **)push_back(&server->closed_connections) = client;
+
+    if (!server->accepting)
+        set_accepting(server, true);
+}
+
+void free_connection(connection *client)
+{
+    clear_list(&client->input);
+    clear_list(&client->output);
+    free(client);
+}
+
+// Queues the responses of answered jobs, then writes to every connection
+// that got some
+void finish_jobs(server *server)
+{
+    uint64_t count;
+    if (read(server->done_fd, &count, sizeof(count)) < 0)
+        return;
+
+    server_job *job = take_all_jobs(&server->done);
+    server->ready_connections.count = 0;
+    while (job)
+    {
+        connection *client = job->client;
+        client->n_in_flight--;
+        if (client->closed)
+        {
+            if (client->n_in_flight == 0)
+                *(connection **)push_back(&server->closed_connections) = client;
+        }
+        else
+        {
+            if (client->output.count == 0)
+                *(connection **)push_back(&server->ready_connections) = client;
+
+            push_back_many(&client->output, job->data, job->size);
+        }
+
+        server_job *next = job->next;
+        free(job->data);
+        free(job);
+        job = next;
+    }
+
+    for (size_t i = 0; i < server->ready_connections.count; i++)
+    {
+        connection *client = *(connection **)get_list_element(&server->ready_connections, i);
+        if (!client->closed)
+            write_connection(server, client);
+    }
+}
+
+// Frees jobs that will not be answered, along with closed connections
+// that were only kept for them
+void drop_jobs(server *server, server_job *job)
+{
+    while (job)
+    {
+        connection *client = job->client;
+        client->n_in_flight--;
+        if (client->closed && client->n_in_flight == 0)
+            *(connection **)push_back(&server->closed_connections) = client;
+
+        server_job *next = job->next;
+        free(job->data);
+        free(job);
+        job = next;
+    }
+}
+
+void init_job_queue(job_queue *queue)
+{
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->ready, NULL);
+    queue->head = NULL;
+    queue->tail = NULL;
+    queue->stopping = false;
+}
+
+void append_jobs(job_queue *queue, server_job *head, server_job *tail)
+{
+    pthread_mutex_lock(&queue->lock);
+    if (queue->tail)
+        queue->tail->next = head;
+    else
+        queue->head = head;
+
+    queue->tail = tail;
+    if (head == tail)
+        pthread_cond_signal(&queue->ready);
+    else
+        pthread_cond_broadcast(&queue->ready);
+
+    pthread_mutex_unlock(&queue->lock);
+}
+
+// Waits for a job, returns NULL once the queue is stopping
+server_job *take_job(job_queue *queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    while (!queue->head && !queue->stopping)
+        pthread_cond_wait(&queue->ready, &queue->lock);
+
+    server_job *job = NULL;
+    if (!queue->stopping)
+    {
+        job = queue->head;
+        queue->head = job->next;
+        if (!queue->head)
+            queue->tail = NULL;
+
+        job->next = NULL;
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+    return job;
+}
+
+server_job *take_all_jobs(job_queue *queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    server_job *jobs = queue->head;
+    queue->head = NULL;
+    queue->tail = NULL;
+    pthread_mutex_unlock(&queue->lock);
+    return jobs;
+}
+
+void clear_job_queue(job_queue *queue)
+{
+    pthread_cond_destroy(&queue->ready);
+    pthread_mutex_destroy(&queue->lock);
+}
+
+void *run_worker(void *arg)
+{
+    server *server = arg;
+    parse_context context;
+    init_parse_context(&context);
+    // Recognizers are indexed by grammar, a NULL parser marks one not made
+    earley_recognizer *recognizers = calloc(server->n_parsers, sizeof(earley_recognizer));
+
+    server_job *job;
+    while ((job = take_job(&server->jobs)))
+    {
+        answer_request(server, &context, recognizers, job);
+
+        // The event loop drains the whole queue on every wakeup, so only the
+        // job that makes it non empty has to wake it
+        pthread_mutex_lock(&server->done.lock);
+        bool was_empty = !server->done.head;
+        if (server->done.tail)
+            server->done.tail->next = job;
+        else
+            server->done.head = job;
+
+        server->done.tail = job;
+        pthread_mutex_unlock(&server->done.lock);
+
+        uint64_t one = 1;
+        if (was_empty && write(server->done_fd, &one, sizeof(one)) < 0)
+            break;
+    }
+
+    for (size_t i = 0; i < server->n_parsers; i++)
+    {
+        if (recognizers[i].parser)
+            clear_earley_recognizer(&recognizers[i]);
+    }
+
+    free(recognizers);
+    clear_parse_context(&context);
+    return NULL;
+}
+
+// Validates every sentence of the request and puts the response in its place
+void answer_request(const server *server, parse_context *context, earley_recognizer *recognizers,
+                    server_job *job)
+{
+    const char *request = job->data;
+    size_t size = job->size;
+    uint32_t header[3];
+    if (size < sizeof(header))
+    {
+        set_response(job, 0, SERVER_MALFORMED, 0);
+        return;
+    }
+
+    memcpy(header, request, sizeof(header));
+    uint32_t id = header[0];
+    uint32_t grammar = header[1];
+    uint32_t n_sentences = header[2];
+    if (grammar >= server->n_parsers)
+    {
+        set_response(job, id, SERVER_UNKNOWN_GRAMMAR, 0);
+        return;
+    }
+
+    // Every sentence has at least its length, which bounds n_sentences
+    // before the result vector is allocated
+    if (n_sentences > (size - sizeof(header)) / sizeof(uint32_t))
+    {
+        set_response(job, id, SERVER_MALFORMED, 0);
+        return;
+    }
+
+    size_t n_bytes = (n_sentences + 7) / 8;
+    char *response = calloc(SERVER_HEADER_SIZE + n_bytes, 1);
+    unsigned char *results = (unsigned char *)response + SERVER_HEADER_SIZE;
+    const parser *parser = server->parsers[grammar];
+    earley_recognizer *recognizer = NULL;
+    if (!is_valid_grammar(parser))
+    {
+        recognizer = &recognizers[grammar];
+        if (!recognizer->parser)
+            init_earley_recognizer(recognizer, parser);
+    }
+
+    size_t offset = sizeof(header);
+    server_status status = SERVER_OK;
+    for (uint32_t i = 0; i < n_sentences; i++)
+    {
+        uint32_t length;
+        if (size - offset < sizeof(length))
+        {
+            status = SERVER_MALFORMED;
+            break;
+        }
+
+        memcpy(&length, request + offset, sizeof(length));
+        offset += sizeof(length);
+        if (size - offset < length)
+        {
+            status = SERVER_MALFORMED;
+            break;
+        }
+
+        bool valid = recognizer ? earley_recognize_span(recognizer, context, request + offset, length)
+                                : validate_span(parser, context, request + offset, length);
+        if (valid)
+            results[i / 8] |= 1 << (i % 8);
+
+        offset += length;
+    }
+
+    if (status != SERVER_OK || offset != size)
+    {
+        free(response);
+        set_response(job, id, SERVER_MALFORMED, 0);
+        return;
+    }
+
+    uint32_t response_header[4] = {SERVER_HEADER_SIZE - sizeof(uint32_t) + n_bytes, id, status, n_sentences};
+    memcpy(response, response_header, sizeof(response_header));
+    free(job->data);
+    job->data = response;
+    job->size = SERVER_HEADER_SIZE + n_bytes;
+}
+
+void set_response(server_job *job, uint32_t id, server_status status, uint32_t n_sentences)
+{
+    uint32_t response_header[4] = {SERVER_HEADER_SIZE - sizeof(uint32_t), id, status, n_sentences};
+    free(job->data);
+    job->data = malloc(SERVER_HEADER_SIZE);
+    memcpy(job->data, response_header, sizeof(response_header));
+    job->size = SERVER_HEADER_SIZE;
+}
@@ -0,0 +1,36 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdint.h>
+#include "parser.h"
+
+// Validation daemon on a Unix domain socket. Every integer on the wire is a
+// uint32_t in host byte order, the socket only reaches local clients.
+//
+// Request:  size, id, grammar, n_sentences, then for every sentence its
+//           length and its text, tokens separated by whitespace
+// Response: size, id, status, n_sentences, then (n_sentences + 7) / 8 bytes
+//           with bit i % 8 of byte i / 8 set if sentence i is valid
+//
+// Size counts the bytes after itself. Grammars are numbered in the order
+// they were given. Requests on one connection may be answered out of order,
+// clients match responses by id.
+
+#define SERVER_HEADER_SIZE (4 * sizeof(uint32_t))
+// Connections sending a larger request are closed
+#define SERVER_MAX_REQUEST (64u << 20)
+
+typedef enum
+{
+    SERVER_OK = 0,
+    SERVER_UNKNOWN_GRAMMAR = 1,
+    SERVER_MALFORMED = 2
+} server_status;
+
+// Serves requests with n_workers threads until SIGINT or SIGTERM. The
+// parsers are shared by all workers. Those whose grammar is not LL(1) are
+// run with an Earley recognizer per worker, made when it first needs one,
+// and must be built from a grammar.
+bool run_server(const char *socket_path, const parser *const *parsers, size_t n_parsers, size_t n_workers);
+
+#endif
@@ -0,0 +1,56 @@
+#include "stats.h"
+#include <string.h>
+#include <time.h>
+
+void init_parser_stats(parser_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+uint64_t stats_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+void record_parse(parser_stats *stats, const parse_counters *counters)
+{
+    __atomic_fetch_add(&stats->parse.tokens, counters->tokens, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->parse.expansions, counters->expansions, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->parse.terminal_matches, counters->terminal_matches, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->parse.table_lookups, counters->table_lookups, __ATOMIC_RELAXED);
+
+    uint64_t depth = __atomic_load_n(&stats->parse.max_stack_depth, __ATOMIC_RELAXED);
+    while (counters->max_stack_depth > depth &&
+           !__atomic_compare_exchange_n(&stats->parse.max_stack_depth, &depth, counters->max_stack_depth, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+void write_stats_json(const parser_stats *stats, uint64_t set_unions, FILE *out)
+{
+    fprintf(out, "{\n");
+    fprintf(out, "  \"counters_enabled\": %s,\n", STATS_ENABLED ? "true" : "false");
+    fprintf(out, "  \"build\": {\n");
+    fprintf(out, "    \"load_ns\": %lu,\n", (unsigned long)stats->load_time);
+    fprintf(out, "    \"nullable_ns\": %lu,\n", (unsigned long)stats->nullable_time);
+    fprintf(out, "    \"first_ns\": %lu,\n", (unsigned long)stats->first_time);
+    fprintf(out, "    \"follow_ns\": %lu,\n", (unsigned long)stats->follow_time);
+    fprintf(out, "    \"table_ns\": %lu,\n", (unsigned long)stats->table_time);
+    fprintf(out, "    \"nullable_iterations\": %lu,\n", (unsigned long)stats->nullable_iterations);
+    fprintf(out, "    \"first_iterations\": %lu,\n", (unsigned long)stats->first_iterations);
+    fprintf(out, "    \"follow_iterations\": %lu,\n", (unsigned long)stats->follow_iterations);
+    fprintf(out, "    \"set_unions\": %lu,\n", (unsigned long)set_unions);
+    fprintf(out, "    \"table_entries\": %lu\n", (unsigned long)stats->table_entries);
+    fprintf(out, "  },\n");
+    fprintf(out, "  \"parse\": {\n");
+    fprintf(out, "    \"parses\": %lu,\n", (unsigned long)stats->parses);
+    fprintf(out, "    \"tokens\": %lu,\n", (unsigned long)stats->parse.tokens);
+    fprintf(out, "    \"expansions\": %lu,\n", (unsigned long)stats->parse.expansions);
+    fprintf(out, "    \"terminal_matches\": %lu,\n", (unsigned long)stats->parse.terminal_matches);
+    fprintf(out, "    \"table_lookups\": %lu,\n", (unsigned long)stats->parse.table_lookups);
+    fprintf(out, "    \"max_stack_depth\": %lu\n", (unsigned long)stats->parse.max_stack_depth);
+    fprintf(out, "  }\n");
+    fprintf(out, "}\n");
+}
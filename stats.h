@@ -0,0 +1,68 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Counters are only compiled in with -DLL1_STATS, without it the macros
+// below do nothing but name their counters, so those are not left unused.
+// Build timers are always kept, they run once.
+#ifdef LL1_STATS
+#define STATS_ENABLED true
+#define STATS_ADD(counters, field, n) ((counters)->field += (n))
+#define STATS_MAX(counters, field, value)                                                                              \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if ((value) > (counters)->field)                                                                               \
+            (counters)->field = (value);                                                                               \
+    } while (0)
+// Parse totals are kept in the parser, which is const while parsing, so
+// they are written through a cast and with atomics for shared parsers
+#define STATS_COUNT_PARSE(stats) __atomic_fetch_add(&((parser_stats *)(stats))->parses, 1, __ATOMIC_RELAXED)
+#define STATS_RECORD_PARSE(stats, counters) record_parse((parser_stats *)(stats), counters)
+#else
+#define STATS_ENABLED false
+#define STATS_ADD(counters, field, n) ((void)(counters))
+#define STATS_MAX(counters, field, value) ((void)(counters))
+#define STATS_COUNT_PARSE(stats) ((void)0)
+#define STATS_RECORD_PARSE(stats, counters) ((void)0)
+#endif
+
+// Counters for a single parse, summed into parser_stats when it ends
+typedef struct
+{
+    uint64_t tokens;
+    uint64_t expansions;
+    uint64_t terminal_matches;
+    uint64_t table_lookups;
+    uint64_t max_stack_depth;
+} parse_counters;
+
+typedef struct
+{
+    // Build times in nanoseconds
+    uint64_t load_time;
+    uint64_t nullable_time;
+    uint64_t first_time;
+    uint64_t follow_time;
+    uint64_t table_time;
+
+    // Passes over the rules for the iterative analysis, worklist items
+    // processed for the worklist one
+    uint64_t nullable_iterations;
+    uint64_t first_iterations;
+    uint64_t follow_iterations;
+    uint64_t table_entries;
+
+    // Summed over every parse
+    uint64_t parses;
+    parse_counters parse;
+} parser_stats;
+
+void init_parser_stats(parser_stats *stats);
+uint64_t stats_now(void);
+void record_parse(parser_stats *stats, const parse_counters *counters);
+void write_stats_json(const parser_stats *stats, uint64_t set_unions, FILE *out);
+
+#endif
@@ -0,0 +1,100 @@
+#include "stream.h"
+
+static void parse_stream_token(parse_stream *stream, const char *token, size_t length);
+static void parse_lookahead_token(parse_stream *stream);
+
+void begin_stream(parse_stream *stream, const parser *parser)
+{
+    stream->parser = parser;
+    init_parse_stack(parser, &stream->stack);
+    init_list(&stream->partial_token, parser->max_terminal_length, sizeof(char));
+    stream->lookahead_start = 0;
+    stream->lookahead_count = 0;
+    stream->failed = false;
+}
+
+bool feed_stream(parse_stream *stream, const char *chunk, size_t length)
+{
+    size_t i = 0;
+    while (i < length && !stream->failed)
+    {
+        if (is_token_separator(chunk[i]))
+        {
+            if (stream->partial_token.count > 0)
+            {
+                parse_stream_token(stream, stream->partial_token.head, stream->partial_token.count);
+                stream->partial_token.count = 0;
+            }
+
+            i++;
+            continue;
+        }
+
+        size_t start = i;
+        while (i < length && !is_token_separator(chunk[i]))
+            i++;
+
+        if (stream->partial_token.count == 0 && i < length)
+        {
+            // The whole token is inside this chunk
+            parse_stream_token(stream, chunk + start, i - start);
+            continue;
+        }
+
+        // No terminal is longer than max_terminal_length, so longer tokens
+        // can fail right away instead of being buffered
+        if (stream->partial_token.count + i - start > stream->parser->max_terminal_length)
+        {
+            stream->failed = true;
+            break;
+        }
+
+        push_back_many(&stream->partial_token, chunk + start, i - start);
+    }
+
+    return !stream->failed;
+}
+
+bool end_stream(parse_stream *stream)
+{
+    if (!stream->failed && stream->partial_token.count > 0)
+    {
+        parse_stream_token(stream, stream->partial_token.head, stream->partial_token.count);
+    }
+
+    // Tokens still buffered are parsed with the end of the input behind them
+    while (!stream->failed && stream->lookahead_count > 0)
+        parse_lookahead_token(stream);
+
+    bool success = !stream->failed && parse_token(stream->parser, &stream->stack, stream->parser->end_symbol) &&
+                   stream->stack.count == 0;
+
+    clear_list(&stream->stack);
+    clear_list(&stream->partial_token);
+
+    return success;
+}
+
+void parse_stream_token(parse_stream *stream, const char *token, size_t length)
+{
+    int id = find_terminal(stream->parser, token, length);
+    if (id == HASH_TABLE_MISSING)
+    {
+        stream->failed = true;
+        return;
+    }
+
+    stream->lookahead[(stream->lookahead_start + stream->lookahead_count++) % MAX_LOOKAHEAD] = id;
+    if (stream->lookahead_count >= stream->parser->lookahead_depth)
+        parse_lookahead_token(stream);
+}
+
+void parse_lookahead_token(parse_stream *stream)
+{
+    token_window window = {stream->lookahead, MAX_LOOKAHEAD - 1, stream->lookahead_start, stream->lookahead_count};
+    if (!parse_window(stream->parser, &stream->stack, &window))
+        stream->failed = true;
+
+    stream->lookahead_start = (stream->lookahead_start + 1) % MAX_LOOKAHEAD;
+    stream->lookahead_count--;
+}
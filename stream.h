@@ -0,0 +1,26 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "parser.h"
+
+// Validates input that arrives in chunks. Tokens may be split across chunk
+// boundaries, and the only state kept between chunks is the parse stack,
+// the bytes of the token that is not finished yet and, for grammars with
+// lookahead cells, the terminal ids of tokens read but not parsed yet. Those
+// wait in a ring buffer until it holds as many tokens as the lookahead.
+typedef struct
+{
+    const parser *parser;
+    list stack;
+    list partial_token;
+    int lookahead[MAX_LOOKAHEAD];
+    size_t lookahead_start;
+    size_t lookahead_count;
+    bool failed;
+} parse_stream;
+
+void begin_stream(parse_stream *stream, const parser *parser);
+bool feed_stream(parse_stream *stream, const char *chunk, size_t length);
+bool end_stream(parse_stream *stream);
+
+#endif
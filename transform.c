@@ -0,0 +1,677 @@
+#include "transform.h"
+#include <limits.h>
+#include <string.h>
+
+// Items of an alternative are rhs symbol ids, or the completion of an
+// original rule stored as -(rule + 1)
+#define REDUCE_ITEM(rule) (-(rule) - 1)
+#define IS_REDUCE_ITEM(item) ((item) < 0)
+#define REDUCED_RULE(item) (-(item) - 1)
+// First item of an empty alternative, neither a symbol nor a reduce item
+#define NO_ITEM INT_MIN
+
+// Substitution can grow a grammar exponentially, past this many items per
+// original item left recursion is left in place
+#define MAX_ITEM_GROWTH 32
+
+typedef struct
+{
+    grammar *grammar;
+    // Alternatives of each symbol as lists of items, indexed by symbol id
+    list *alternatives;
+    size_t capacity;
+    size_t n_items;
+    size_t max_items;
+    size_t n_recursive;
+    size_t n_factored;
+} rewrite_state;
+
+// Rule of the transformed tree that is being replayed, and the next child
+// and marker in it
+typedef struct
+{
+    int rule;
+    uint32_t n_children;
+    uint32_t child;
+    int marker;
+} replay_frame;
+
+// Original tree node in postorder, with the size of its subtree
+typedef struct
+{
+    parse_node node;
+    uint32_t size;
+} postorder_node;
+
+static void init_rewrite_state(rewrite_state *state, grammar *grammar);
+static void grow_alternatives(rewrite_state *state);
+static void clear_rewrite_state(rewrite_state *state);
+static list *add_alternative(rewrite_state *state, int lhs);
+static int add_helper_symbol(rewrite_state *state, int base);
+static bool is_nonterminal(const rewrite_state *state, int symbol);
+static int first_item(const list *items);
+static void compute_left_reach(const rewrite_state *state, size_t n_symbols, uint64_t *reach);
+static void substitute_leading(rewrite_state *state, int lhs, int leading);
+static void remove_direct_recursion(rewrite_state *state, int lhs);
+static void factor_alternatives(rewrite_state *state, int lhs, list *worklist);
+static void prune_unreachable(rewrite_state *state);
+static void emit_rules(grammar_transform *transform, rewrite_state *state);
+static void emit_rule(grammar_transform *transform, int lhs, const list *items, int empty_symbol);
+static void replay_markers(const grammar_transform *transform, replay_frame *frame, list *postorder, list *roots,
+                           size_t next_token);
+static void reduce_original_rule(const grammar *original, int rule_id, list *postorder, list *roots,
+                                 size_t next_token);
+
+void init_grammar_transform(grammar_transform *transform, const grammar *original)
+{
+    transform->original = original;
+    init_grammar(&transform->grammar, original->symbols.count + 16);
+    init_list(&transform->markers, 16, sizeof(rule_marker));
+    transform->marker_offsets = NULL;
+
+    // Original symbols are copied first so they keep their ids
+    size_t n_symbols = original->symbols.count;
+    for (size_t i = 0; i < n_symbols; i++)
+    {
+        const symbol *original_symbol = get_list_element(&original->symbols, i);
+        symbol *copy = add_new_symbol(&transform->grammar, symbol_name(original, original_symbol),
+                                      original_symbol->name_length);
+        copy->type = original_symbol->type;
+    }
+
+    rewrite_state state;
+    init_rewrite_state(&state, &transform->grammar);
+    for (size_t i = 0; i < original->rules.count; i++)
+    {
+        const rule *original_rule = get_list_element(&original->rules, i);
+        list *items = add_alternative(&state, original_rule->lhs->id);
+        for (size_t j = 0; j < original_rule->rhs.count; j++)
+        {
+            const symbol *rhs_symbol = *(symbol **)get_list_element(&original_rule->rhs, j);
+            if (!is_empty_symbol(original, rhs_symbol))
+                *(int *)push_back(items) = rhs_symbol->id;
+        }
+
+        *(int *)push_back(items) = REDUCE_ITEM(original_rule->id);
+        state.n_items += items->count;
+    }
+
+    state.max_items = state.n_items * MAX_ITEM_GROWTH;
+
+    // Nonterminals are ordered by id. Leading nonterminals that come earlier
+    // and can lead back to the nonterminal are substituted, which leaves only
+    // direct left recursion to remove.
+    size_t reach_words = bitset_words(n_symbols);
+    uint64_t *reach = create_bitset_arr(n_symbols, reach_words);
+    compute_left_reach(&state, n_symbols, reach);
+    for (size_t i = 0; i < n_symbols; i++)
+    {
+        if (!is_nonterminal(&state, i))
+            continue;
+
+        for (size_t j = 0; j < i; j++)
+        {
+            if (is_nonterminal(&state, j) && bitset_test(reach + j * reach_words, i) &&
+                bitset_test(reach + i * reach_words, j))
+                substitute_leading(&state, i, j);
+        }
+
+        remove_direct_recursion(&state, i);
+    }
+
+    free(reach);
+
+    list worklist;
+    init_list(&worklist, 16, sizeof(int));
+    for (size_t i = 0; i < transform->grammar.symbols.count; i++)
+    {
+        if (is_nonterminal(&state, i))
+            *(int *)push_back(&worklist) = i;
+    }
+
+    while (worklist.count > 0)
+    {
+        int lhs = *(int *)peek_back(&worklist);
+        pop_back(&worklist);
+        factor_alternatives(&state, lhs, &worklist);
+    }
+
+    clear_list(&worklist);
+
+    prune_unreachable(&state);
+    emit_rules(transform, &state);
+    transform->n_recursive = state.n_recursive;
+    transform->n_factored = state.n_factored;
+    clear_rewrite_state(&state);
+}
+
+void init_rewrite_state(rewrite_state *state, grammar *grammar)
+{
+    state->grammar = grammar;
+    state->alternatives = NULL;
+    state->capacity = 0;
+    state->n_items = 0;
+    state->max_items = 0;
+    state->n_recursive = 0;
+    state->n_factored = 0;
+    grow_alternatives(state);
+}
+
+void grow_alternatives(rewrite_state *state)
+{
+    size_t n_symbols = state->grammar->symbols.count;
+    if (n_symbols <= state->capacity)
+        return;
+
+    size_t capacity = n_symbols * 2;
+    state->alternatives = realloc(state->alternatives, capacity * sizeof(list));
+    for (size_t i = state->capacity; i < capacity; i++)
+        init_list(&state->alternatives[i], 0, sizeof(list));
+    state->capacity = capacity;
+}
+
+void clear_rewrite_state(rewrite_state *state)
+{
+    for (size_t i = 0; i < state->capacity; i++)
+    {
+        list *alternatives = &state->alternatives[i];
+        for (size_t j = 0; j < alternatives->count; j++)
+            clear_list(get_list_element(alternatives, j));
+        clear_list(alternatives);
+    }
+
+    free(state->alternatives);
+}
+
+list *add_alternative(rewrite_state *state, int lhs)
+{
+    list *items = new_list_element(&state->alternatives[lhs]);
+    init_list(items, 4, sizeof(int));
+    return items;
+}
+
+// Adds a nonterminal named after base with as many primes as it takes to
+// get a name that is not used yet
+int add_helper_symbol(rewrite_state *state, int base)
+{
+    grammar *grammar = state->grammar;
+    const symbol *base_symbol = get_list_element(&grammar->symbols, base);
+    size_t length = base_symbol->name_length;
+    char *name = malloc(length + 2);
+    memcpy(name, symbol_name(grammar, base_symbol), length);
+    do
+    {
+        name[length++] = '\'';
+        name = realloc(name, length + 1);
+    }
+    while (find_symbol_span(grammar, name, length));
+
+    symbol *helper = add_new_symbol(grammar, name, length);
+    helper->type = NONTERMINAL;
+    free(name);
+
+    grow_alternatives(state);
+    return helper->id;
+}
+
+bool is_nonterminal(const rewrite_state *state, int symbol)
+{
+    return ((const struct symbol *)get_list_element(&state->grammar->symbols, symbol))->type == NONTERMINAL;
+}
+
+// Empty alternatives have no first item. -1 would be the reduce item of
+// rule 0 and join its group, so they get NO_ITEM.
+int first_item(const list *items)
+{
+    return items->count > 0 ? *(int *)items->head : NO_ITEM;
+}
+
+// Sets the nonterminals each nonterminal can derive at the front of a
+// sentential form, through first rhs symbols only
+void compute_left_reach(const rewrite_state *state, size_t n_symbols, uint64_t *reach)
+{
+    size_t reach_words = bitset_words(n_symbols);
+    list stack;
+    init_list(&stack, 16, sizeof(int));
+    for (size_t i = 0; i < n_symbols; i++)
+    {
+        uint64_t *row = reach + i * reach_words;
+        *(int *)push_back(&stack) = i;
+        while (stack.count > 0)
+        {
+            int sym = *(int *)peek_back(&stack);
+            pop_back(&stack);
+
+            const list *alternatives = &state->alternatives[sym];
+            for (size_t j = 0; j < alternatives->count; j++)
+            {
+                const list *items = get_list_element(alternatives, j);
+                int leading = first_item(items);
+                if (!IS_REDUCE_ITEM(leading) && is_nonterminal(state, leading) && !bitset_test(row, leading))
+                {
+                    bitset_set(row, leading);
+                    *(int *)push_back(&stack) = leading;
+                }
+            }
+        }
+    }
+
+    clear_list(&stack);
+}
+
+// Replaces alternatives of lhs that start with leading by one alternative
+// per alternative of leading
+void substitute_leading(rewrite_state *state, int lhs, int leading)
+{
+    list *alternatives = &state->alternatives[lhs];
+    const list *substitutes = &state->alternatives[leading];
+    size_t n_added = 0;
+    for (size_t i = 0; i < alternatives->count; i++)
+    {
+        const list *items = get_list_element(alternatives, i);
+        if (first_item(items) != leading)
+            continue;
+
+        for (size_t j = 0; j < substitutes->count; j++)
+            n_added += ((const list *)get_list_element(substitutes, j))->count + items->count - 1;
+    }
+
+    if (state->n_items + n_added > state->max_items)
+        return;
+
+    state->n_items += n_added;
+    list kept;
+    init_list(&kept, alternatives->count + 1, sizeof(list));
+    for (size_t i = 0; i < alternatives->count; i++)
+    {
+        list *items = get_list_element(alternatives, i);
+        if (first_item(items) != leading)
+        {
+            *(list *)new_list_element(&kept) = *items;
+            continue;
+        }
+
+        for (size_t j = 0; j < substitutes->count; j++)
+        {
+            const list *substitute = get_list_element(substitutes, j);
+            list *expanded = new_list_element(&kept);
+            init_list(expanded, substitute->count + items->count, sizeof(int));
+            push_back_many(expanded, substitute->head, substitute->count);
+            push_back_many(expanded, (int *)items->head + 1, items->count - 1);
+        }
+
+        clear_list(items);
+    }
+
+    clear_list(alternatives);
+    *alternatives = kept;
+}
+
+// A ::= A a | b becomes A ::= b A' and A' ::= a A' | ", the reductions of
+// the original rules move with their symbols
+void remove_direct_recursion(rewrite_state *state, int lhs)
+{
+    bool recursive = false;
+    bool has_base = false;
+    const list *alternatives = &state->alternatives[lhs];
+    for (size_t i = 0; i < alternatives->count; i++)
+    {
+        const list *items = get_list_element(alternatives, i);
+        if (first_item(items) == lhs)
+            recursive = true;
+        else
+            has_base = true;
+    }
+
+    // Without an alternative to start from the nonterminal derives nothing
+    if (!recursive || !has_base)
+        return;
+
+    int helper = add_helper_symbol(state, lhs);
+    list old = state->alternatives[lhs];
+    init_list(&state->alternatives[lhs], old.count, sizeof(list));
+    for (size_t i = 0; i < old.count; i++)
+    {
+        list *items = get_list_element(&old, i);
+        if (first_item(items) == lhs)
+        {
+            list *tail = add_alternative(state, helper);
+            push_back_many(tail, (int *)items->head + 1, items->count - 1);
+            *(int *)push_back(tail) = helper;
+            clear_list(items);
+        }
+        else
+        {
+            *(int *)push_back(items) = helper;
+            *(list *)new_list_element(&state->alternatives[lhs]) = *items;
+        }
+    }
+
+    add_alternative(state, helper);
+    clear_list(&old);
+    state->n_recursive++;
+}
+
+// Moves the differing tails of alternatives that start with the same item
+// into a new nonterminal, until no two alternatives start the same way
+void factor_alternatives(rewrite_state *state, int lhs, list *worklist)
+{
+    bool factored = true;
+    while (factored)
+    {
+        factored = false;
+        list *alternatives = &state->alternatives[lhs];
+        for (size_t i = 0; i < alternatives->count && !factored; i++)
+        {
+            const list *first = get_list_element(alternatives, i);
+            if (first->count == 0)
+                continue;
+
+            const int *first_items = first->head;
+            size_t prefix = first->count;
+            size_t n_group = 1;
+            for (size_t j = i + 1; j < alternatives->count; j++)
+            {
+                const list *other = get_list_element(alternatives, j);
+                const int *other_items = other->head;
+                if (other->count == 0 || other_items[0] != first_items[0])
+                    continue;
+
+                size_t common = 1;
+                while (common < prefix && common < other->count && other_items[common] == first_items[common])
+                    common++;
+                prefix = common;
+                n_group++;
+            }
+
+            if (n_group < 2)
+                continue;
+
+            int start = first_items[0];
+            int helper = add_helper_symbol(state, lhs);
+            alternatives = &state->alternatives[lhs];
+            list kept;
+            init_list(&kept, alternatives->count, sizeof(list));
+            for (size_t j = 0; j < alternatives->count; j++)
+            {
+                list *items = get_list_element(alternatives, j);
+                if (j < i || first_item(items) != start)
+                {
+                    *(list *)new_list_element(&kept) = *items;
+                    continue;
+                }
+
+                if (j == i)
+                {
+                    list *shared = new_list_element(&kept);
+                    init_list(shared, prefix + 1, sizeof(int));
+                    push_back_many(shared, items->head, prefix);
+                    *(int *)push_back(shared) = helper;
+                }
+
+                list *tail = add_alternative(state, helper);
+                push_back_many(tail, (int *)items->head + prefix, items->count - prefix);
+                clear_list(items);
+            }
+
+            clear_list(alternatives);
+            *alternatives = kept;
+            *(int *)push_back(worklist) = helper;
+            state->n_factored++;
+            factored = true;
+        }
+    }
+}
+
+// Drops the alternatives of nonterminals the start symbol no longer
+// reaches, such as those that were only used through substitution
+void prune_unreachable(rewrite_state *state)
+{
+    size_t n_symbols = state->grammar->symbols.count;
+    bool *reached = calloc(n_symbols, sizeof(bool));
+    list stack;
+    init_list(&stack, 16, sizeof(int));
+    *(int *)push_back(&stack) = 0;
+    reached[0] = true;
+    while (stack.count > 0)
+    {
+        int sym = *(int *)peek_back(&stack);
+        pop_back(&stack);
+
+        const list *alternatives = &state->alternatives[sym];
+        for (size_t i = 0; i < alternatives->count; i++)
+        {
+            const list *items = get_list_element(alternatives, i);
+            for (size_t j = 0; j < items->count; j++)
+            {
+                int item = *(int *)get_list_element(items, j);
+                if (!IS_REDUCE_ITEM(item) && !reached[item])
+                {
+                    reached[item] = true;
+                    *(int *)push_back(&stack) = item;
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < n_symbols; i++)
+    {
+        list *alternatives = &state->alternatives[i];
+        if (reached[i])
+            continue;
+
+        for (size_t j = 0; j < alternatives->count; j++)
+            clear_list(get_list_element(alternatives, j));
+        alternatives->count = 0;
+    }
+
+    clear_list(&stack);
+    free(reached);
+}
+
+void emit_rules(grammar_transform *transform, rewrite_state *state)
+{
+    grammar *grammar = &transform->grammar;
+    size_t n_symbols = grammar->symbols.count;
+    size_t n_rules = 0;
+    bool needs_empty = false;
+    for (size_t i = 0; i < n_symbols; i++)
+    {
+        const list *alternatives = &state->alternatives[i];
+        n_rules += alternatives->count;
+        for (size_t j = 0; j < alternatives->count; j++)
+        {
+            const list *items = get_list_element(alternatives, j);
+            bool has_symbol = false;
+            for (size_t k = 0; k < items->count && !has_symbol; k++)
+                has_symbol = !IS_REDUCE_ITEM(*(int *)get_list_element(items, k));
+            needs_empty = needs_empty || !has_symbol;
+        }
+    }
+
+    symbol *empty = find_symbol_span(grammar, "\"", 1);
+    if (!empty && needs_empty)
+    {
+        empty = add_new_symbol(grammar, "\"", 1);
+        empty->type = TERMINAL;
+    }
+
+    int empty_symbol = empty ? empty->id : -1;
+    transform->marker_offsets = malloc((n_rules + 1) * sizeof(int));
+
+    // The start rule stays last, as it is when a grammar is loaded
+    for (size_t i = 1; i < n_symbols; i++)
+    {
+        const list *alternatives = &state->alternatives[i];
+        for (size_t j = 0; j < alternatives->count; j++)
+            emit_rule(transform, i, get_list_element(alternatives, j), empty_symbol);
+    }
+
+    const list *start_alternatives = &state->alternatives[0];
+    for (size_t j = 0; j < start_alternatives->count; j++)
+        emit_rule(transform, 0, get_list_element(start_alternatives, j), empty_symbol);
+
+    transform->marker_offsets[n_rules] = transform->markers.count;
+}
+
+void emit_rule(grammar_transform *transform, int lhs, const list *items, int empty_symbol)
+{
+    grammar *grammar = &transform->grammar;
+    rule *new_rule = add_new_rule(grammar, get_list_element(&grammar->symbols, lhs));
+    transform->marker_offsets[new_rule->id] = transform->markers.count;
+
+    int position = 0;
+    for (size_t i = 0; i < items->count; i++)
+    {
+        int item = *(int *)get_list_element(items, i);
+        if (IS_REDUCE_ITEM(item))
+        {
+            rule_marker *marker = push_back(&transform->markers);
+            marker->position = position;
+            marker->rule = REDUCED_RULE(item);
+        }
+        else
+        {
+            add_production(new_rule, get_list_element(&grammar->symbols, item));
+            position++;
+        }
+    }
+
+    if (position == 0)
+        add_production(new_rule, get_list_element(&grammar->symbols, empty_symbol));
+}
+
+void map_parse_tree(const grammar_transform *transform, const parse_tree *tree, parse_tree *original_tree)
+{
+    // Original nodes are built bottom up, so the transformed tree is walked
+    // in preorder and every marker completes an original node from the
+    // subtrees on top of roots
+    const parse_node *nodes = get_tree_nodes(tree);
+    list frames;
+    list postorder;
+    list roots;
+    init_list(&frames, 16, sizeof(replay_frame));
+    init_list(&postorder, tree->n_nodes + 1, sizeof(postorder_node));
+    init_list(&roots, 16, sizeof(uint32_t));
+
+    size_t next_token = 0;
+    for (size_t i = 0; i < tree->n_nodes; i++)
+    {
+        const parse_node *node = nodes + i;
+        bool finished = true;
+        if (node->rule == NO_RULE)
+        {
+            *(uint32_t *)push_back(&roots) = postorder.count;
+            postorder_node *leaf = push_back(&postorder);
+            leaf->node = *node;
+            leaf->size = 1;
+            next_token = node->first_token + node->n_tokens;
+        }
+        else
+        {
+            replay_frame *frame = push_back(&frames);
+            frame->rule = node->rule;
+            frame->n_children = node->n_children;
+            frame->child = 0;
+            frame->marker = transform->marker_offsets[node->rule];
+            replay_markers(transform, frame, &postorder, &roots, next_token);
+
+            finished = node->n_children == 0;
+            if (finished)
+                pop_back(&frames);
+        }
+
+        // A finished subtree moves its parent on to the next child
+        while (finished && frames.count > 0)
+        {
+            replay_frame *frame = peek_back(&frames);
+            frame->child++;
+            replay_markers(transform, frame, &postorder, &roots, next_token);
+            finished = frame->child == frame->n_children;
+            if (finished)
+                pop_back(&frames);
+        }
+    }
+
+    // A node's place in preorder is where its subtree starts in postorder
+    // plus its depth. Walking postorder backwards reaches parents before
+    // their children.
+    size_t n_nodes = postorder.count;
+    original_tree->nodes_offset = arena_alloc(original_tree->arena, n_nodes * sizeof(parse_node), _Alignof(parse_node));
+    original_tree->n_nodes = n_nodes;
+    parse_node *original_nodes = get_tree_nodes(original_tree);
+    const postorder_node *built = postorder.head;
+
+    list remaining;
+    init_list(&remaining, 16, sizeof(uint32_t));
+    for (size_t i = n_nodes; i-- > 0;)
+    {
+        const postorder_node *node = built + i;
+        size_t depth = remaining.count;
+        if (remaining.count > 0)
+            (*(uint32_t *)peek_back(&remaining))--;
+
+        if (node->node.n_children > 0)
+            *(uint32_t *)push_back(&remaining) = node->node.n_children;
+
+        while (remaining.count > 0 && *(uint32_t *)peek_back(&remaining) == 0)
+            pop_back(&remaining);
+
+        original_nodes[i + 1 - node->size + depth] = node->node;
+    }
+
+    clear_list(&remaining);
+    clear_list(&roots);
+    clear_list(&postorder);
+    clear_list(&frames);
+}
+
+void replay_markers(const grammar_transform *transform, replay_frame *frame, list *postorder, list *roots,
+                    size_t next_token)
+{
+    const rule_marker *markers = transform->markers.head;
+    int end = transform->marker_offsets[frame->rule + 1];
+    while (frame->marker < end && markers[frame->marker].position == (int)frame->child)
+    {
+        reduce_original_rule(transform->original, markers[frame->marker].rule, postorder, roots, next_token);
+        frame->marker++;
+    }
+}
+
+// Makes an original rule node of the subtrees on top of roots
+void reduce_original_rule(const grammar *original, int rule_id, list *postorder, list *roots, size_t next_token)
+{
+    const rule *original_rule = get_list_element(&original->rules, rule_id);
+    uint32_t n_children = 0;
+    for (size_t i = 0; i < original_rule->rhs.count; i++)
+        n_children += !is_empty_symbol(original, *(symbol **)get_list_element(&original_rule->rhs, i));
+
+    postorder_node reduced;
+    reduced.node.symbol = original_rule->lhs->id;
+    reduced.node.rule = rule_id;
+    reduced.node.first_token = next_token;
+    reduced.node.n_tokens = 0;
+    reduced.node.n_children = n_children;
+    reduced.size = 1;
+
+    const uint32_t *children = (const uint32_t *)roots->head + roots->count - n_children;
+    for (uint32_t i = 0; i < n_children; i++)
+    {
+        const postorder_node *child = get_list_element(postorder, children[i]);
+        if (i == 0)
+            reduced.node.first_token = child->node.first_token;
+        reduced.node.n_tokens += child->node.n_tokens;
+        reduced.size += child->size;
+    }
+
+    roots->count -= n_children;
+    *(uint32_t *)push_back(roots) = postorder->count;
+    *(postorder_node *)push_back(postorder) = reduced;
+}
+
+void clear_grammar_transform(grammar_transform *transform)
+{
+    clear_grammar(&transform->grammar);
+    clear_list(&transform->markers);
+    free(transform->marker_offsets);
+}
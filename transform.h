@@ -0,0 +1,41 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "grammar.h"
+#include "tree.h"
+
+// Reduction of an original rule inside a transformed rule, after position
+// non-empty rhs symbols
+typedef struct
+{
+    int position;
+    int rule;
+} rule_marker;
+
+// A copy of a grammar rewritten toward LL(1). Direct and indirect left
+// recursion is removed and alternatives with a common prefix are factored,
+// both by adding nonterminals named after the one they come from with
+// primes added. Symbols of the original grammar keep their ids.
+//
+// Every transformed rule lists where the original rules it stands for are
+// completed, so a derivation in the transformed grammar can be replayed as
+// one in the original grammar. Left recursion hidden behind nullable
+// symbols is left as it is.
+typedef struct
+{
+    const grammar *original;
+    grammar grammar;
+    list markers;
+    int *marker_offsets;
+
+    size_t n_recursive;
+    size_t n_factored;
+} grammar_transform;
+
+void init_grammar_transform(grammar_transform *transform, const grammar *original);
+// Builds the original grammar derivation of a tree of the transformed
+// grammar in the arena of original_tree
+void map_parse_tree(const grammar_transform *transform, const parse_tree *tree, parse_tree *original_tree);
+void clear_grammar_transform(grammar_transform *transform);
+
+#endif
@@ -0,0 +1,180 @@
+#include "tree.h"
+#include "lookahead.h"
+
+static inline void add_tree_node(parse_tree *tree, int symbol, int rule, size_t first_token, size_t n_children);
+static void count_tree_tokens(const parser *parser, parse_tree *tree, list *stack);
+static void print_tree(const parser *parser, const grammar *grammar, const parse_tree *tree);
+static void print_tree_symbol(const grammar *grammar, int symbol);
+
+void init_parse_tree(parse_tree *tree, arena *arena)
+{
+    tree->arena = arena;
+    tree->nodes_offset = 0;
+    tree->n_nodes = 0;
+}
+
+bool build_parse_tree(const parser *parser, list *stack, const int *tokens, size_t n_tokens, parse_tree *tree)
+{
+    tree->nodes_offset = arena_alloc(tree->arena, 0, _Alignof(parse_node));
+    tree->n_nodes = 0;
+    reset_parse_stack(parser, stack);
+
+    // The driver expands the leftmost nonterminal first, so nodes are
+    // created in preorder and can be appended as they are expanded
+    bool success = true;
+    for (size_t token_index = 0; token_index <= n_tokens && success; token_index++)
+    {
+        int token = token_index < n_tokens ? tokens[token_index] : parser->end_symbol;
+        success = false;
+        while (stack->count > 0)
+        {
+            int sym = *(int *)peek_back(stack);
+            if (parser->terminal_symbols[sym])
+            {
+                if (sym == token)
+                {
+                    pop_back(stack);
+                    add_tree_node(tree, sym, NO_RULE, token_index, 0);
+                    success = true;
+                }
+
+                break;
+            }
+
+            int rule_index = get_matching_rule(parser, sym, token);
+            if (rule_index <= LOOKAHEAD_CELL(0))
+            {
+                token_window window = {tokens, SIZE_MAX, token_index, n_tokens - token_index};
+                rule_index = find_lookahead_rule(parser, rule_index, &window);
+            }
+
+            if (rule_index < 0)
+                break;
+
+            pop_back(stack);
+            int rhs_offset = parser->rhs_offsets[rule_index];
+            int rhs_length = parser->rhs_offsets[rule_index + 1] - rhs_offset;
+            push_back_many(stack, parser->rhs_symbols + rhs_offset, rhs_length);
+            add_tree_node(tree, sym, rule_index, token_index, rhs_length);
+        }
+    }
+
+    if (!success || stack->count != 0)
+        return false;
+
+    count_tree_tokens(parser, tree, stack);
+    return true;
+}
+
+void add_tree_node(parse_tree *tree, int symbol, int rule, size_t first_token, size_t n_children)
+{
+    // Nodes have the same size and alignment, so consecutive allocations
+    // are adjacent in the arena
+    size_t offset = arena_alloc(tree->arena, sizeof(parse_node), _Alignof(parse_node));
+    parse_node *node = arena_at(tree->arena, offset);
+    node->symbol = symbol;
+    node->rule = rule;
+    node->first_token = first_token;
+    node->n_tokens = 0;
+    node->n_children = n_children;
+    tree->n_nodes++;
+}
+
+void count_tree_tokens(const parser *parser, parse_tree *tree, list *stack)
+{
+    // Walking preorder backwards, the token counts of a node's children are
+    // on top of the stack when the node is reached
+    parse_node *nodes = get_tree_nodes(tree);
+    reserve_list(stack, tree->n_nodes);
+    int *counts = stack->head;
+    size_t n_counts = 0;
+    for (size_t i = tree->n_nodes; i-- > 0;)
+    {
+        parse_node *node = nodes + i;
+        if (node->rule == NO_RULE)
+        {
+            node->n_tokens = node->symbol != parser->end_symbol;
+        }
+        else
+        {
+            for (uint32_t child = 0; child < node->n_children; child++)
+                node->n_tokens += counts[--n_counts];
+        }
+
+        counts[n_counts++] = node->n_tokens;
+    }
+
+    stack->count = 0;
+}
+
+parse_node *get_tree_nodes(const parse_tree *tree)
+{
+    return arena_at(tree->arena, tree->nodes_offset);
+}
+
+void print_parse_tree(const parser *parser, const parse_tree *tree)
+{
+    print_tree(parser, parser->grammar, tree);
+}
+
+void print_grammar_tree(const grammar *grammar, const parse_tree *tree)
+{
+    print_tree(NULL, grammar, tree);
+}
+
+// Names come from the grammar when there is one, compiled parsers only
+// have symbol ids
+void print_tree(const parser *parser, const grammar *grammar, const parse_tree *tree)
+{
+    const parse_node *nodes = get_tree_nodes(tree);
+
+    // Children left to print for every open ancestor
+    list remaining;
+    init_list(&remaining, 16, sizeof(uint32_t));
+    for (size_t i = 0; i < tree->n_nodes; i++)
+    {
+        const parse_node *node = nodes + i;
+        printf("%*s", (int)remaining.count * 2, "");
+        print_tree_symbol(grammar, node->symbol);
+        if (node->rule != NO_RULE)
+        {
+            printf(" ::=");
+            if (grammar)
+            {
+                const rule *rule = get_list_element(&grammar->rules, node->rule);
+                for (size_t j = 0; j < rule->rhs.count; j++)
+                    printf(" %s", symbol_name(grammar, *(symbol **)get_list_element(&rule->rhs, j)));
+            }
+            else
+            {
+                // Compiled parsers only keep the driver's reversed rhs
+                for (int j = parser->rhs_offsets[node->rule + 1]; j-- > parser->rhs_offsets[node->rule];)
+                {
+                    putc(' ', stdout);
+                    print_tree_symbol(grammar, parser->rhs_symbols[j]);
+                }
+            }
+        }
+
+        printf(" [%u, %u)\n", node->first_token, node->first_token + node->n_tokens);
+
+        if (remaining.count > 0)
+            (*(uint32_t *)peek_back(&remaining))--;
+
+        if (node->n_children > 0)
+            *(uint32_t *)push_back(&remaining) = node->n_children;
+
+        while (remaining.count > 0 && *(uint32_t *)peek_back(&remaining) == 0)
+            pop_back(&remaining);
+    }
+
+    clear_list(&remaining);
+}
+
+void print_tree_symbol(const grammar *grammar, int symbol)
+{
+    if (grammar)
+        printf("%s", symbol_name(grammar, get_list_element(&grammar->symbols, symbol)));
+    else
+        printf("#%d", symbol);
+}
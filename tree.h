@@ -0,0 +1,35 @@
+#ifndef TREE_H
+#define TREE_H
+
+#include <stdint.h>
+#include "arena.h"
+#include "parser.h"
+
+// One node of a derivation. Nodes are stored in preorder, so the children
+// of a node are the n_children subtrees that follow it.
+typedef struct
+{
+    int symbol;
+    // Rule used to expand a nonterminal, NO_RULE for matched terminals
+    int rule;
+    uint32_t first_token;
+    uint32_t n_tokens;
+    uint32_t n_children;
+} parse_node;
+
+// A tree lives in the arena it was built in and is freed with it
+typedef struct
+{
+    arena *arena;
+    size_t nodes_offset;
+    size_t n_nodes;
+} parse_tree;
+
+void init_parse_tree(parse_tree *tree, arena *arena);
+bool build_parse_tree(const parser *parser, list *stack, const int *tokens, size_t n_tokens, parse_tree *tree);
+parse_node *get_tree_nodes(const parse_tree *tree);
+void print_parse_tree(const parser *parser, const parse_tree *tree);
+// Prints a tree whose nodes refer to another grammar than the parser's
+void print_grammar_tree(const grammar *grammar, const parse_tree *tree);
+
+#endif
@@ -0,0 +1,759 @@
+#include "update.h"
+#include <string.h>
+#include "packed.h"
+
+// Symbol marks, a symbol is on the marked list while any of them is set
+#define MARK_DIRTY_ROW 1
+#define MARK_FIRST_REGION 2
+#define MARK_FOLLOW_REGION 4
+#define MARK_CHANGED 8
+#define MARK_QUEUED 16
+
+static void index_rules(grammar_editor *editor);
+static void clear_rule_index(grammar_editor *editor);
+static void index_rule(grammar_editor *editor, const rule *rule);
+static void unindex_rule(grammar_editor *editor, const rule *rule);
+static void rename_rule(grammar_editor *editor, const rule *rule, int old_id);
+static void insert_rule_id(list *rules, int id);
+static void remove_rule_id(list *rules, int id);
+static void rebuild_parser(grammar_editor *editor);
+static bool has_lookahead_cells(const parser *parser);
+static void reserve_rule_sets(grammar_editor *editor, size_t n_rules);
+
+static bool mark_symbol(grammar_editor *editor, int symbol, uint8_t mark);
+static bool has_mark(const grammar_editor *editor, int symbol, uint8_t mark);
+static void reset_marks(grammar_editor *editor);
+static void push_symbol(grammar_editor *editor, int symbol);
+static int pop_symbol(grammar_editor *editor);
+static rule *get_rule(const grammar_editor *editor, int id);
+static symbol *get_rhs_symbol(const rule *rule, size_t position);
+
+static void mark_first_region(grammar_editor *editor, int lhs);
+static void mark_follow_region(grammar_editor *editor, const rule *removed);
+static void add_follow_region(grammar_editor *editor, const symbol *symbol);
+static void reset_regions(grammar_editor *editor);
+
+static bool is_nullable_rule(const parser *parser, const rule *rule);
+static void set_nullable_rule(grammar_editor *editor, const rule *rule);
+static void propagate_nullable(grammar_editor *editor);
+static void update_rule_first(grammar_editor *editor, const rule *rule);
+static void update_changed_uses_first(grammar_editor *editor);
+static void propagate_first(grammar_editor *editor);
+static void update_follow_constraints(grammar_editor *editor, const rule *rule);
+static void update_follow(grammar_editor *editor, const symbol *symbol, const uint64_t *terminals);
+static void propagate_follow(grammar_editor *editor);
+static void rebuild_table_rows(grammar_editor *editor);
+
+void init_grammar_editor(grammar_editor *editor, grammar *grammar, parser *parser)
+{
+    editor->grammar = grammar;
+    editor->parser = parser;
+    editor->uses = NULL;
+    editor->lhs_rules = NULL;
+    editor->n_indexed_symbols = 0;
+    editor->marks = NULL;
+    init_list(&editor->marked, 16, sizeof(int));
+    init_list(&editor->worklist, 16, sizeof(int));
+
+    editor->n_updates = 0;
+    editor->n_rebuilds = 0;
+    editor->n_rows_rebuilt = 0;
+
+    index_rules(editor);
+}
+
+void index_rules(grammar_editor *editor)
+{
+    clear_rule_index(editor);
+
+    size_t n_symbols = editor->grammar->symbols.count;
+    editor->uses = malloc(n_symbols * sizeof(list));
+    editor->lhs_rules = malloc(n_symbols * sizeof(list));
+    for (size_t i = 0; i < n_symbols; i++)
+    {
+        init_list(editor->uses + i, 4, sizeof(rule_use));
+        init_list(editor->lhs_rules + i, 4, sizeof(int));
+    }
+
+    editor->n_indexed_symbols = n_symbols;
+    editor->marks = calloc(n_symbols, sizeof(uint8_t));
+
+    for (size_t i = 0; i < editor->grammar->rules.count; i++)
+        index_rule(editor, get_rule(editor, i));
+
+    // The parser arrays were sized for exactly these rules
+    editor->rule_capacity = editor->grammar->rules.count;
+}
+
+void clear_rule_index(grammar_editor *editor)
+{
+    for (size_t i = 0; i < editor->n_indexed_symbols; i++)
+    {
+        clear_list(editor->uses + i);
+        clear_list(editor->lhs_rules + i);
+    }
+
+    free(editor->uses);
+    free(editor->lhs_rules);
+    free(editor->marks);
+}
+
+void index_rule(grammar_editor *editor, const rule *rule)
+{
+    insert_rule_id(editor->lhs_rules + rule->lhs->id, rule->id);
+    for (size_t position = 0; position < rule->rhs.count; position++)
+    {
+        rule_use *use = push_back(editor->uses + get_rhs_symbol(rule, position)->id);
+        use->rule = rule->id;
+        use->position = position;
+    }
+}
+
+void unindex_rule(grammar_editor *editor, const rule *rule)
+{
+    remove_rule_id(editor->lhs_rules + rule->lhs->id, rule->id);
+    for (size_t position = 0; position < rule->rhs.count; position++)
+    {
+        list *uses = editor->uses + get_rhs_symbol(rule, position)->id;
+        for (size_t i = 0; i < uses->count; i++)
+        {
+            rule_use *use = get_list_element(uses, i);
+            if (use->rule == rule->id && use->position == (int)position)
+            {
+                *use = *(rule_use *)peek_back(uses);
+                pop_back(uses);
+                break;
+            }
+        }
+    }
+}
+
+void rename_rule(grammar_editor *editor, const rule *rule, int old_id)
+{
+    remove_rule_id(editor->lhs_rules + rule->lhs->id, old_id);
+    insert_rule_id(editor->lhs_rules + rule->lhs->id, rule->id);
+    for (size_t position = 0; position < rule->rhs.count; position++)
+    {
+        list *uses = editor->uses + get_rhs_symbol(rule, position)->id;
+        for (size_t i = 0; i < uses->count; i++)
+        {
+            rule_use *use = get_list_element(uses, i);
+            if (use->rule == old_id && use->position == (int)position)
+            {
+                use->rule = rule->id;
+                break;
+            }
+        }
+    }
+}
+
+void insert_rule_id(list *rules, int id)
+{
+    // Rows are rebuilt in rule order, the same order a full build uses
+    push_back(rules);
+    int *ids = rules->head;
+    size_t i = rules->count - 1;
+    for (; i > 0 && ids[i - 1] > id; i--)
+        ids[i] = ids[i - 1];
+    ids[i] = id;
+}
+
+void remove_rule_id(list *rules, int id)
+{
+    int *ids = rules->head;
+    size_t i = 0;
+    while (i < rules->count && ids[i] != id)
+        i++;
+    if (i == rules->count)
+        return;
+
+    memmove(ids + i, ids + i + 1, (rules->count - i - 1) * sizeof(int));
+    rules->count--;
+}
+
+void rebuild_parser(grammar_editor *editor)
+{
+    parser *parser = editor->parser;
+    analysis_strategy strategy = parser->strategy;
+    size_t max_lookahead = parser->max_lookahead;
+    bool packed = parser->packed_cells != NULL;
+    clear_parser(parser);
+    init_parser(parser, editor->grammar);
+    parser->strategy = strategy;
+    parser->max_lookahead = max_lookahead;
+    build_parse_table(parser);
+    if (packed)
+        pack_parse_table(parser);
+
+    index_rules(editor);
+    editor->n_rebuilds++;
+}
+
+// Trie cells depend on lookahead strings through whole derivations, which
+// row updates do not track, so parsers that may have them are rebuilt
+bool has_lookahead_cells(const parser *parser)
+{
+    return parser->max_lookahead > 1 || parser->lookahead_depth > 1;
+}
+
+void reserve_rule_sets(grammar_editor *editor, size_t n_rules)
+{
+    if (n_rules <= editor->rule_capacity)
+        return;
+
+    parser *parser = editor->parser;
+    size_t old_capacity = editor->rule_capacity;
+    size_t capacity = old_capacity * 2 > n_rules ? old_capacity * 2 : n_rules;
+
+    size_t set_bytes = parser->set_words * sizeof(uint64_t);
+    parser->rule_first_sets = realloc(parser->rule_first_sets, capacity * set_bytes);
+    memset((char *)parser->rule_first_sets + old_capacity * set_bytes, 0, (capacity - old_capacity) * set_bytes);
+
+    size_t old_words = bitset_words(old_capacity);
+    size_t words = bitset_words(capacity);
+    parser->nullable_rules = realloc(parser->nullable_rules, words * sizeof(uint64_t));
+    memset(parser->nullable_rules + old_words, 0, (words - old_words) * sizeof(uint64_t));
+
+    editor->rule_capacity = capacity;
+}
+
+int add_grammar_rule(grammar_editor *editor, const char *lhs, const char *const *rhs, size_t n_rhs)
+{
+    grammar *grammar = editor->grammar;
+    parser *parser = editor->parser;
+    size_t lhs_length = strlen(lhs);
+    if (n_rhs == 0 || is_reserved_symbol(lhs, lhs_length))
+        return -1;
+
+    size_t n_symbols = grammar->symbols.count;
+    symbol *lhs_symbol = find_symbol_span(grammar, lhs, lhs_length);
+    if (!lhs_symbol)
+        lhs_symbol = add_new_symbol(grammar, lhs, lhs_length);
+
+    // New symbols and terminals that become nonterminals change the shape
+    // of the table, everything else keeps it
+    bool reshaped = lhs_symbol->type != NONTERMINAL;
+    lhs_symbol->type = NONTERMINAL;
+
+    rule *new_rule = add_new_rule(grammar, lhs_symbol);
+    for (size_t i = 0; i < n_rhs; i++)
+    {
+        size_t length = strlen(rhs[i]);
+        symbol *rhs_symbol = find_symbol_span(grammar, rhs[i], length);
+        if (!rhs_symbol)
+        {
+            rhs_symbol = add_new_symbol(grammar, rhs[i], length);
+            rhs_symbol->type = TERMINAL;
+        }
+
+        add_production(new_rule, rhs_symbol);
+    }
+
+    editor->n_updates++;
+    if (reshaped || grammar->symbols.count != n_symbols || has_lookahead_cells(parser))
+    {
+        rebuild_parser(editor);
+        return new_rule->id;
+    }
+
+    reserve_rule_sets(editor, grammar->rules.count);
+    memset(get_rule_first_set(parser, new_rule->id), 0, parser->set_words * sizeof(uint64_t));
+    bitset_clear(parser->nullable_rules, new_rule->id);
+    index_rule(editor, new_rule);
+    update_driver_rules(parser, new_rule->id);
+
+    // Sets only grow, so they are pushed forward from the new rule
+    mark_symbol(editor, new_rule->lhs->id, MARK_DIRTY_ROW);
+    if (is_nullable_rule(parser, new_rule))
+        set_nullable_rule(editor, new_rule);
+    propagate_nullable(editor);
+
+    update_rule_first(editor, new_rule);
+    update_changed_uses_first(editor);
+    propagate_first(editor);
+
+    update_follow_constraints(editor, new_rule);
+    size_t n_marked = editor->marked.count;
+    for (size_t i = 0; i < n_marked; i++)
+    {
+        int symbol = *(int *)get_list_element(&editor->marked, i);
+        if (!has_mark(editor, symbol, MARK_CHANGED))
+            continue;
+
+        const list *uses = editor->uses + symbol;
+        for (size_t k = 0; k < uses->count; k++)
+            update_follow_constraints(editor, get_rule(editor, ((rule_use *)get_list_element(uses, k))->rule));
+    }
+    propagate_follow(editor);
+
+    rebuild_table_rows(editor);
+    reset_marks(editor);
+    return new_rule->id;
+}
+
+bool remove_grammar_rule(grammar_editor *editor, int rule_id)
+{
+    grammar *grammar = editor->grammar;
+    parser *parser = editor->parser;
+    if (rule_id < 0 || (size_t)rule_id >= grammar->rules.count)
+        return false;
+
+    rule *removed = get_rule(editor, rule_id);
+    if (removed->lhs->id == parser->start_symbol)
+        return false;
+
+    editor->n_updates++;
+    if (has_lookahead_cells(parser))
+    {
+        clear_rule(removed);
+        if (rule_id != (int)grammar->rules.count - 1)
+        {
+            *removed = *get_rule(editor, grammar->rules.count - 1);
+            removed->id = rule_id;
+        }
+
+        grammar->rules.count--;
+        rebuild_parser(editor);
+        return true;
+    }
+
+    // Sets can shrink, so every set that could depend on the removed rule
+    // is reset and derived again from the ones that could not
+    mark_first_region(editor, removed->lhs->id);
+    mark_follow_region(editor, removed);
+
+    // The last rule takes over the id of the removed one
+    unindex_rule(editor, removed);
+    clear_rule(removed);
+    int last_id = grammar->rules.count - 1;
+    if (rule_id != last_id)
+    {
+        rule *last = get_rule(editor, last_id);
+        *removed = *last;
+        removed->id = rule_id;
+        memcpy(get_rule_first_set(parser, rule_id), get_rule_first_set(parser, last_id),
+               parser->set_words * sizeof(uint64_t));
+        if (bitset_test(parser->nullable_rules, last_id))
+            bitset_set(parser->nullable_rules, rule_id);
+        else
+            bitset_clear(parser->nullable_rules, rule_id);
+
+        rename_rule(editor, removed, last_id);
+        mark_symbol(editor, removed->lhs->id, MARK_DIRTY_ROW);
+    }
+
+    grammar->rules.count--;
+    update_driver_rules(parser, rule_id);
+
+    reset_regions(editor);
+
+    size_t n_marked = editor->marked.count;
+    for (size_t i = 0; i < n_marked; i++)
+    {
+        int symbol = *(int *)get_list_element(&editor->marked, i);
+        if (!has_mark(editor, symbol, MARK_FIRST_REGION))
+            continue;
+
+        const list *rules = editor->lhs_rules + symbol;
+        for (size_t k = 0; k < rules->count; k++)
+        {
+            const rule *rule = get_rule(editor, ((int *)rules->head)[k]);
+            if (is_nullable_rule(parser, rule))
+                set_nullable_rule(editor, rule);
+        }
+    }
+    propagate_nullable(editor);
+
+    for (size_t i = 0; i < n_marked; i++)
+    {
+        int symbol = *(int *)get_list_element(&editor->marked, i);
+        if (!has_mark(editor, symbol, MARK_FIRST_REGION))
+            continue;
+
+        const list *rules = editor->lhs_rules + symbol;
+        for (size_t k = 0; k < rules->count; k++)
+            update_rule_first(editor, get_rule(editor, ((int *)rules->head)[k]));
+    }
+    update_changed_uses_first(editor);
+    propagate_first(editor);
+
+    for (size_t i = 0; i < n_marked; i++)
+    {
+        int symbol = *(int *)get_list_element(&editor->marked, i);
+        if (!has_mark(editor, symbol, MARK_FOLLOW_REGION))
+            continue;
+
+        const list *uses = editor->uses + symbol;
+        for (size_t k = 0; k < uses->count; k++)
+            update_follow_constraints(editor, get_rule(editor, ((rule_use *)get_list_element(uses, k))->rule));
+    }
+    propagate_follow(editor);
+
+    rebuild_table_rows(editor);
+    reset_marks(editor);
+    return true;
+}
+
+bool mark_symbol(grammar_editor *editor, int symbol, uint8_t mark)
+{
+    if (editor->marks[symbol] & mark)
+        return false;
+
+    if (editor->marks[symbol] == 0)
+        *(int *)push_back(&editor->marked) = symbol;
+    editor->marks[symbol] |= mark;
+    return true;
+}
+
+bool has_mark(const grammar_editor *editor, int symbol, uint8_t mark)
+{
+    return editor->marks[symbol] & mark;
+}
+
+void reset_marks(grammar_editor *editor)
+{
+    const int *marked = editor->marked.head;
+    for (size_t i = 0; i < editor->marked.count; i++)
+        editor->marks[marked[i]] = 0;
+    editor->marked.count = 0;
+}
+
+void push_symbol(grammar_editor *editor, int symbol)
+{
+    if (mark_symbol(editor, symbol, MARK_QUEUED))
+        *(int *)push_back(&editor->worklist) = symbol;
+}
+
+int pop_symbol(grammar_editor *editor)
+{
+    int symbol = *(int *)peek_back(&editor->worklist);
+    pop_back(&editor->worklist);
+    editor->marks[symbol] &= ~MARK_QUEUED;
+    return symbol;
+}
+
+rule *get_rule(const grammar_editor *editor, int id)
+{
+    return get_list_element(&editor->grammar->rules, id);
+}
+
+symbol *get_rhs_symbol(const rule *rule, size_t position)
+{
+    return *(symbol **)get_list_element(&rule->rhs, position);
+}
+
+void mark_first_region(grammar_editor *editor, int lhs)
+{
+    // Every nonterminal with a rule that uses a region symbol, starting from
+    // the lhs of the removed rule
+    mark_symbol(editor, lhs, MARK_FIRST_REGION);
+    push_symbol(editor, lhs);
+    while (editor->worklist.count > 0)
+    {
+        const list *uses = editor->uses + pop_symbol(editor);
+        for (size_t i = 0; i < uses->count; i++)
+        {
+            int user = get_rule(editor, ((rule_use *)get_list_element(uses, i))->rule)->lhs->id;
+            if (mark_symbol(editor, user, MARK_FIRST_REGION))
+                push_symbol(editor, user);
+        }
+    }
+}
+
+void mark_follow_region(grammar_editor *editor, const rule *removed)
+{
+    const parser *parser = editor->parser;
+
+    // Follow sets the removed rule added to, and the ones that took the
+    // first set or nullability of a first region symbol
+    for (size_t position = 0; position < removed->rhs.count; position++)
+        add_follow_region(editor, get_rhs_symbol(removed, position));
+
+    size_t n_marked = editor->marked.count;
+    for (size_t i = 0; i < n_marked; i++)
+    {
+        int symbol = *(int *)get_list_element(&editor->marked, i);
+        if (!has_mark(editor, symbol, MARK_FIRST_REGION))
+            continue;
+
+        const list *uses = editor->uses + symbol;
+        for (size_t k = 0; k < uses->count; k++)
+        {
+            const rule_use *use = get_list_element(uses, k);
+            if (use->position > 0)
+                add_follow_region(editor, get_rhs_symbol(get_rule(editor, use->rule), use->position - 1));
+        }
+    }
+
+    // Then everything those follow sets flow into
+    while (editor->worklist.count > 0)
+    {
+        int symbol = pop_symbol(editor);
+        if (bitset_test(parser->nullable_symbols, symbol))
+        {
+            const list *uses = editor->uses + symbol;
+            for (size_t k = 0; k < uses->count; k++)
+            {
+                const rule_use *use = get_list_element(uses, k);
+                if (use->position > 0)
+                    add_follow_region(editor, get_rhs_symbol(get_rule(editor, use->rule), use->position - 1));
+            }
+        }
+
+        const list *rules = editor->lhs_rules + symbol;
+        for (size_t k = 0; k < rules->count; k++)
+        {
+            const rule *rule = get_rule(editor, ((int *)rules->head)[k]);
+            const struct symbol *last = get_rhs_symbol(rule, rule->rhs.count - 1);
+            if (last->type == NONTERMINAL)
+                add_follow_region(editor, last);
+        }
+    }
+}
+
+void add_follow_region(grammar_editor *editor, const symbol *symbol)
+{
+    if (symbol->type != TERMINAL && mark_symbol(editor, symbol->id, MARK_FOLLOW_REGION))
+        push_symbol(editor, symbol->id);
+}
+
+void reset_regions(grammar_editor *editor)
+{
+    parser *parser = editor->parser;
+    size_t set_bytes = parser->set_words * sizeof(uint64_t);
+    for (size_t i = 0; i < editor->marked.count; i++)
+    {
+        int symbol = *(int *)get_list_element(&editor->marked, i);
+        if (has_mark(editor, symbol, MARK_FIRST_REGION))
+        {
+            bitset_clear(parser->nullable_symbols, symbol);
+            memset(get_symbol_first_set(parser, symbol), 0, set_bytes);
+
+            const list *rules = editor->lhs_rules + symbol;
+            for (size_t k = 0; k < rules->count; k++)
+            {
+                int rule_id = ((int *)rules->head)[k];
+                bitset_clear(parser->nullable_rules, rule_id);
+                memset(get_rule_first_set(parser, rule_id), 0, set_bytes);
+            }
+        }
+
+        if (has_mark(editor, symbol, MARK_FOLLOW_REGION))
+            memset(get_symbol_follow_set(parser, symbol), 0, set_bytes);
+
+        if (has_mark(editor, symbol, MARK_FIRST_REGION | MARK_FOLLOW_REGION))
+            mark_symbol(editor, symbol, MARK_DIRTY_ROW);
+    }
+}
+
+bool is_nullable_rule(const parser *parser, const rule *rule)
+{
+    for (size_t position = 0; position < rule->rhs.count; position++)
+    {
+        if (!bitset_test(parser->nullable_symbols, get_rhs_symbol(rule, position)->id))
+            return false;
+    }
+
+    return true;
+}
+
+void set_nullable_rule(grammar_editor *editor, const rule *rule)
+{
+    parser *parser = editor->parser;
+    bitset_set(parser->nullable_rules, rule->id);
+    mark_symbol(editor, rule->lhs->id, MARK_DIRTY_ROW);
+    if (bitset_test(parser->nullable_symbols, rule->lhs->id))
+        return;
+
+    bitset_set(parser->nullable_symbols, rule->lhs->id);
+    mark_symbol(editor, rule->lhs->id, MARK_CHANGED);
+    push_symbol(editor, rule->lhs->id);
+}
+
+void propagate_nullable(grammar_editor *editor)
+{
+    const parser *parser = editor->parser;
+    while (editor->worklist.count > 0)
+    {
+        const list *uses = editor->uses + pop_symbol(editor);
+        for (size_t i = 0; i < uses->count; i++)
+        {
+            const rule *rule = get_rule(editor, ((rule_use *)get_list_element(uses, i))->rule);
+            if (!bitset_test(parser->nullable_rules, rule->id) && is_nullable_rule(parser, rule))
+                set_nullable_rule(editor, rule);
+        }
+    }
+}
+
+void update_rule_first(grammar_editor *editor, const rule *rule)
+{
+    parser *parser = editor->parser;
+    uint64_t *rule_first_set = get_rule_first_set(parser, rule->id);
+
+    // Same prefix as the full build, up to the first non nullable symbol
+    bool grown = false;
+    for (size_t position = 0; position < rule->rhs.count; position++)
+    {
+        int symbol = get_rhs_symbol(rule, position)->id;
+        grown |= bitset_union(rule_first_set, get_symbol_first_set(parser, symbol), parser->set_words);
+        if (!bitset_test(parser->nullable_symbols, symbol))
+            break;
+    }
+
+    if (!grown)
+        return;
+
+    mark_symbol(editor, rule->lhs->id, MARK_DIRTY_ROW);
+    if (bitset_union(get_symbol_first_set(parser, rule->lhs->id), rule_first_set, parser->set_words))
+    {
+        mark_symbol(editor, rule->lhs->id, MARK_CHANGED);
+        push_symbol(editor, rule->lhs->id);
+    }
+}
+
+void update_changed_uses_first(grammar_editor *editor)
+{
+    // Symbols that became nullable let the first sets of the rules using
+    // them reach past them
+    size_t n_marked = editor->marked.count;
+    for (size_t i = 0; i < n_marked; i++)
+    {
+        int symbol = *(int *)get_list_element(&editor->marked, i);
+        if (!has_mark(editor, symbol, MARK_CHANGED))
+            continue;
+
+        const list *uses = editor->uses + symbol;
+        for (size_t k = 0; k < uses->count; k++)
+            update_rule_first(editor, get_rule(editor, ((rule_use *)get_list_element(uses, k))->rule));
+    }
+}
+
+void propagate_first(grammar_editor *editor)
+{
+    while (editor->worklist.count > 0)
+    {
+        const list *uses = editor->uses + pop_symbol(editor);
+        for (size_t i = 0; i < uses->count; i++)
+            update_rule_first(editor, get_rule(editor, ((rule_use *)get_list_element(uses, i))->rule));
+    }
+}
+
+void update_follow_constraints(grammar_editor *editor, const rule *rule)
+{
+    const parser *parser = editor->parser;
+    for (size_t position = 0; position + 1 < rule->rhs.count; position++)
+    {
+        const symbol *rhs_symbol = get_rhs_symbol(rule, position);
+        if (rhs_symbol->type == TERMINAL)
+            continue;
+
+        int next = get_rhs_symbol(rule, position + 1)->id;
+        update_follow(editor, rhs_symbol, get_symbol_first_set(parser, next));
+        if (bitset_test(parser->nullable_symbols, next))
+            update_follow(editor, rhs_symbol, get_symbol_follow_set(parser, next));
+    }
+
+    const symbol *last = get_rhs_symbol(rule, rule->rhs.count - 1);
+    if (last->type == NONTERMINAL)
+        update_follow(editor, last, get_symbol_follow_set(parser, rule->lhs->id));
+}
+
+void update_follow(grammar_editor *editor, const symbol *symbol, const uint64_t *terminals)
+{
+    parser *parser = editor->parser;
+    if (!bitset_union(get_symbol_follow_set(parser, symbol->id), terminals, parser->set_words))
+        return;
+
+    mark_symbol(editor, symbol->id, MARK_DIRTY_ROW);
+    push_symbol(editor, symbol->id);
+}
+
+void propagate_follow(grammar_editor *editor)
+{
+    const parser *parser = editor->parser;
+    while (editor->worklist.count > 0)
+    {
+        int symbol = pop_symbol(editor);
+        const uint64_t *follow_set = get_symbol_follow_set(parser, symbol);
+
+        // Same edges as the full build: a nullable symbol passes its follow
+        // set to the symbol before it, a lhs to the last symbol of its rules
+        if (bitset_test(parser->nullable_symbols, symbol))
+        {
+            const list *uses = editor->uses + symbol;
+            for (size_t i = 0; i < uses->count; i++)
+            {
+                const rule_use *use = get_list_element(uses, i);
+                if (use->position == 0)
+                    continue;
+
+                const struct symbol *previous = get_rhs_symbol(get_rule(editor, use->rule), use->position - 1);
+                if (previous->type != TERMINAL)
+                    update_follow(editor, previous, follow_set);
+            }
+        }
+
+        const list *rules = editor->lhs_rules + symbol;
+        for (size_t i = 0; i < rules->count; i++)
+        {
+            const rule *rule = get_rule(editor, ((int *)rules->head)[i]);
+            const struct symbol *last = get_rhs_symbol(rule, rule->rhs.count - 1);
+            if (last->type == NONTERMINAL)
+                update_follow(editor, last, follow_set);
+        }
+    }
+}
+
+void rebuild_table_rows(grammar_editor *editor)
+{
+    parser *parser = editor->parser;
+    const int *marked = editor->marked.head;
+
+    for (size_t i = 0; i < editor->marked.count; i++)
+    {
+        if (!has_mark(editor, marked[i], MARK_DIRTY_ROW) || parser->terminal_symbols[marked[i]])
+            continue;
+
+        int *row = parser->table + parser->symbol_ordinals[marked[i]] * parser->n_terminals;
+        for (size_t terminal = 0; terminal < parser->n_terminals; terminal++)
+            row[terminal] = NO_RULE;
+    }
+
+    // Conflicts of cleared rows are dropped, the rows add them back
+    size_t n_conflicts = 0;
+    for (size_t i = 0; i < parser->conflicts.count; i++)
+    {
+        table_conflict *conflict = get_list_element(&parser->conflicts, i);
+        if (parser->table[conflict->nonterminal * parser->n_terminals + conflict->terminal] == CONFLICT_RULE)
+            *(table_conflict *)get_list_element(&parser->conflicts, n_conflicts++) = *conflict;
+    }
+    parser->conflicts.count = n_conflicts;
+
+    for (size_t i = 0; i < editor->marked.count; i++)
+    {
+        if (!has_mark(editor, marked[i], MARK_DIRTY_ROW) || parser->terminal_symbols[marked[i]])
+            continue;
+
+        const list *rules = editor->lhs_rules + marked[i];
+        for (size_t k = 0; k < rules->count; k++)
+        {
+            const rule *rule = get_rule(editor, ((int *)rules->head)[k]);
+            add_table_entries(parser, rule, get_rule_first_set(parser, rule->id));
+            if (bitset_test(parser->nullable_rules, rule->id))
+                add_table_entries(parser, rule, get_symbol_follow_set(parser, rule->lhs->id));
+        }
+
+        editor->n_rows_rebuilt++;
+    }
+
+    // Changed rows can not be patched in place, they may no longer fit
+    if (parser->packed_cells)
+        pack_parse_table(parser);
+}
+
+void clear_grammar_editor(grammar_editor *editor)
+{
+    clear_rule_index(editor);
+    clear_list(&editor->marked);
+    clear_list(&editor->worklist);
+}
@@ -0,0 +1,53 @@
+#ifndef UPDATE_H
+#define UPDATE_H
+
+#include "parser.h"
+
+typedef struct
+{
+    int rule;
+    int position;
+} rule_use;
+
+// Keeps a built parser in step with a grammar that gains and loses rules at
+// run time. Adding a rule can only grow the nullable, first and follow
+// sets, so the change is pushed forward from the new rule. Removing a rule
+// resets the sets that could depend on it and derives them again. Only the
+// table rows of nonterminals whose rules or sets changed are rebuilt.
+//
+// Rules that bring in new symbols, or turn a terminal into a nonterminal,
+// change the table shape and fall back to a full rebuild, like every update
+// of a parser that may have lookahead tries. A nonterminal that loses its
+// last rule stays a nonterminal with an empty row. A packed table is packed
+// again after every update.
+typedef struct
+{
+    grammar *grammar;
+    parser *parser;
+
+    // Right hand side occurrences of each symbol, and the rules of each
+    // nonterminal in id order
+    list *uses;
+    list *lhs_rules;
+    size_t n_indexed_symbols;
+    size_t rule_capacity;
+
+    // Per symbol marks of the update in progress, reset when it is done
+    uint8_t *marks;
+    list marked;
+    list worklist;
+
+    size_t n_updates;
+    size_t n_rebuilds;
+    size_t n_rows_rebuilt;
+} grammar_editor;
+
+// The parser has to be built from the grammar already
+void init_grammar_editor(grammar_editor *editor, grammar *grammar, parser *parser);
+// Adds lhs ::= rhs, returns the new rule id or -1 if lhs can not be defined
+int add_grammar_rule(grammar_editor *editor, const char *lhs, const char *const *rhs, size_t n_rhs);
+// Removes a rule, the last rule takes over its id
+bool remove_grammar_rule(grammar_editor *editor, int rule_id);
+void clear_grammar_editor(grammar_editor *editor);
+
+#endif